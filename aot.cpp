@@ -0,0 +1,631 @@
+#pragma once
+#include "compiler.cpp"
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LILC_AOT_SUPPORTED 1
+#endif
+
+// ===== AOT: байткод → C++ → g++ -shared → dlopen =====
+//
+// Модуль собирается отдельно от интерпретатора, поэтому общается с ним
+// только через LilcAotHost (C-типы). Собранные модули кэшируются на диске
+// под хэшем сгенерированного исходника: повторный запуск той же программы
+// не вызывает компилятор.
+
+#define LILC_AOT_ABI 1
+#define LILC_AOT_HOST_BODY                                             \
+    {                                                                  \
+        void *ctx;                                                     \
+        void (*text)(void *ctx, const char *s, int ln);                \
+        void (*number)(void *ctx, double v, int ln);                   \
+        void (*diag)(void *ctx, int word, const char *msg, int error); \
+        long (*tripCount)(int inclusive, double i0, double n);         \
+        double (*const *fn1)(double);                                  \
+        double (*const *fn2)(double, double);                          \
+    }
+#define LILC_AOT_STR_(...) #__VA_ARGS__
+#define LILC_AOT_STR(...) LILC_AOT_STR_(__VA_ARGS__)
+
+extern "C"
+{
+    struct LilcAotHost LILC_AOT_HOST_BODY;
+    typedef int (*LilcAotEntry)(const LilcAotHost *);
+    typedef int (*LilcAotAbi)();
+}
+
+// Общая часть каждого модуля
+inline const char *aotPrelude()
+{
+    return "#include <algorithm>\n"
+           "#include <cmath>\n"
+           "#include <cstddef>\n"
+           "#include <iostream>\n"
+           "#include <string>\n"
+           "#include <vector>\n"
+           "extern \"C\" { struct LilcAotHost " LILC_AOT_STR(LILC_AOT_HOST_BODY) "; }\n"
+           "static const LilcAotHost *H;\n"
+           R"(
+static bool getElem(const std::vector<double> &v, double x, double &out, int word, const char *name)
+{
+    if (!(x >= 0.0))
+    {
+        H->diag(H->ctx, word, "Array index must be >= 0", 1);
+        return false;
+    }
+    const size_t idx = (size_t)x;
+    if (idx >= v.size())
+    {
+        std::cerr << "Index out of bounds for array '" << name << "': " << idx << " >= " << v.size() << "\n";
+        std::string er = "Array element '" + std::string(name) + "[" + std::to_string(idx) + "]' not found";
+        H->diag(H->ctx, word, er.c_str(), 1);
+        return false;
+    }
+    out = v[idx];
+    return true;
+}
+
+static inline void setElem(std::vector<double> &v, double x, double value, const char *name)
+{
+    const long long idx = (long long)x;
+    if (idx < 0)
+        std::cerr << "Negative index for array '" << name << "': " << idx << "\n";
+    else if ((size_t)idx >= v.size())
+        std::cerr << "Index out of bounds for array '" << name << "': " << idx << " >= " << v.size() << "\n";
+    else
+        v[(size_t)idx] = value;
+}
+)";
+}
+
+// Строковый литерал C++
+inline std::string aotQuote(const char *s)
+{
+    std::string out = "\"";
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p)
+    {
+        if (*p == '\\' || *p == '"')
+        {
+            out += '\\';
+            out += (char)*p;
+        }
+        else if (*p < 32 || *p >= 127)
+        {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\%03o", *p);
+            out += buf;
+        }
+        else
+            out += (char)*p;
+    }
+    return out + "\"";
+}
+
+// Число без потери точности
+inline std::string aotLiteral(double v)
+{
+    if (std::isnan(v))
+        return "NAN";
+    if (std::isinf(v))
+        return v > 0 ? "HUGE_VAL" : "(-HUGE_VAL)";
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "(%a)", v);
+    return buf;
+}
+
+// Встроенная функция, которую модуль может вызвать напрямую из <cmath>
+inline const char *aotCmathName(const char *name)
+{
+    static const char *const map[][2] = {
+        {"abs", "std::fabs"}, {"acos", "std::acos"}, {"asin", "std::asin"}, {"atan", "std::atan"},
+        {"atan2", "std::atan2"}, {"ceil", "std::ceil"}, {"cos", "std::cos"}, {"cosh", "std::cosh"},
+        {"exp", "std::exp"}, {"floor", "std::floor"}, {"ln", "std::log"}, {"log", "std::log10"},
+        {"log10", "std::log10"}, {"pow", "std::pow"}, {"sin", "std::sin"}, {"sinh", "std::sinh"},
+        {"sqrt", "std::sqrt"}, {"tan", "std::tan"}, {"tanh", "std::tanh"}};
+    for (const auto &m : map)
+        if (std::strcmp(m[0], name) == 0)
+            return m[1];
+    return nullptr;
+}
+
+// Перевод байткода в C++. Каждая функция LILC — static int fN(X, XA): 0 — RET,
+// 1 — HALT или ошибка (останавливает всю программу). Аргументы-значения
+// приходят в X, результат уходит в X[0], массивы-аргументы — ссылки из XA.
+// Регистры — локальные переменные; регистры main, к которым обращаются
+// процедуры, — массив G. Глубину вызовов считает D. Хвостовой вызов себя —
+// переход на начало тела; другой процедуры K — аргументы в X/XA и код 2 + K,
+// который место вызова исполняет в цикле (трамплин), так что стек не растёт.
+class AotGenerator
+{
+public:
+    AotGenerator(const Bytecode &code, int maxDepth) : bc(code), maxDepth(maxDepth) {}
+
+    std::string generate()
+    {
+        const FuncInfo &mainF = bc.funcs[0];
+        globalReg.assign(mainF.nregs + 1, false);
+        for (const Instr &I : bc.code)
+        {
+            if (I.op == OP_GETG)
+                globalReg[I.b] = true;
+            else if (I.op == OP_SETG)
+                globalReg[I.a] = true;
+        }
+        for (const VecKernel &k : bc.kernels)
+        {
+            markGlobal(k.counter);
+            markGlobal(k.limitVar);
+            for (const VecRef &r : k.scalars)
+                markGlobal(r);
+        }
+
+        target.assign(bc.code.size() + 1, false);
+        for (const Instr &I : bc.code)
+        {
+            if (I.op == OP_JMP || I.op == OP_JZ || I.op == OP_JNZ || (I.op >= OP_JLT && I.op <= OP_JNNEK))
+                target[I.a] = true;
+            else if (I.op == OP_VLOOP)
+                target[I.b] = true;
+        }
+
+        os << "// LILC AOT module, ABI " << LILC_AOT_ABI << "\n"
+           << aotPrelude()
+           << "static double G[" << (mainF.nregs + 1) << "];\n"
+           << "static std::vector<double> GA[" << (mainF.narrs + 1) << "];\n"
+           << "static int D;\n";
+        for (size_t f = 0; f < bc.funcs.size(); ++f)
+            os << "static int f" << f << "(double *X, std::vector<double> **XA);\n";
+        os << "static int (*const F[])(double *, std::vector<double> **) = {";
+        for (size_t f = 0; f < bc.funcs.size(); ++f)
+            os << (f ? ", " : "") << "f" << f;
+        os << "};\n";
+        for (size_t f = 0; f < bc.funcs.size(); ++f)
+            genFunction((int)f);
+
+        os << "extern \"C\" int lilc_aot_abi() { return " << LILC_AOT_ABI << "; }\n"
+           << "extern \"C\" int lilc_aot_main(const LilcAotHost *host)\n{\n"
+           << "    H = host;\n"
+           << "    D = 0;\n"
+           << "    for (double &g : G)\n        g = 0.0;\n"
+           << "    for (std::vector<double> &a : GA)\n        a.clear();\n"
+           << "    return f0(nullptr, nullptr);\n}\n";
+        return os.str();
+    }
+
+private:
+    const Bytecode &bc;
+    const int maxDepth;
+    std::ostringstream os;
+    std::vector<bool> globalReg;
+    std::vector<bool> target;
+    int func = 0;
+
+    void markGlobal(const VecRef &r)
+    {
+        if (r.slot >= 0 && r.global)
+            globalReg[r.slot] = true;
+    }
+
+    std::string reg(int slot) const
+    {
+        if (func == 0 && globalReg[slot])
+            return "G[" + std::to_string(slot) + "]";
+        return "r" + std::to_string(slot);
+    }
+
+    std::string arr(int slot, bool global) const
+    {
+        if (global || func == 0)
+            return "GA[" + std::to_string(slot) + "]";
+        if (slot < bc.funcs[func].arrayParams)
+            return "(*a" + std::to_string(slot) + ")"; // параметр: указатель, хвостовой вызов его меняет
+        return "a" + std::to_string(slot);
+    }
+
+    std::string ref(const VecRef &r) const { return r.global ? "G[" + std::to_string(r.slot) + "]" : reg(r.slot); }
+
+    std::string K(int i) const { return aotLiteral(bc.consts[i]); }
+
+    Id arrName(bool global, int slot) const { return bc.funcs[global ? 0 : func].arrNames[slot]; }
+
+    void genFunction(int f)
+    {
+        func = f;
+        const FuncInfo &fi = bc.funcs[f];
+        const int end = (f + 1 < (int)bc.funcs.size()) ? bc.funcs[f + 1].entry : (int)bc.code.size();
+
+        os << "\n// " << (fi.name ? fi.name : "main") << "\nstatic int f" << f
+           << "(double *X, std::vector<double> **XA)\n{\n";
+        for (int r = 0; r < fi.nregs; ++r)
+            if (f != 0 || !globalReg[r])
+                os << "    double r" << r << " = " << (r < fi.params ? "X[" + std::to_string(r) + "]" : "0.0") << ";\n";
+        if (f != 0)
+            for (int a = 0; a < fi.narrs; ++a)
+            {
+                if (a < fi.arrayParams)
+                    os << "    std::vector<double> *a" << a << " = XA[" << a << "];\n";
+                else
+                    os << "    std::vector<double> a" << a << ";\n";
+            }
+        for (int pc = fi.entry; pc < end; ++pc)
+            if (bc.code[pc].op == OP_TCALL && bc.code[pc].a == f)
+            {
+                os << "tail:\n";
+                break;
+            }
+
+        for (int pc = fi.entry; pc < end; ++pc)
+        {
+            if (target[pc])
+                os << "L" << pc << ":\n";
+            genInstr(pc);
+        }
+        if (target[end])
+            os << "L" << end << ":\n";
+        os << "    return 0;\n}\n";
+    }
+
+    void genInstr(int pc)
+    {
+        const Instr &I = bc.code[pc];
+        const int word = bc.stmtOf[pc];
+        static const char *const bin[] = {"+", "-", "*", "/"};
+        static const char *const cmp[] = {"<", "<=", ">", ">=", "==", "!="};
+        os << "    ";
+        switch (I.op)
+        {
+        case OP_NOP:
+            os << ";\n";
+            break;
+        case OP_MOV:
+            os << reg(I.a) << " = " << reg(I.b) << ";\n";
+            break;
+        case OP_LOADK:
+            os << reg(I.a) << " = " << K(I.b) << ";\n";
+            break;
+        case OP_GETG:
+            os << reg(I.a) << " = G[" << I.b << "];\n";
+            break;
+        case OP_SETG:
+            os << "G[" << I.a << "] = " << reg(I.b) << ";\n";
+            break;
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+            os << reg(I.a) << " = " << reg(I.b) << " " << bin[I.op - OP_ADD] << " " << reg(I.c) << ";\n";
+            break;
+        case OP_MOD:
+            os << reg(I.a) << " = std::fmod(" << reg(I.b) << ", " << reg(I.c) << ");\n";
+            break;
+        case OP_POW:
+            os << reg(I.a) << " = std::pow(" << reg(I.b) << ", " << reg(I.c) << ");\n";
+            break;
+        case OP_ADDK:
+        case OP_SUBK:
+        case OP_MULK:
+        case OP_DIVK:
+            os << reg(I.a) << " = " << reg(I.b) << " " << bin[I.op - OP_ADDK] << " " << K(I.c) << ";\n";
+            break;
+        case OP_NEG:
+            os << reg(I.a) << " = -" << reg(I.b) << ";\n";
+            break;
+        case OP_NOT:
+            os << reg(I.a) << " = (" << reg(I.b) << " == 0.0) ? 1.0 : 0.0;\n";
+            break;
+        case OP_LT:
+        case OP_LE:
+        case OP_GT:
+        case OP_GE:
+        case OP_EQ:
+        case OP_NE:
+            os << reg(I.a) << " = (" << reg(I.b) << " " << cmp[I.op - OP_LT] << " " << reg(I.c) << ") ? 1.0 : 0.0;\n";
+            break;
+        case OP_JMP:
+            os << "goto L" << I.a << ";\n";
+            break;
+        case OP_JZ:
+            os << "if (" << reg(I.b) << " == 0.0) goto L" << I.a << ";\n";
+            break;
+        case OP_JNZ:
+            os << "if (" << reg(I.b) << " != 0.0) goto L" << I.a << ";\n";
+            break;
+        case OP_CALLF1:
+        case OP_CALLF2:
+        {
+            const Builtin &B = builtins()[I.c];
+            const char *fn = aotCmathName(B.name);
+            os << reg(I.a) << " = ";
+            if (fn)
+                os << fn;
+            else
+                os << "H->" << (I.op == OP_CALLF1 ? "fn1" : "fn2") << "[" << I.c << "]";
+            if (I.op == OP_CALLF1)
+                os << "(" << reg(I.b) << ");\n";
+            else
+                os << "(" << reg(I.b) << ", " << reg(I.b + 1) << ");\n";
+            break;
+        }
+        case OP_NEWARR:
+            os << arr(I.a, false) << ".assign((size_t)" << K(I.b) << ", 0.0);\n";
+            break;
+        case OP_GETA:
+        case OP_GETAG:
+        {
+            const bool global = (I.op == OP_GETAG);
+            os << "if (!getElem(" << arr(I.b, global) << ", " << reg(I.c) << ", " << reg(I.a) << ", " << word
+               << ", " << aotQuote(arrName(global, I.b)) << ")) return 1;\n";
+            break;
+        }
+        case OP_SETA:
+        case OP_SETAG:
+        {
+            const bool global = (I.op == OP_SETAG);
+            os << "setElem(" << arr(I.a, global) << ", " << reg(I.b) << ", " << reg(I.c) << ", "
+               << aotQuote(arrName(global, I.a)) << ");\n";
+            break;
+        }
+        case OP_GETAU:
+            os << reg(I.a) << " = " << arr(I.b, false) << "[(size_t)" << reg(I.c) << "];\n";
+            break;
+        case OP_SETAU:
+            os << arr(I.a, false) << "[(size_t)" << reg(I.b) << "] = " << reg(I.c) << ";\n";
+            break;
+        case OP_CALL:
+        case OP_TCALL:
+        {
+            // буферы на kMaxProcParams: хвостовой вызов кладёт туда аргументы следующей
+            const CallArgs &args = bc.calls[I.c];
+            os << "{\n        double Y[" << kMaxProcParams << "] = {";
+            for (int k = 0; k < args.values; ++k)
+                os << (k ? ", " : "") << reg(I.b + k);
+            os << "};\n        std::vector<double> *YA[" << kMaxProcParams << "] = {";
+            for (size_t k = 0; k < args.arrays.size(); ++k)
+                os << (k ? ", " : "") << "&" << arr(args.arrays[k].slot, args.arrays[k].global);
+            os << "};\n";
+            if (I.op == OP_TCALL)
+            {
+                if (I.a == func)
+                {
+                    // себя: новые параметры и снова начало тела
+                    for (int k = 0; k < args.values; ++k)
+                        os << "        r" << k << " = Y[" << k << "];\n";
+                    for (size_t k = 0; k < args.arrays.size(); ++k)
+                        os << "        a" << k << " = YA[" << k << "];\n";
+                    os << "        goto tail;\n    }\n";
+                }
+                else
+                    os << "        std::copy(Y, Y + " << kMaxProcParams << ", X);\n"
+                       << "        std::copy(YA, YA + " << kMaxProcParams << ", XA);\n"
+                       << "        return " << 2 + I.a << ";\n    }\n";
+                break;
+            }
+            os << "        if (++D > " << maxDepth << ")\n        {\n"
+               << "            H->diag(H->ctx, " << bc.wordOf[pc] << ", " << aotQuote(callDepthError(maxDepth).c_str()) << ", 1);\n"
+               << "            return 1;\n        }\n"
+               << "        int rc = f" << I.a << "(Y, YA);\n"
+               << "        while (rc >= 2)\n            rc = F[rc - 2](Y, YA);\n"
+               << "        if (rc) return 1;\n"
+               << "        --D;\n"
+               << "        " << reg(I.b) << " = Y[0];\n    }\n";
+            break;
+        }
+        case OP_RET:
+            if (func == 0)
+                os << "return 1;\n";
+            else
+                os << "X[0] = " << (I.b ? reg(I.a) : "0.0") << ";\n    return 0;\n";
+            break;
+        case OP_VLOOP:
+            genKernel(bc.kernels[I.a], I.b);
+            break;
+        case OP_PRINTS:
+            os << "H->text(H->ctx, " << aotQuote(bc.strings[I.a]) << ", " << I.b << ");\n";
+            break;
+        case OP_PRINTN:
+            os << "H->number(H->ctx, " << reg(I.a) << ", " << I.b << ");\n";
+            break;
+        case OP_WARN:
+            os << "H->diag(H->ctx, " << word << ", " << aotQuote(bc.strings[I.a]) << ", 0);\n";
+            break;
+        case OP_ERR:
+            os << "H->diag(H->ctx, " << word << ", " << aotQuote(bc.strings[I.a]) << ", 1);\n    return 1;\n";
+            break;
+        case OP_HALT:
+            os << "return 1;\n";
+            break;
+        default:
+            if (I.op >= OP_JLT && I.op <= OP_JNNEK)
+            {
+                const int group = (I.op - OP_JLT) / 6; // R, K, !R, !K
+                const bool negate = group >= 2;
+                const std::string rhs = (group % 2) ? K(I.c) : reg(I.c);
+                os << "if (" << (negate ? "!" : "") << "(" << reg(I.b) << " " << cmp[(I.op - OP_JLT) % 6] << " "
+                   << rhs << ")) goto L" << I.a << ";\n";
+            }
+            else
+                os << "return 1;\n";
+            break;
+        }
+    }
+
+    // Поэлементный цикл: одна проверка границ и плоский цикл, который
+    // компилятор модуля может векторизовать сам
+    void genKernel(const VecKernel &k, int exitPc)
+    {
+        os << "{\n";
+        const std::string i = ref(k.counter);
+        const std::string n = (k.limitVar.slot >= 0) ? ref(k.limitVar) : aotLiteral(k.limitConst);
+        os << "        const long cnt = H->tripCount(" << k.inclusive << ", " << i << ", " << n << ");\n"
+           << "        const size_t from = (size_t)" << i << ", to = from + (size_t)cnt;\n"
+           << "        if (cnt > 0";
+        for (const VecRef &r : k.arrays)
+            os << " && " << arr(r.slot, r.global) << ".size() >= to";
+        os << ")\n        {\n";
+        for (size_t a = 0; a < k.arrays.size(); ++a)
+            os << "            double *p" << a << " = " << arr(k.arrays[a].slot, k.arrays[a].global) << ".data();\n";
+        for (size_t s = 0; s < k.scalars.size(); ++s)
+            os << "            const double s" << s << " = " << ref(k.scalars[s]) << ";\n";
+        os << "            for (size_t j = from; j < to; ++j)\n            {\n";
+        std::vector<std::string> stack;
+        static const char *const ops[] = {"+", "-", "*", "/"};
+        for (const VecInstr &v : k.code)
+        {
+            switch (v.op)
+            {
+            case V_ARR:
+                stack.push_back("p" + std::to_string(v.arg) + "[j]");
+                break;
+            case V_CONST:
+                stack.push_back(aotLiteral(k.consts[v.arg]));
+                break;
+            case V_SCALAR:
+                stack.push_back("s" + std::to_string(v.arg));
+                break;
+            case V_INDEX:
+                stack.push_back("(double)j");
+                break;
+            case V_STORE:
+                os << "                p" << v.arg << "[j] = " << stack.back() << ";\n";
+                stack.pop_back();
+                break;
+            default:
+            {
+                std::string b = stack.back();
+                stack.pop_back();
+                std::string a = stack.back();
+                stack.back() = "(" + a + " " + ops[v.op - V_ADD] + " " + b + ")";
+                break;
+            }
+            }
+        }
+        os << "            }\n"
+           << "            " << i << " += (double)cnt;\n"
+           << "            goto L" << exitPc << ";\n"
+           << "        }\n    }\n";
+    }
+};
+
+// Собранный и загруженный модуль программы
+class AotModule
+{
+public:
+    ~AotModule() { unload(); }
+
+    bool loaded() const { return entry != nullptr; }
+    const std::string &modulePath() const { return path; }
+    bool fromCache() const { return cached; }
+
+    // Сгенерировать, найти в кэше или собрать, загрузить. false — err
+    bool load(const Bytecode &bc, int maxDepth, std::string &err)
+    {
+        unload();
+#ifndef LILC_AOT_SUPPORTED
+        (void)bc;
+        (void)maxDepth;
+        err = "AOT is not supported on this platform";
+        return false;
+#else
+        const std::string source = AotGenerator(bc, maxDepth).generate();
+        const std::string cxx = compilerCommand();
+        const std::string dir = lilcCacheDir();
+        ::mkdir(dir.c_str(), 0755);
+
+        char key[32];
+        const std::string keyText = cxx + "\n" + source;
+        std::snprintf(key, sizeof(key), "%016llx", (unsigned long long)lilcHash(keyText.data(), keyText.size()));
+        const std::string base = dir + "/lilc_" + key;
+        path = base + ".so";
+
+        cached = (::access(path.c_str(), R_OK) == 0);
+        if (!cached && !build(source, base, cxx, err))
+            return false;
+
+        handle = ::dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle)
+        {
+            const char *e = ::dlerror();
+            err = std::string("dlopen failed: ") + (e ? e : path.c_str());
+            return false;
+        }
+        LilcAotAbi abi = (LilcAotAbi)::dlsym(handle, "lilc_aot_abi");
+        entry = (LilcAotEntry)::dlsym(handle, "lilc_aot_main");
+        if (!abi || !entry || abi() != LILC_AOT_ABI)
+        {
+            err = "AOT module " + path + " has a wrong ABI";
+            unload();
+            return false;
+        }
+        return true;
+#endif
+    }
+
+    // 1 — программа остановлена (HALT/ошибка), 0 — дошла до конца
+    int run(const LilcAotHost &host) { return entry ? entry(&host) : 1; }
+
+    void unload()
+    {
+#ifdef LILC_AOT_SUPPORTED
+        if (handle)
+            ::dlclose(handle);
+#endif
+        handle = nullptr;
+        entry = nullptr;
+    }
+
+private:
+    void *handle = nullptr;
+    LilcAotEntry entry = nullptr;
+    std::string path;
+    bool cached = false;
+
+    // CXX — компилятор
+    static std::string compilerCommand()
+    {
+        const char *c = std::getenv("CXX");
+        return std::string((c && *c) ? c : "g++") + " -O2 -shared -fPIC -w";
+    }
+
+#ifdef LILC_AOT_SUPPORTED
+    bool build(const std::string &source, const std::string &base, const std::string &cxx, std::string &err)
+    {
+        const std::string src = base + ".cpp";
+        const std::string log = base + ".log";
+        const std::string tmp = base + "." + std::to_string((long)::getpid()) + ".tmp";
+        {
+            std::ofstream out(src, std::ios::binary);
+            out << source;
+            if (!out)
+            {
+                err = "cannot write " + src;
+                return false;
+            }
+        }
+        const std::string cmd = cxx + " -o '" + tmp + "' '" + src + "' > '" + log + "' 2>&1";
+        if (std::system(cmd.c_str()) != 0)
+        {
+            std::remove(tmp.c_str());
+            err = "AOT compile failed, see " + log;
+            return false;
+        }
+        // rename атомарен: параллельный запуск не увидит недописанный модуль
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmp.c_str());
+            err = "cannot create " + path;
+            return false;
+        }
+        std::remove(log.c_str());
+        return true;
+    }
+#endif
+};
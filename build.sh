@@ -1,8 +1,8 @@
 #!/bin/bash
 
-g++ -c main.cpp -o main.o
-g++ -c system.cpp -o system.o
-g++ -c lilc.cpp -o lilc.o
-gcc -c tinyexpr.c -o tinyexpr.o   
+g++ -O2 -c main.cpp -o main.o
+g++ -O2 -c system.cpp -o system.o
+g++ -O2 -c lilc.cpp -o lilc.o
+gcc -O2 -c tinyexpr.c -o tinyexpr.o   
 
-g++ main.o system.o lilc.o tinyexpr.o -o test
\ No newline at end of file
+g++ -O2 main.o system.o lilc.o tinyexpr.o -o test -ldl -pthread
\ No newline at end of file
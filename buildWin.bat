@@ -1,11 +1,11 @@
 @echo off
 REM Компилируем каждый .cpp файл в .o
-g++ -c main.cpp -o main.o
-g++ -c system.cpp -o system.o
-g++ -c lilc.cpp -o lilc.o
-gcc -c tinyexpr.c -o tinyexpr.o
+g++ -O2 -c main.cpp -o main.o
+g++ -O2 -c system.cpp -o system.o
+g++ -O2 -c lilc.cpp -o lilc.o
+gcc -O2 -c tinyexpr.c -o tinyexpr.o
 
 REM Линкуем объектные файлы в итоговый исполняемый файл
-g++ main.o system.o lilc.o tinyexpr.o -o test.exe
+g++ -O2 main.o system.o lilc.o tinyexpr.o -o test.exe
 
 echo Build finished.
\ No newline at end of file
@@ -1,12 +1,12 @@
 @echo off
 
 REM Компиляция .cpp файлов
-cl /c /EHsc main.cpp
-cl /c /EHsc system.cpp
-cl /c /EHsc lilc.cpp
+cl /c /O2 /EHsc main.cpp
+cl /c /O2 /EHsc system.cpp
+cl /c /O2 /EHsc lilc.cpp
 
 REM Компиляция C файла
-cl /c tinyexpr.c
+cl /c /O2 tinyexpr.c
 
 REM Линковка
 link main.obj system.obj lilc.obj tinyexpr.obj /OUT:test.exe
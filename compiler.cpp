@@ -0,0 +1,2980 @@
+#pragma once
+#include "system.cpp"
+#include "simd.cpp"
+#include "token.cpp"
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <cctype>
+#include <iostream>
+
+// ===== Байткод регистровой ВМ =====
+//
+// Регистры адресуются относительно базы фрейма текущей функции. Фрейм main
+// лежит с нуля, поэтому его переменные одновременно являются глобальными:
+// процедуры обращаются к ним через OP_GETG / OP_SETG / OP_GETAG / OP_SETAG.
+
+// Порядок совпадает с группами OP_LT.., OP_JLT.. ниже
+enum CmpOp
+{
+    CMP_LT = 0,
+    CMP_LE,
+    CMP_GT,
+    CMP_GE,
+    CMP_EQ,
+    CMP_NE
+};
+
+enum OpCode : uint8_t
+{
+    OP_NOP = 0,
+    OP_MOV,   // R[a] = R[b]
+    OP_LOADK, // R[a] = K[b]
+    OP_GETG,  // R[a] = G[b]
+    OP_SETG,  // G[a] = R[b]
+
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD, OP_POW, // R[a] = R[b] op R[c]
+    OP_ADDK, OP_SUBK, OP_MULK, OP_DIVK,             // R[a] = R[b] op K[c]
+    OP_NEG,                                         // R[a] = -R[b]
+    OP_NOT,                                         // R[a] = (R[b] == 0)
+
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,             // R[a] = R[b] cmp R[c]
+    OP_JLT, OP_JLE, OP_JGT, OP_JGE, OP_JEQ, OP_JNE,       // if (R[b] cmp R[c]) pc = a
+    OP_JLTK, OP_JLEK, OP_JGTK, OP_JGEK, OP_JEQK, OP_JNEK, // if (R[b] cmp K[c]) pc = a
+    OP_JNLT, OP_JNLE, OP_JNGT, OP_JNGE, OP_JNEQ, OP_JNNE, // if (!(R[b] cmp R[c])) pc = a
+    OP_JNLTK, OP_JNLEK, OP_JNGTK, OP_JNGEK, OP_JNEQK, OP_JNNEK,
+    OP_JMP, // pc = a
+    OP_JZ,  // if (R[b] == 0) pc = a
+    OP_JNZ, // if (R[b] != 0) pc = a
+
+    OP_CALLF1, // R[a] = builtin[c](R[b])
+    OP_CALLF2, // R[a] = builtin[c](R[b], R[b + 1])
+
+    OP_NEWARR, // A[a] = K[b] нулей
+    OP_GETA,   // R[a] = A[b][R[c]]
+    OP_SETA,   // A[a][R[b]] = R[c]
+    OP_GETAG,  // то же для массивов main
+    OP_SETAG,
+    OP_GETAU,  // как GETA, индекс проверен при загрузке (целый, в границах)
+    OP_SETAU,  // как SETA, без проверки
+
+    OP_CALL, // R[b] = funcs[a](R[b..], массивы calls[c]); аргументы — в первые регистры
+    OP_RET,  // возврат R[a], если b (иначе 0)
+    OP_TCALL, // RETURN funcs[a](...): как CALL, но в кадре текущей функции
+
+    OP_VLOOP, // векторное ядро kernels[a]; выполнено — pc = b, иначе обычный цикл
+
+    OP_PRINTS, // вывод strings[a], b — перевод строки
+    OP_PRINTN, // вывод R[a], b — перевод строки
+    OP_WARN,   // предупреждение strings[a]
+    OP_ERR,    // ошибка strings[a] и остановка
+    OP_HALT,
+
+    OP_COUNT
+};
+
+inline const char *opName(int op)
+{
+    static const char *names[OP_COUNT] = {
+        "NOP", "MOV", "LOADK", "GETG", "SETG",
+        "ADD", "SUB", "MUL", "DIV", "MOD", "POW",
+        "ADDK", "SUBK", "MULK", "DIVK", "NEG", "NOT",
+        "LT", "LE", "GT", "GE", "EQ", "NE",
+        "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE",
+        "JLTK", "JLEK", "JGTK", "JGEK", "JEQK", "JNEK",
+        "JNLT", "JNLE", "JNGT", "JNGE", "JNEQ", "JNNE",
+        "JNLTK", "JNLEK", "JNGTK", "JNGEK", "JNEQK", "JNNEK",
+        "JMP", "JZ", "JNZ",
+        "CALLF1", "CALLF2",
+        "NEWARR", "GETA", "SETA", "GETAG", "SETAG", "GETAU", "SETAU",
+        "CALL", "RET", "TCALL", "VLOOP",
+        "PRINTS", "PRINTN", "WARN", "ERR", "HALT"};
+    return (op >= 0 && op < OP_COUNT) ? names[op] : "???";
+}
+
+struct Instr
+{
+    uint8_t op = OP_NOP;
+    int32_t a = 0;
+    int32_t b = 0;
+    int32_t c = 0;
+};
+
+struct FuncInfo
+{
+    Id name = nullptr;
+    int entry = 0;              // первая инструкция
+    int nregs = 0;              // размер фрейма: переменные + временные
+    int nvars = 0;              // из них переменные (как кадр движка tick)
+    int narrs = 0;              // число массивов во фрейме
+    int params = 0;             // параметров-значений: регистры 0..params-1
+    int arrayParams = 0;        // параметров-массивов: массивы 0..arrayParams-1
+    std::vector<Id> arrNames;   // для сообщений об ошибках
+};
+
+// Не больше стольких параметров у процедуры (столько аргументов у замыкания tinyexpr)
+constexpr int kMaxProcParams = 7;
+
+// Глубина вложенных вызовов по умолчанию; глубже — ошибка, а не переполнение стека
+constexpr int kMaxCallDepth = 4000;
+
+inline std::string callDepthError(int maxDepth)
+{
+    return "Call stack overflow: more than " + std::to_string(maxDepth) + " nested calls";
+}
+
+// Массив, переданный в процедуру по ссылке
+struct ArrayArg
+{
+    int slot = 0;
+    bool global = false;
+};
+
+// Аргументы OP_CALL: values значений в R[b..], массивы — по порядку параметров
+struct CallArgs
+{
+    int values = 0;
+    std::vector<ArrayArg> arrays;
+};
+
+// Вызов процедуры, заменённый её телом (для отчёта)
+struct InlineSite
+{
+    int func = 0;   // куда встроено
+    int callee = 0;
+    int word = -1;  // слово вызова
+    int statements = 0;
+};
+
+// Какие процедуры встраивать в места вызова (ENGINE_VM / ENGINE_AOT)
+struct InlinePolicy
+{
+#ifdef LILC_NO_INLINE
+    int maxStatements = 0;
+#else
+    int maxStatements = 8; // операторов в теле со вложенными; 0 — не встраивать
+#endif
+    int maxSites = 256;    // встраиваний на программу
+};
+
+// WHILE в байткоде: [top, exit) — тело и проверка в конце (с cond);
+// [hoist, hoistEnd) — инварианты цикла, считаются один раз перед входом
+struct BytecodeLoop
+{
+    int func = 0;
+    int whileWord = -1;
+    int closeWord = -1; // '}' тела
+    int hoist = 0;
+    int hoistEnd = 0;
+    int top = 0;
+    int cond = 0;
+    int exit = 0;
+};
+
+struct Bytecode
+{
+    std::vector<Instr> code;
+    std::vector<int> wordOf; // pc → индекс слова исходника (для ошибок)
+    std::vector<int> stmtOf; // pc → слово, с которого tick повторит оператор
+    std::vector<BytecodeLoop> loops;
+    std::vector<double> consts;
+    std::vector<const char *> strings;
+    std::vector<FuncInfo> funcs; // funcs[0] — main
+    std::vector<VecKernel> kernels;
+    std::vector<InlineSite> inlined;
+    std::vector<CallArgs> calls; // по OP_CALL.c
+
+    void clear()
+    {
+        code.clear();
+        wordOf.clear();
+        stmtOf.clear();
+        loops.clear();
+        consts.clear();
+        strings.clear();
+        funcs.clear();
+        kernels.clear();
+        inlined.clear();
+        calls.clear();
+    }
+
+    void printInlining(std::ostream &os) const
+    {
+        os << "inlined " << inlined.size() << " call sites\n";
+        for (const InlineSite &s : inlined)
+            os << "  word " << s.word << ": " << funcs[s.callee].name << " into "
+               << (funcs[s.func].name ? funcs[s.func].name : "main") << " (" << s.statements << " statements)\n";
+    }
+
+    void print(std::ostream &os) const
+    {
+        for (size_t f = 0; f < funcs.size(); ++f)
+            os << "func " << f << " <" << (funcs[f].name ? funcs[f].name : "main") << "> entry "
+               << funcs[f].entry << ", regs " << funcs[f].nregs << ", arrays " << funcs[f].narrs << "\n";
+        for (size_t pc = 0; pc < code.size(); ++pc)
+        {
+            const Instr &I = code[pc];
+            os << pc << ": " << opName(I.op) << " " << I.a << " " << I.b << " " << I.c;
+            if (I.op == OP_LOADK)
+                os << "    ; " << consts[I.b];
+            else if ((I.op >= OP_ADDK && I.op <= OP_DIVK) ||
+                     (I.op >= OP_JLTK && I.op <= OP_JNEK) || (I.op >= OP_JNLTK && I.op <= OP_JNNEK))
+                os << "    ; " << consts[I.c];
+            else if (I.op == OP_PRINTS || I.op == OP_WARN || I.op == OP_ERR)
+                os << "    ; \"" << strings[I.a] << "\"";
+            os << "\n";
+        }
+    }
+};
+
+// ===== Встроенные функции (те же, что в tinyexpr) =====
+typedef double (*BuiltinFn1)(double);
+typedef double (*BuiltinFn2)(double, double);
+
+struct Builtin
+{
+    const char *name;
+    int arity; // 0 — константа value
+    BuiltinFn1 f1;
+    BuiltinFn2 f2;
+    double value;
+};
+
+inline double builtinFac(double a)
+{
+    if (a < 0.0)
+        return NAN;
+    if (a > UINT_MAX)
+        return INFINITY;
+    unsigned int ua = (unsigned int)(a);
+    unsigned long int result = 1, i;
+    for (i = 1; i <= ua; i++)
+    {
+        if (i > ULONG_MAX / result)
+            return INFINITY;
+        result *= i;
+    }
+    return (double)result;
+}
+
+inline double builtinNcr(double n, double r)
+{
+    if (n < 0.0 || r < 0.0 || n < r)
+        return NAN;
+    if (n > UINT_MAX || r > UINT_MAX)
+        return INFINITY;
+    unsigned long int un = (unsigned int)(n), ur = (unsigned int)(r), i;
+    unsigned long int result = 1;
+    if (ur > un / 2)
+        ur = un - ur;
+    for (i = 1; i <= ur; i++)
+    {
+        if (result > ULONG_MAX / (un - ur + i))
+            return INFINITY;
+        result *= un - ur + i;
+        result /= i;
+    }
+    return result;
+}
+
+inline double builtinNpr(double n, double r) { return builtinNcr(n, r) * builtinFac(r); }
+
+inline const std::vector<Builtin> &builtins()
+{
+    static const std::vector<Builtin> B = {
+        {"abs", 1, [](double x) { return std::fabs(x); }, nullptr, 0},
+        {"acos", 1, [](double x) { return std::acos(x); }, nullptr, 0},
+        {"asin", 1, [](double x) { return std::asin(x); }, nullptr, 0},
+        {"atan", 1, [](double x) { return std::atan(x); }, nullptr, 0},
+        {"atan2", 2, nullptr, [](double y, double x) { return std::atan2(y, x); }, 0},
+        {"ceil", 1, [](double x) { return std::ceil(x); }, nullptr, 0},
+        {"cos", 1, [](double x) { return std::cos(x); }, nullptr, 0},
+        {"cosh", 1, [](double x) { return std::cosh(x); }, nullptr, 0},
+        {"exp", 1, [](double x) { return std::exp(x); }, nullptr, 0},
+        {"fac", 1, builtinFac, nullptr, 0},
+        {"floor", 1, [](double x) { return std::floor(x); }, nullptr, 0},
+        {"ln", 1, [](double x) { return std::log(x); }, nullptr, 0},
+        {"log", 1, [](double x) { return std::log10(x); }, nullptr, 0},
+        {"log10", 1, [](double x) { return std::log10(x); }, nullptr, 0},
+        {"ncr", 2, nullptr, builtinNcr, 0},
+        {"npr", 2, nullptr, builtinNpr, 0},
+        {"pi", 0, nullptr, nullptr, 3.14159265358979323846},
+        {"pow", 2, nullptr, [](double a, double b) { return std::pow(a, b); }, 0},
+        {"sin", 1, [](double x) { return std::sin(x); }, nullptr, 0},
+        {"sinh", 1, [](double x) { return std::sinh(x); }, nullptr, 0},
+        {"sqrt", 1, [](double x) { return std::sqrt(x); }, nullptr, 0},
+        {"tan", 1, [](double x) { return std::tan(x); }, nullptr, 0},
+        {"tanh", 1, [](double x) { return std::tanh(x); }, nullptr, 0},
+    };
+    return B;
+}
+
+// ===== AST =====
+struct Expr
+{
+    enum Kind : uint8_t
+    {
+        NUM,   // num
+        VAR,   // decl
+        ELEM,  // decl[l]
+        NEG,   // -l
+        NOT,   // !l
+        BIN,   // l op r, op — OP_ADD..OP_POW
+        CMP,   // l op r, op — CmpOp
+        AND,   // l && r (короткое замыкание)
+        OR,    // l || r
+        CALLF, // builtins()[op](l, r)
+        CALLP, // процедура funcs[op], аргументы — цепочка ARGS в l
+        ARGS,  // аргумент l, следующий — r
+        ARR,   // массив decl, переданный по ссылке
+        COMMA, // l, r
+        HOIST  // инвариант цикла l, посчитанный перед циклом в регистр op
+    };
+    Kind kind = NUM;
+    int op = 0;
+    int decl = -1;
+    int word = -1;
+    int from = -1, to = -1; // слова исходника [from, to)
+    bool inRange = false;   // ELEM: индекс доказанно целый и в границах
+    double num = 0.0;
+    Expr *l = nullptr;
+    Expr *r = nullptr;
+};
+
+struct Stmt
+{
+    enum Kind : uint8_t
+    {
+        DECL,      // VAR x [= e];
+        DECLARR,   // VAR x[size];
+        ASSIGN,    // x = e;
+        ASSIGNARR, // x[idx] = e;
+        PRINTS,    // PRINT "text";
+        PRINTE,    // PRINT e;
+        IF,        // IF (e) { body } ELSE { orelse }
+        WHILE,     // WHILE (e) { body }
+        BLOCK,     // одиночный ELSE { body }
+        CALL,      // name(args);  decl — индекс функции, e — CALLP
+        INLINE,    // встроенное тело функции decl; RETURN — переход в конец
+        RETURN,    // RETURN [e];
+        BREAK,     // выход из ближайшего WHILE
+        CONTINUE,  // к проверке условия ближайшего WHILE
+        HALT,
+        WARN,  // text
+        ERROR  // text
+    };
+    Kind kind = ERROR;
+    int word = -1;
+    int decl = -1;
+    int close = -1;  // WHILE: '}' тела
+    int kernel = -1; // WHILE: векторное ядро (kernels)
+    std::vector<Expr *> hoisted; // WHILE: HOIST-узлы, считаемые перед циклом
+    bool inRange = false;        // ASSIGNARR: индекс доказанно в границах
+    bool tail = false;           // RETURN f(...): хвостовой вызов
+    bool ln = false;
+    const char *text = nullptr;
+    double size = 0.0;
+    Expr *e = nullptr;
+    Expr *idx = nullptr;
+    std::vector<Stmt *> body;
+    std::vector<Stmt *> orelse;
+};
+
+struct VarDecl
+{
+    Id name = nullptr;
+    int func = 0;  // функция-владелец
+    int slot = -1; // регистр (или индекс массива) во фрейме функции
+    bool isArray = false;
+    bool isConst = false;
+    int word = -1;
+    double size = 0.0; // массив: число элементов из объявления
+    // CONST с числовым значением, известным при загрузке
+    bool known = false;
+    double value = 0.0;
+    bool procSafe = false; // объявлен в main до первого вызова процедуры
+};
+
+struct FuncAst
+{
+    Id name = nullptr;
+    int word = -1; // слово с именем
+    int open = -1; // '{' тела
+    int close = -1;
+    std::vector<int> paramWords; // имена параметров в заголовке
+    std::vector<char> paramArray; // 1 — параметр-массив name[]
+    std::vector<int> params;     // их объявления
+    std::vector<Stmt *> body;
+    int nlocals = 0;
+    int narrs = 0;
+    std::vector<Id> arrNames;
+};
+
+// Инвариант цикла для движка tick: слова [from, to) внутри цикла whileWord
+struct LoopHoist
+{
+    int whileWord = -1;
+    int from = -1;
+    int to = -1;
+    bool calls = false; // в теле цикла есть вызовы процедур
+};
+
+// Повторы подвыражения в одном операторе для движка tick: вхождения — слова
+// [from[k], to[k]). Элемент a[...] ещё и помнит, где имя и индекс
+struct CseGroup
+{
+    std::vector<int> from, to;
+    int elem = -1; // слово с именем массива
+    int indexFrom = -1, indexTo = -1;
+    int store = -1; // оператор name[i] = ..., пишущий этот же элемент
+};
+
+// Вызов процедуры для движка tick: аргумент k — слова [from[k], to[k]),
+// у массива это одно слово с его именем
+struct CallWords
+{
+    int word = -1;  // имя процедуры
+    int func = 0;
+    int close = -1; // ')' аргументов; -1 — вызов без скобок
+    bool tail = false; // RETURN name(...); — кадр вызывающей переиспользуется
+    std::vector<int> from, to;
+    std::vector<char> isArray;
+};
+
+// Разрешение имён для движка tick: слово -> объявление, размеры кадров
+struct Resolution
+{
+    std::vector<int> wordDecl; // индекс в decls; -1 — не переменная или не найдено
+    std::vector<char> wordKnown; // 1 — имя CONST, подставленное значением wordValue
+    std::vector<double> wordValue;
+    std::vector<char> wordInRange; // 1 — имя массива в a[...], индекс которого доказан
+    std::vector<VarDecl> decls;
+    std::vector<int> frameVars; // по функциям, 0 — main
+    std::vector<int> frameArrs;
+    std::unordered_map<Id, int, PtrHash, PtrEq> procIndex;
+    std::vector<VecKernel> kernels; // поэлементные циклы, whileWord — слово WHILE
+    std::vector<LoopHoist> hoists;
+    std::vector<CseGroup> cse;
+    std::vector<CallWords> calls;
+};
+
+// ===== Компилятор: поток слов → AST → байткод =====
+class Compiler
+{
+public:
+    Compiler(const std::vector<const char *> &words, const TokenStream &tokens, const Symbols &syms)
+        : W(words), T(tokens), S(syms) {}
+
+    // false — программа структурно некорректна (error / errorWord)
+    bool compile(Bytecode &out, const InlinePolicy &inlining = InlinePolicy())
+    {
+        policy = inlining;
+        if (!parse())
+            return false;
+
+        out.clear();
+        bc = &out;
+        out.funcs.resize(funcs.size());
+        out.kernels = kernels;
+        out.inlined = inlined;
+        for (int f = 0; f < (int)funcs.size(); ++f)
+            genFunction(f);
+        bc = nullptr;
+        return true;
+    }
+
+    // Только разбор и области видимости, без генерации кода
+    bool resolve(Resolution &out)
+    {
+        policy.maxStatements = 0; // tick исполняет вызовы сам
+        if (!parse())
+            return false;
+        out.wordDecl = wordDecl;
+        out.wordKnown = wordKnown;
+        out.wordValue = wordValue;
+        out.wordInRange = wordInRange;
+        out.decls = decls;
+        out.procIndex = procIndex;
+        out.kernels = kernels;
+        out.hoists = hoists;
+        out.cse = cse;
+        out.calls = calls;
+        out.frameVars.clear();
+        out.frameArrs.clear();
+        for (const FuncAst &f : funcs)
+        {
+            out.frameVars.push_back(f.nlocals);
+            out.frameArrs.push_back(f.narrs);
+        }
+        return true;
+    }
+
+    std::string error;
+    int errorWord = 0;
+
+private:
+    bool parse()
+    {
+        n = (int)W.size();
+        funcs.clear();
+        funcs.emplace_back(); // main
+        wordDecl.assign(n, -1);
+        wordKnown.assign(n, 0);
+        wordValue.assign(n, 0.0);
+        wordInRange.assign(n, 0);
+        hoists.clear();
+        cse.clear();
+        calls.clear();
+        mainCalls = false;
+
+        if (!collectProcs())
+            return false;
+
+        // main
+        curFunc = 0;
+        scopes.assign(1, Scope());
+        funcs[0].body = parseStatements(0, n);
+        if (fatal)
+            return false;
+        globals = scopes[0];
+
+        // процедуры видят свои локальные и глобальные переменные main;
+        // параметры — первые ячейки кадра, тело — вложенная область
+        for (int f = 1; f < (int)funcs.size(); ++f)
+        {
+            curFunc = f;
+            scopes.assign(1, Scope());
+            FuncAst &F = funcs[f];
+            for (size_t k = 0; k < F.paramWords.size(); ++k)
+                F.params.push_back(declare(W[F.paramWords[k]], F.paramArray[k] != 0, false, F.paramWords[k]));
+            scopes.emplace_back();
+            funcs[f].body = parseStatements(funcs[f].open + 1, funcs[f].close);
+            if (fatal)
+                return false;
+        }
+        inlined.clear();
+        if (policy.maxStatements > 0)
+        {
+            inlineState.assign(funcs.size(), 0);
+            for (int f = 0; f < (int)funcs.size(); ++f)
+                inlineInto(f);
+        }
+        for (int f = 0; f < (int)funcs.size(); ++f)
+        {
+            curFunc = f;
+            ranges.clear();
+            rangeBody(funcs[f].body);
+        }
+#ifndef LILC_NO_LICM
+        for (int f = 0; f < (int)funcs.size(); ++f)
+        {
+            curFunc = f;
+            hoistLoops.clear();
+            hoistBody(funcs[f].body);
+        }
+#endif
+        for (FuncAst &f : funcs)
+            cseBody(f.body);
+        return true;
+    }
+
+    struct Scope
+    {
+        std::unordered_map<Id, int, PtrHash, PtrEq> vars;
+        std::unordered_map<Id, int, PtrHash, PtrEq> arrs;
+    };
+
+    const std::vector<const char *> &W;
+    const TokenStream &T; // виды слов и разобранные числа
+    const Symbols &S;
+    int n = 0;
+
+    std::deque<Expr> exprPool;
+    std::deque<Stmt> stmtPool;
+    std::vector<VarDecl> decls;
+    std::vector<FuncAst> funcs;
+    std::unordered_map<Id, int, PtrHash, PtrEq> procIndex;
+    std::vector<int> wordDecl; // слово -> объявление (для Resolution)
+    std::vector<char> wordKnown;
+    std::vector<double> wordValue;
+    std::vector<char> wordInRange;
+    std::vector<VecKernel> kernels;
+    std::vector<LoopHoist> hoists;
+    std::vector<CseGroup> cse;
+    std::vector<CallWords> calls;
+    InlinePolicy policy;
+    std::vector<InlineSite> inlined;
+
+    std::vector<Scope> scopes; // области видимости текущей функции
+    Scope globals;             // верхний уровень main
+    int curFunc = 0;
+    int loopDepth = 0; // вложенность WHILE в разбираемой функции
+    bool mainCalls = false; // в main уже был вызов процедуры
+
+    bool fatal = false;
+
+    // ошибка разбора текущего оператора
+    bool failed = false;
+    int failWord = 0;
+    std::string failMsg;
+
+    // ---------- Вспомогательное ----------
+    const char *tok(int i, int lim) const { return (i >= 0 && i < lim) ? W[i] : nullptr; }
+
+    void setFatal(int word, const std::string &msg)
+    {
+        if (fatal)
+            return;
+        fatal = true;
+        errorWord = word;
+        error = msg;
+    }
+
+    void fail(int word, const std::string &msg)
+    {
+        if (failed)
+            return;
+        failed = true;
+        failWord = word < n ? word : n - 1;
+        failMsg = msg;
+    }
+
+    Expr *newExpr(Expr::Kind k, int word)
+    {
+        exprPool.emplace_back();
+        Expr *e = &exprPool.back();
+        e->kind = k;
+        e->word = word;
+        return e;
+    }
+
+    Stmt *newStmt(Stmt::Kind k, int word)
+    {
+        stmtPool.emplace_back();
+        Stmt *s = &stmtPool.back();
+        s->kind = k;
+        s->word = word;
+        return s;
+    }
+
+    static bool isIdentifier(const char *w)
+    {
+        return w && (std::isalpha((unsigned char)w[0]) || w[0] == '_');
+    }
+
+    bool isNumber(int i, int lim) const { return i < lim && T.isNumber(i); }
+
+    bool isKeyword(const char *w) const
+    {
+        return w == S.VAR || w == S.CONST || w == S.SET || w == S.IF || w == S.ELSE || w == S.WHILE ||
+               w == S.PROC || w == S.RETURN || w == S.PRINT || w == S.PRINTLN || w == S.HALT ||
+               w == S.BREAK || w == S.CONTINUE;
+    }
+
+    int findBuiltin(const char *w) const
+    {
+        const auto &B = builtins();
+        for (int i = 0; i < (int)B.size(); ++i)
+            if (std::strcmp(B[i].name, w) == 0)
+                return i;
+        return -1;
+    }
+
+    // Парная закрывающая скобка; строковые литералы (" текст ") пропускаются
+    int matchClose(int open, int lim) const
+    {
+        const char *o = W[open];
+        const char *c = (o == S.LBRACE) ? S.RBRACE : (o == S.LP) ? S.RP : S.RBRACKET;
+        int level = 0;
+        for (int i = open; i < lim; ++i)
+        {
+            const char *w = W[i];
+            if (w == S.QUOTE)
+                i += 2;
+            else if (w == o)
+                ++level;
+            else if (w == c && --level == 0)
+                return i;
+        }
+        return -1;
+    }
+
+    // ';' текущего оператора (не выходя за пределы блока)
+    int findSemi(int from, int lim) const
+    {
+        for (int i = from; i < lim; ++i)
+        {
+            const char *w = W[i];
+            if (w == S.SEMI)
+                return i;
+            if (w == S.LBRACE || w == S.RBRACE)
+                return -1;
+        }
+        return -1;
+    }
+
+    // Конец ошибочного оператора: после ';' или после закрытого им блока
+    int skipStatement(int p, int lim) const
+    {
+        for (int i = p; i < lim; ++i)
+        {
+            const char *w = W[i];
+            if (w == S.QUOTE)
+                i += 2;
+            else if (w == S.SEMI)
+                return i + 1;
+            else if (w == S.LBRACE)
+            {
+                int c = matchClose(i, lim);
+                if (c < 0)
+                    return lim;
+                if (c + 1 < lim && W[c + 1] == S.ELSE)
+                {
+                    i = c + 1;
+                    continue;
+                }
+                return c + 1;
+            }
+            else if (w == S.RBRACE)
+                return i > p ? i : i + 1;
+        }
+        return lim;
+    }
+
+    // ---------- Процедуры ----------
+    bool collectProcs()
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            const char *w = W[i];
+            if (w == S.QUOTE)
+            {
+                i += 2;
+                continue;
+            }
+            if (w != S.PROC)
+                continue;
+            FuncAst f;
+            const int open = procOpen(i, n);
+            if (open < 0 || !isIdentifier(W[i + 1]) || isKeyword(W[i + 1]))
+            {
+                setFatal(i, "PROC syntax: PROC name(params) { ... }");
+                return false;
+            }
+            if (open > i + 2 && !parseParams(i + 3, open - 1, f))
+                return false;
+            int close = matchClose(open, n);
+            if (close < 0)
+            {
+                setFatal(open, "Closing } not found");
+                return false;
+            }
+            if (procIndex.count(W[i + 1]))
+                continue; // как findPROC: побеждает первое определение
+            f.name = W[i + 1];
+            f.word = i + 1;
+            f.open = open;
+            f.close = close;
+            procIndex[f.name] = (int)funcs.size();
+            funcs.push_back(f);
+        }
+        return true;
+    }
+
+    // '{' тела процедуры со словом PROC в p: PROC name { или PROC name ( ... ) {
+    int procOpen(int p, int lim) const
+    {
+        int open = p + 2;
+        if (tok(open, lim) == S.LP)
+        {
+            const int close = matchClose(open, lim);
+            open = close < 0 ? -1 : close + 1;
+        }
+        return (open >= 0 && tok(open, lim) == S.LBRACE) ? open : -1;
+    }
+
+    // Параметры между скобками: a, b[], ...
+    bool parseParams(int p, int end, FuncAst &f)
+    {
+        while (p < end)
+        {
+            const char *w = W[p];
+            if (!isIdentifier(w) || isKeyword(w))
+            {
+                setFatal(p, "PROC parameter name expected");
+                return false;
+            }
+            const bool isArray = tok(p + 1, end) == S.LBRACKET;
+            if (isArray && tok(p + 2, end) != S.RBRACKET)
+            {
+                setFatal(p + 1, "PROC array parameter syntax: name[]");
+                return false;
+            }
+            for (size_t k = 0; k < f.paramWords.size(); ++k)
+                if (W[f.paramWords[k]] == w && f.paramArray[k] == (char)isArray)
+                {
+                    setFatal(p, std::string("Duplicate parameter '") + w + "'");
+                    return false;
+                }
+            if ((int)f.paramWords.size() == kMaxProcParams)
+            {
+                setFatal(p, "PROC has more than " + std::to_string(kMaxProcParams) + " parameters");
+                return false;
+            }
+            f.paramWords.push_back(p);
+            f.paramArray.push_back(isArray);
+            p += isArray ? 3 : 1;
+            if (p < end && W[p] != S.COMMA)
+            {
+                setFatal(p, "\",\" expected between PROC parameters");
+                return false;
+            }
+            if (p < end && ++p == end)
+            {
+                setFatal(p, "PROC parameter name expected");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ---------- Области видимости ----------
+    int declare(Id name, bool isArray, bool isConst, int word)
+    {
+        Scope &sc = scopes.back();
+        auto &m = isArray ? sc.arrs : sc.vars;
+        VarDecl d;
+        d.name = name;
+        d.func = curFunc;
+        d.isArray = isArray;
+        d.isConst = isConst;
+        d.word = word;
+        auto it = m.find(name);
+        if (it != m.end())
+            d.slot = decls[it->second].slot; // повторное объявление в том же блоке — та же ячейка
+        else if (isArray)
+        {
+            d.slot = funcs[curFunc].narrs++;
+            funcs[curFunc].arrNames.push_back(name);
+        }
+        else
+            d.slot = funcs[curFunc].nlocals++;
+        decls.push_back(d);
+        m[name] = (int)decls.size() - 1;
+        wordDecl[word] = (int)decls.size() - 1;
+        return (int)decls.size() - 1;
+    }
+
+    // Значение CONST известно при загрузке. Процедура может выполниться раньше
+    // объявления глобальной константы, поэтому ей значение подставляется,
+    // только если константа объявлена на верхнем уровне main до всех вызовов
+    void setKnown(int d, double value)
+    {
+        decls[d].known = true;
+        decls[d].value = value;
+        decls[d].procSafe = (curFunc == 0 && scopes.size() == 1 && !mainCalls);
+    }
+
+    // Имя в слове p; найденное объявление запоминается за словом
+    int lookup(int p, bool isArray)
+    {
+        int d = findDecl(W[p], isArray);
+        wordDecl[p] = d;
+        return d;
+    }
+
+    int findDecl(Id name, bool isArray) const
+    {
+        for (int s = (int)scopes.size() - 1; s >= 0; --s)
+        {
+            const auto &m = isArray ? scopes[s].arrs : scopes[s].vars;
+            auto it = m.find(name);
+            if (it != m.end())
+                return it->second;
+        }
+        if (curFunc != 0)
+        {
+            const auto &m = isArray ? globals.arrs : globals.vars;
+            auto it = m.find(name);
+            if (it != m.end())
+                return it->second;
+        }
+        return -1;
+    }
+
+    // ---------- Операторы ----------
+    std::vector<Stmt *> parseStatements(int p, int end)
+    {
+        std::vector<Stmt *> out;
+        while (p < end && !fatal)
+        {
+            int start = p;
+            Stmt *s = parseStatement(p, end);
+            if (failed)
+            {
+                s = newStmt(Stmt::ERROR, failWord);
+                s->text = INTERN().intern(failMsg);
+                failed = false;
+                p = skipStatement(start, end);
+                if (p <= start)
+                    p = start + 1;
+            }
+            if (s)
+                out.push_back(s);
+        }
+        return out;
+    }
+
+    // Блок { ... } начиная с open; p — слово после '}'
+    std::vector<Stmt *> parseBlock(int open, int &p, int lim)
+    {
+        if (open >= lim || W[open] != S.LBRACE)
+        {
+            fail(open, "\"{\" not found");
+            return {};
+        }
+        int close = matchClose(open, lim);
+        if (close < 0)
+        {
+            setFatal(open, "Closing } not found");
+            return {};
+        }
+        scopes.emplace_back();
+        std::vector<Stmt *> body = parseStatements(open + 1, close);
+        scopes.pop_back();
+        p = close + 1;
+        return body;
+    }
+
+    Stmt *parseStatement(int &p, int end)
+    {
+        const char *w = W[p];
+
+        if (w == S.SEMI)
+        {
+            ++p;
+            return nullptr;
+        }
+        if (w == S.CONST)
+        {
+            if (tok(p + 1, end) != S.VAR)
+            {
+                fail(p + 1, "VAR expected after CONST");
+                return nullptr;
+            }
+            ++p;
+            return parseDecl(p, end, true);
+        }
+        if (w == S.VAR)
+            return parseDecl(p, end, false);
+        if (w == S.PRINT || w == S.PRINTLN)
+            return parsePrint(p, end, w == S.PRINTLN);
+        if (w == S.IF || w == S.WHILE)
+            return parseIfWhile(p, end);
+        if (w == S.ELSE)
+        {
+            Stmt *s = newStmt(Stmt::BLOCK, p);
+            s->body = parseBlock(p + 1, p, end);
+            return s;
+        }
+        if (w == S.PROC)
+        {
+            // тело компилируется отдельно, здесь только пропускаем
+            const int open = procOpen(p, end);
+            int close = open >= 0 ? matchClose(open, end) : -1;
+            if (close < 0)
+            {
+                fail(p, "PROC syntax: PROC name(params) { ... }");
+                return nullptr;
+            }
+            p = close + 1;
+            return nullptr;
+        }
+        if (w == S.BREAK || w == S.CONTINUE)
+        {
+            if (loopDepth == 0)
+            {
+                fail(p, std::string(w) + " outside of WHILE");
+                return nullptr;
+            }
+            Stmt *s = newStmt(w == S.BREAK ? Stmt::BREAK : Stmt::CONTINUE, p);
+            if (tok(++p, end) != S.SEMI)
+            {
+                fail(p - 1, std::string(w) + " \";\" not found");
+                return nullptr;
+            }
+            ++p;
+            return s;
+        }
+        if (w == S.RETURN || w == S.HALT)
+        {
+            Stmt *s = newStmt(w == S.RETURN ? Stmt::RETURN : Stmt::HALT, p);
+            ++p;
+            const char *next = tok(p, end);
+            if (w == S.RETURN && next && next != S.SEMI && next != S.RBRACE)
+            {
+                // RETURN e;
+                const int semi = findSemi(p, end);
+                if (semi < 0)
+                {
+                    fail(p - 1, "RETURN \";\" not found");
+                    return nullptr;
+                }
+                s->e = parseExprRange(p, semi);
+                if (failed)
+                    return nullptr;
+                if (tailCall(s->e))
+                {
+                    s->tail = true;
+                    calls.back().tail = true; // внешний вызов записан последним
+                }
+                p = semi;
+            }
+            if (tok(p, end) == S.SEMI)
+                ++p;
+            return s;
+        }
+        if (isIdentifier(w) && !isKeyword(w))
+        {
+            const char *next = tok(p + 1, end);
+            if (next == S.SEMI || next == S.LP)
+                return parseCall(p, end);
+            if (next == S.EQ)
+                return parseAssign(p, end);
+            if (next == S.LBRACKET)
+                return parseAssignElem(p, end);
+        }
+        fail(p, "Unknown command");
+        return nullptr;
+    }
+
+    Stmt *parseDecl(int &p, int end, bool isConst)
+    {
+        const int at = p;
+        const char *name = tok(p + 1, end);
+        if (!isIdentifier(name) || isKeyword(name))
+        {
+            fail(p + 1, "VAR name not found");
+            return nullptr;
+        }
+        const char *t2 = tok(p + 2, end);
+
+        if (t2 == S.SEMI) // VAR x;
+        {
+            Stmt *s = newStmt(Stmt::DECL, at);
+            s->decl = declare(name, false, isConst, p + 1);
+            if (isConst)
+                setKnown(s->decl, 0.0);
+            p += 3;
+            return s;
+        }
+        if (t2 == S.LBRACKET) // VAR x[N];
+        {
+            if (!isNumber(p + 3, end) || tok(p + 4, end) != S.RBRACKET || tok(p + 5, end) != S.SEMI)
+            {
+                fail(p + 2, "VAR array syntax: VAR name[size];");
+                return nullptr;
+            }
+            Stmt *s = newStmt(Stmt::DECLARR, at);
+            s->size = T.number(p + 3);
+            s->decl = declare(name, true, false, p + 1);
+            decls[s->decl].size = std::floor(s->size);
+            p += 6;
+            return s;
+        }
+        if (t2 == S.EQ) // VAR x = e;
+        {
+            int semi = findSemi(p + 3, end);
+            if (semi < 0)
+            {
+                fail(p, "VAR \";\" not found");
+                return nullptr;
+            }
+            Expr *e = parseExprRange(p + 3, semi);
+            if (failed)
+                return nullptr;
+            Stmt *s = newStmt(Stmt::DECL, at);
+            s->e = e;
+            s->decl = declare(name, false, isConst, p + 1);
+            if (isConst && e->kind == Expr::NUM)
+                setKnown(s->decl, e->num);
+            p = semi + 1;
+            return s;
+        }
+        fail(p + 2, "VAR = no found");
+        return nullptr;
+    }
+
+    Stmt *parsePrint(int &p, int end, bool ln)
+    {
+        if (tok(p + 1, end) == S.QUOTE)
+        {
+            if (tok(p + 3, end) != S.QUOTE)
+            {
+                fail(p + 3, "PRINT TEXT \" CLOSE not found");
+                return nullptr;
+            }
+            if (tok(p + 4, end) != S.SEMI)
+            {
+                fail(p + 4, "PRINT TEXT\";\" not found");
+                return nullptr;
+            }
+            Stmt *s = newStmt(Stmt::PRINTS, p);
+            s->text = W[p + 2];
+            s->ln = ln;
+            p += 5;
+            return s;
+        }
+        int semi = findSemi(p + 1, end);
+        if (semi < 0)
+        {
+            fail(p, "PRINT \";\" not found");
+            return nullptr;
+        }
+        Expr *e = parseExprRange(p + 1, semi);
+        if (failed)
+            return nullptr;
+        Stmt *s = newStmt(Stmt::PRINTE, p);
+        s->e = e;
+        s->ln = ln;
+        p = semi + 1;
+        return s;
+    }
+
+    Stmt *parseIfWhile(int &p, int end)
+    {
+        const bool isIf = (W[p] == S.IF);
+        const int at = p;
+        if (tok(p + 1, end) != S.LP)
+        {
+            fail(p + 1, isIf ? "IF \"(\" not found" : "WHILE \"(\" not found");
+            return nullptr;
+        }
+        int closeP = matchClose(p + 1, end);
+        if (closeP < 0)
+        {
+            fail(p + 1, "Closing ) not found");
+            return nullptr;
+        }
+        Expr *cond = parseExprRange(p + 2, closeP);
+        if (failed)
+            return nullptr;
+
+        Stmt *s = newStmt(isIf ? Stmt::IF : Stmt::WHILE, at);
+        s->e = cond;
+        p = closeP + 1;
+        loopDepth += !isIf;
+        s->body = parseBlock(p, p, end);
+        loopDepth -= !isIf;
+        if (failed || fatal)
+            return nullptr;
+        s->close = p - 1;
+        if (isIf && tok(p, end) == S.ELSE)
+        {
+            s->orelse = parseBlock(p + 1, p, end);
+            if (failed || fatal)
+                return nullptr;
+        }
+        if (!isIf)
+            matchVecLoop(s);
+        return s;
+    }
+
+    // ---------- Поэлементные циклы ----------
+    //   WHILE (i < N) { a[i] = f(...); ... i = i + 1; }
+    // В теле только присваивания элементам [i] и шаг счётчика; f — + - * /
+    // над числами, i, элементами [i] и переменными, не меняющимися в цикле.
+    // Всё прочее (PRINT, вызовы, IF, другие индексы) — обычный цикл.
+    VecRef vecRef(int d, int word) const
+    {
+        VecRef r;
+        r.slot = decls[d].slot;
+        r.global = decls[d].func != curFunc;
+        r.word = word;
+        return r;
+    }
+
+    bool isVar(const Expr *e, int d) const { return e && e->kind == Expr::VAR && e->decl == d; }
+
+    bool vecExpr(const Expr *e, int counter, VecKernel &k, int depth)
+    {
+        if (depth > VecKernel::kMaxDepth)
+            return false;
+        switch (e->kind)
+        {
+        case Expr::NUM:
+            k.consts.push_back(e->num);
+            k.code.push_back({V_CONST, (int)k.consts.size() - 1});
+            return true;
+        case Expr::VAR:
+            if (e->decl == counter)
+                k.code.push_back({V_INDEX, 0});
+            else
+            {
+                k.scalars.push_back(vecRef(e->decl, e->word));
+                k.code.push_back({V_SCALAR, (int)k.scalars.size() - 1});
+            }
+            return true;
+        case Expr::ELEM:
+            if (!isVar(e->l, counter))
+                return false;
+            k.arrays.push_back(vecRef(e->decl, e->word));
+            k.code.push_back({V_ARR, (int)k.arrays.size() - 1});
+            return true;
+        case Expr::NEG:
+            // -x == x * -1 и для нуля (-0)
+            if (!vecExpr(e->l, counter, k, depth))
+                return false;
+            k.consts.push_back(-1.0);
+            k.code.push_back({V_CONST, (int)k.consts.size() - 1});
+            k.code.push_back({V_MUL, 0});
+            return depth + 1 <= VecKernel::kMaxDepth;
+        case Expr::BIN:
+        {
+            static const VecOp ops[] = {V_ADD, V_SUB, V_MUL, V_DIV};
+            if (e->op < OP_ADD || e->op > OP_DIV)
+                return false;
+            if (!vecExpr(e->l, counter, k, depth) || !vecExpr(e->r, counter, k, depth + 1))
+                return false;
+            k.code.push_back({ops[e->op - OP_ADD], 0});
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    void matchVecLoop(Stmt *s)
+    {
+#ifdef LILC_NO_VECLOOP
+        return;
+#endif
+        const Expr *c = s->e;
+        if (c->kind != Expr::CMP || (c->op != CMP_LT && c->op != CMP_LE) || c->l->kind != Expr::VAR)
+            return;
+        const int counter = c->l->decl;
+        if (decls[counter].isArray || s->body.size() < 2)
+            return;
+
+        // последний оператор — i = i + 1 (или 1 + i)
+        const Stmt *step = s->body.back();
+        if (step->kind != Stmt::ASSIGN || step->decl != counter || step->e->kind != Expr::BIN || step->e->op != OP_ADD)
+            return;
+        const Expr *sl = step->e->l, *sr = step->e->r;
+        const bool one = (isVar(sl, counter) && sr->kind == Expr::NUM && sr->num == 1.0) ||
+                         (isVar(sr, counter) && sl->kind == Expr::NUM && sl->num == 1.0);
+        if (!one)
+            return;
+
+        VecKernel k;
+        k.whileWord = s->word;
+        k.counter = vecRef(counter, c->l->word);
+        k.inclusive = (c->op == CMP_LE);
+        if (c->r->kind == Expr::NUM)
+            k.limitConst = c->r->num;
+        else if (c->r->kind == Expr::VAR && c->r->decl != counter)
+            k.limitVar = vecRef(c->r->decl, c->r->word);
+        else
+            return;
+
+        for (size_t i = 0; i + 1 < s->body.size(); ++i)
+        {
+            const Stmt *a = s->body[i];
+            if (a->kind != Stmt::ASSIGNARR || !isVar(a->idx, counter))
+                return;
+            if (!vecExpr(a->e, counter, k, 1))
+                return;
+            k.arrays.push_back(vecRef(a->decl, a->word));
+            k.code.push_back({V_STORE, (int)k.arrays.size() - 1});
+        }
+        s->kernel = (int)kernels.size();
+        kernels.push_back(std::move(k));
+    }
+
+    Stmt *parseCall(int &p, int end)
+    {
+        auto it = procIndex.find(W[p]);
+        if (it == procIndex.end())
+        {
+            fail(p, std::string("Procedure '") + W[p] + "' not found");
+            return nullptr;
+        }
+        const int at = p;
+        Expr *e = parseProcCall(p, end, it->second);
+        if (failed)
+            return nullptr;
+        if (tok(p, end) != S.SEMI)
+        {
+            fail(p, "\";\" expected after procedure call");
+            return nullptr;
+        }
+        Stmt *s = newStmt(Stmt::CALL, at);
+        s->decl = it->second;
+        s->e = e;
+        ++p;
+        return s;
+    }
+
+    // name  |  name ( арг, ... ): значения — выражения, массив — имя без индекса
+    Expr *parseProcCall(int &p, int lim, int f)
+    {
+        const FuncAst &F = funcs[f];
+        const int at = p;
+        Expr *e = newExpr(Expr::CALLP, at);
+        e->op = f;
+        CallWords site;
+        site.word = at;
+        site.func = f;
+        bool extra = false; // аргументов больше, чем параметров
+        ++p;
+        if (tok(p, lim) == S.LP)
+        {
+            const int close = matchClose(p, lim);
+            if (close < 0)
+            {
+                fail(p, "Closing ) not found");
+                return nullptr;
+            }
+            site.close = close;
+            ++p;
+            Expr **tail = &e->l;
+            while (p < close)
+            {
+                const size_t k = site.from.size();
+                if (k > 0 && W[p++] != S.COMMA)
+                {
+                    fail(p - 1, "\",\" expected between arguments");
+                    return nullptr;
+                }
+                if (k >= F.paramArray.size())
+                {
+                    extra = true;
+                    break;
+                }
+                const int from = p;
+                Expr *arg;
+                if (F.paramArray[k])
+                {
+                    // массив передаётся по ссылке, без копии
+                    const char *next = tok(p + 1, close);
+                    if (!isIdentifier(tok(p, close)) || (p + 1 < close && next != S.COMMA))
+                    {
+                        fail(p, std::string("Array name expected for parameter '") + W[F.paramWords[k]] + "'");
+                        return nullptr;
+                    }
+                    const int d = lookup(p, true);
+                    if (d < 0)
+                    {
+                        fail(p, std::string("Array '") + W[p] + "' not found");
+                        return nullptr;
+                    }
+                    arg = newExpr(Expr::ARR, p);
+                    arg->decl = d;
+                    ++p;
+                    span(arg, from, p);
+                }
+                else
+                    arg = parseOr(p, close);
+                if (failed)
+                    return nullptr;
+                Expr *a = newExpr(Expr::ARGS, from);
+                a->l = arg;
+                *tail = a;
+                tail = &a->r;
+                site.from.push_back(from);
+                site.to.push_back(p);
+                site.isArray.push_back(F.paramArray[k]);
+            }
+            p = close + 1;
+        }
+        if (extra || site.from.size() != F.paramArray.size())
+        {
+            fail(at, std::string("Procedure '") + W[at] + "' expects " + std::to_string(F.paramArray.size()) +
+                         " arguments");
+            return nullptr;
+        }
+        if (curFunc == 0)
+            mainCalls = true;
+        calls.push_back(site);
+        return span(e, at, p);
+    }
+
+    // RETURN f(...); в процедуре можно выполнить в её же кадре, если ни один
+    // массив-аргумент не лежит в этом кадре: глобальные и параметры-массивы
+    // принадлежат вызывающим
+    bool tailCall(const Expr *e) const
+    {
+        if (curFunc == 0 || !e || e->kind != Expr::CALLP)
+            return false;
+        int arrayParams = 0;
+        for (char isArray : funcs[curFunc].paramArray)
+            arrayParams += isArray;
+        for (const Expr *a = e->l; a; a = a->r)
+            if (a->l->kind == Expr::ARR && decls[a->l->decl].func == curFunc && decls[a->l->decl].slot >= arrayParams)
+                return false;
+        return true;
+    }
+
+    Stmt *parseAssign(int &p, int end)
+    {
+        int semi = findSemi(p + 2, end);
+        if (semi < 0)
+        {
+            fail(p, "SET ';' not found");
+            return nullptr;
+        }
+        int d = lookup(p, false);
+        if (d < 0)
+        {
+            fail(p, std::string("Variable '") + W[p] + "' not found");
+            return nullptr;
+        }
+        Expr *e = parseExprRange(p + 2, semi);
+        if (failed)
+            return nullptr;
+        Stmt *s;
+        if (decls[d].isConst)
+        {
+            s = newStmt(Stmt::WARN, p + 1);
+            s->text = "Attempt to assign a value to a constant";
+        }
+        else
+        {
+            s = newStmt(Stmt::ASSIGN, p);
+            s->decl = d;
+            s->e = e;
+        }
+        p = semi + 1;
+        return s;
+    }
+
+    Stmt *parseAssignElem(int &p, int end)
+    {
+        int close = matchClose(p + 1, end);
+        if (close < 0)
+        {
+            fail(p + 1, "SET array syntax error: missing ']' or index");
+            return nullptr;
+        }
+        if (tok(close + 1, end) != S.EQ)
+        {
+            fail(close + 1, "SET array syntax error: '=' or ';' not found");
+            return nullptr;
+        }
+        int semi = findSemi(close + 2, end);
+        if (semi < 0)
+        {
+            fail(p, "SET array syntax error: '=' or ';' not found");
+            return nullptr;
+        }
+        int d = lookup(p, true);
+        if (d < 0)
+        {
+            fail(p, std::string("Array '") + W[p] + "' not found");
+            return nullptr;
+        }
+        Expr *idx = parseExprRange(p + 2, close);
+        if (failed)
+            return nullptr;
+        Expr *e = parseExprRange(close + 2, semi);
+        if (failed)
+            return nullptr;
+        Stmt *s = newStmt(Stmt::ASSIGNARR, p);
+        s->decl = d;
+        s->idx = idx;
+        s->e = e;
+        p = semi + 1;
+        return s;
+    }
+
+    // ---------- Выражения ----------
+    //   list   := or {',' or}
+    //   or     := and {'||' and}
+    //   and    := eq {'&&' eq}
+    //   eq     := rel {('=='|'!=') rel}
+    //   rel    := sum {('<'|'<='|'>'|'>=') sum}
+    //   sum    := term {('+'|'-') term}
+    //   term   := factor {('*'|'/'|'%') factor}
+    //   factor := power {'^' power}      (слева направо, как в tinyexpr)
+    //   power  := {'+'|'-'} base | '!' power
+    //   base   := number | var | var '[' list ']' | fn ... | '(' list ')'
+    Expr *parseExprRange(int from, int to)
+    {
+        if (from >= to)
+        {
+            fail(from, "Expression expected");
+            return nullptr;
+        }
+        int p = from;
+        Expr *e = parseList(p, to);
+        if (!failed && p != to)
+            fail(p, "Unexpected token in expression");
+        return failed ? nullptr : fold(e);
+    }
+
+    // ---------- Свёртка констант ----------
+    // Узел, все операнды которого — числа, заменяется числом. Считается
+    // теми же операциями, что и в ВМ, поэтому результат не меняется.
+    static double foldBin(int op, double a, double b)
+    {
+        switch (op)
+        {
+        case OP_ADD:
+            return a + b;
+        case OP_SUB:
+            return a - b;
+        case OP_MUL:
+            return a * b;
+        case OP_DIV:
+            return a / b;
+        case OP_MOD:
+            return std::fmod(a, b);
+        default:
+            return std::pow(a, b);
+        }
+    }
+
+    static double foldCmp(int op, double a, double b)
+    {
+        switch (op)
+        {
+        case CMP_LT:
+            return a < b;
+        case CMP_LE:
+            return a <= b;
+        case CMP_GT:
+            return a > b;
+        case CMP_GE:
+            return a >= b;
+        case CMP_EQ:
+            return a == b;
+        default:
+            return a != b;
+        }
+    }
+
+    static Expr *toNum(Expr *e, double v)
+    {
+        e->kind = Expr::NUM;
+        e->num = v;
+        e->l = e->r = nullptr;
+        return e;
+    }
+
+    Expr *fold(Expr *e)
+    {
+        if (!e || e->kind == Expr::NUM || e->kind == Expr::VAR)
+            return e;
+        if (e->l)
+            e->l = fold(e->l);
+        if (e->r)
+            e->r = fold(e->r);
+        const bool ln = e->l && e->l->kind == Expr::NUM;
+        const bool rn = e->r && e->r->kind == Expr::NUM;
+        const double a = ln ? e->l->num : 0.0;
+        const double b = rn ? e->r->num : 0.0;
+        switch (e->kind)
+        {
+        case Expr::NEG:
+            return ln ? toNum(e, -a) : e;
+        case Expr::NOT:
+            return ln ? toNum(e, a == 0.0 ? 1.0 : 0.0) : e;
+        case Expr::BIN:
+            return (ln && rn) ? toNum(e, foldBin(e->op, a, b)) : e;
+        case Expr::CMP:
+            return (ln && rn) ? toNum(e, foldCmp(e->op, a, b)) : e;
+        case Expr::AND:
+            // только оба числа: правая часть может сообщить об ошибке (a[i])
+            return (ln && rn) ? toNum(e, (a != 0.0 && b != 0.0) ? 1.0 : 0.0) : e;
+        case Expr::OR:
+            return (ln && rn) ? toNum(e, (a != 0.0 || b != 0.0) ? 1.0 : 0.0) : e;
+        case Expr::CALLF:
+        {
+            const Builtin &B = builtins()[e->op];
+            if (B.arity == 1 && ln)
+                return toNum(e, B.f1(a));
+            if (B.arity == 2 && ln && rn)
+                return toNum(e, B.f2(a, b));
+            return e;
+        }
+        case Expr::COMMA:
+            return (ln && rn) ? toNum(e, b) : e;
+        default:
+            return e;
+        }
+    }
+
+    // Оператор сравнения в позиции p; len — сколько слов он занимает
+    int peekCmp(int p, int lim, int &len) const
+    {
+        const char *w = tok(p, lim);
+        const char *w1 = tok(p + 1, lim);
+        len = 1;
+        if (!w)
+            return -1;
+        if (w == S.EQEQ)
+            return CMP_EQ;
+        if (w == S.NEQ)
+            return CMP_NE;
+        if (w == S.LEQ)
+            return CMP_LE;
+        if (w == S.GEQ)
+            return CMP_GE;
+        if (w == S.EQ && w1 == S.EQ)
+        {
+            len = 2;
+            return CMP_EQ;
+        }
+        if (w == S.LT || w == S.GT)
+        {
+            if (w1 == S.EQ)
+            {
+                len = 2;
+                return w == S.LT ? CMP_LE : CMP_GE;
+            }
+            return w == S.LT ? CMP_LT : CMP_GT;
+        }
+        return -1;
+    }
+
+    static Expr *span(Expr *e, int from, int to)
+    {
+        e->from = from;
+        e->to = to;
+        return e;
+    }
+
+    Expr *parseList(int &p, int lim)
+    {
+        const int start = p;
+        Expr *e = parseOr(p, lim);
+        while (!failed && tok(p, lim) == S.COMMA)
+        {
+            Expr *c = newExpr(Expr::COMMA, p);
+            ++p;
+            c->l = e;
+            c->r = parseOr(p, lim);
+            span(c, start, p);
+            e = c;
+        }
+        return e;
+    }
+
+    Expr *parseOr(int &p, int lim)
+    {
+        const int start = p;
+        Expr *e = parseAnd(p, lim);
+        while (!failed && tok(p, lim) == S.OROR)
+        {
+            Expr *c = newExpr(Expr::OR, p);
+            ++p;
+            c->l = e;
+            c->r = parseAnd(p, lim);
+            span(c, start, p);
+            e = c;
+        }
+        return e;
+    }
+
+    Expr *parseAnd(int &p, int lim)
+    {
+        const int start = p;
+        Expr *e = parseEq(p, lim);
+        while (!failed && tok(p, lim) == S.ANDAND)
+        {
+            Expr *c = newExpr(Expr::AND, p);
+            ++p;
+            c->l = e;
+            c->r = parseEq(p, lim);
+            span(c, start, p);
+            e = c;
+        }
+        return e;
+    }
+
+    Expr *parseEq(int &p, int lim)
+    {
+        const int start = p;
+        Expr *e = parseRel(p, lim);
+        int len;
+        int op;
+        while (!failed && ((op = peekCmp(p, lim, len)) == CMP_EQ || op == CMP_NE))
+        {
+            Expr *c = newExpr(Expr::CMP, p);
+            c->op = op;
+            p += len;
+            c->l = e;
+            c->r = parseRel(p, lim);
+            span(c, start, p);
+            e = c;
+        }
+        return e;
+    }
+
+    Expr *parseRel(int &p, int lim)
+    {
+        const int start = p;
+        Expr *e = parseSum(p, lim);
+        int len;
+        int op;
+        while (!failed && (op = peekCmp(p, lim, len)) >= 0 && op != CMP_EQ && op != CMP_NE)
+        {
+            Expr *c = newExpr(Expr::CMP, p);
+            c->op = op;
+            p += len;
+            c->l = e;
+            c->r = parseSum(p, lim);
+            span(c, start, p);
+            e = c;
+        }
+        return e;
+    }
+
+    Expr *parseSum(int &p, int lim)
+    {
+        const int start = p;
+        Expr *e = parseTerm(p, lim);
+        while (!failed)
+        {
+            const char *w = tok(p, lim);
+            if (w != S.PLUS && w != S.MINUS)
+                break;
+            Expr *b = newExpr(Expr::BIN, p);
+            b->op = (w == S.PLUS) ? OP_ADD : OP_SUB;
+            ++p;
+            b->l = e;
+            b->r = parseTerm(p, lim);
+            span(b, start, p);
+            e = b;
+        }
+        return e;
+    }
+
+    Expr *parseTerm(int &p, int lim)
+    {
+        const int start = p;
+        Expr *e = parseFactor(p, lim);
+        while (!failed)
+        {
+            const char *w = tok(p, lim);
+            if (w != S.STAR && w != S.SLASH && w != S.PERCENT)
+                break;
+            Expr *b = newExpr(Expr::BIN, p);
+            b->op = (w == S.STAR) ? OP_MUL : (w == S.SLASH) ? OP_DIV : OP_MOD;
+            ++p;
+            b->l = e;
+            b->r = parseFactor(p, lim);
+            span(b, start, p);
+            e = b;
+        }
+        return e;
+    }
+
+    Expr *parseFactor(int &p, int lim)
+    {
+        const int start = p;
+        Expr *e = parsePower(p, lim);
+        while (!failed && tok(p, lim) == S.CARET)
+        {
+            Expr *b = newExpr(Expr::BIN, p);
+            b->op = OP_POW;
+            ++p;
+            b->l = e;
+            b->r = parsePower(p, lim);
+            span(b, start, p);
+            e = b;
+        }
+        return e;
+    }
+
+    Expr *parsePower(int &p, int lim)
+    {
+        if (tok(p, lim) == S.NOT)
+        {
+            Expr *u = newExpr(Expr::NOT, p);
+            ++p;
+            u->l = parsePower(p, lim);
+            return span(u, u->word, p);
+        }
+        bool neg = false;
+        int at = p;
+        for (;;)
+        {
+            const char *w = tok(p, lim);
+            if (w == S.MINUS)
+                neg = !neg;
+            else if (w != S.PLUS)
+                break;
+            ++p;
+        }
+        Expr *e = parseBase(p, lim);
+        if (neg && !failed)
+        {
+            Expr *u = newExpr(Expr::NEG, at);
+            u->l = e;
+            e = span(u, at, p);
+        }
+        return e;
+    }
+
+    Expr *parseBase(int &p, int lim)
+    {
+        const char *w = tok(p, lim);
+        if (!w)
+        {
+            fail(p, "Expression expected");
+            return nullptr;
+        }
+
+        if (T.kind(p) == TK_BADNUM)
+        {
+            fail(p, std::string("Invalid number '") + w + "'");
+            return nullptr;
+        }
+        if (T.isNumber(p))
+        {
+            Expr *e = newExpr(Expr::NUM, p);
+            e->num = T.number(p);
+            ++p;
+            return span(e, p - 1, p);
+        }
+
+        if (w == S.LP)
+        {
+            int close = matchClose(p, lim);
+            if (close < 0)
+            {
+                fail(p, "Closing ) not found");
+                return nullptr;
+            }
+            Expr *e = parseExprRange(p + 1, close);
+            if (e)
+                span(e, p, close + 1); // вместе со скобками
+            p = close + 1;
+            return e;
+        }
+
+        if (!isIdentifier(w) || isKeyword(w))
+        {
+            fail(p, std::string("Unexpected token '") + w + "' in expression");
+            return nullptr;
+        }
+
+        int fn = findBuiltin(w);
+        if (fn >= 0)
+            return parseBuiltin(p, lim, fn);
+
+        auto proc = procIndex.find(w);
+        if (proc != procIndex.end() && tok(p + 1, lim) == S.LP)
+            return parseProcCall(p, lim, proc->second);
+
+        if (tok(p + 1, lim) == S.LBRACKET)
+        {
+            int close = matchClose(p + 1, lim);
+            if (close < 0)
+            {
+                fail(p + 1, "Closing ] not found");
+                return nullptr;
+            }
+            int d = lookup(p, true);
+            if (d < 0)
+            {
+                fail(p, std::string("Array '") + w + "' not found");
+                return nullptr;
+            }
+            Expr *e = newExpr(Expr::ELEM, p);
+            e->decl = d;
+            e->l = parseExprRange(p + 2, close);
+            span(e, p, close + 1);
+            p = close + 1;
+            return e;
+        }
+
+        int d = lookup(p, false);
+        if (d < 0)
+        {
+            fail(p, std::string("Variable '") + w + "' not found");
+            return nullptr;
+        }
+        const VarDecl &vd = decls[d];
+        if (vd.known && (vd.func == curFunc || vd.procSafe))
+        {
+            // CONST с известным значением — сразу число
+            Expr *e = newExpr(Expr::NUM, p);
+            e->num = vd.value;
+            wordKnown[p] = 1;
+            wordValue[p] = vd.value;
+            ++p;
+            return span(e, p - 1, p);
+        }
+        Expr *e = newExpr(Expr::VAR, p);
+        e->decl = d;
+        ++p;
+        return span(e, p - 1, p);
+    }
+
+    Expr *parseBuiltin(int &p, int lim, int fn)
+    {
+        const Builtin &B = builtins()[fn];
+        const int at = p;
+        ++p;
+        if (B.arity == 0)
+        {
+            if (tok(p, lim) == S.LP && tok(p + 1, lim) == S.RP)
+                p += 2;
+            Expr *e = newExpr(Expr::NUM, at);
+            e->num = B.value;
+            return span(e, at, p);
+        }
+        Expr *e = newExpr(Expr::CALLF, at);
+        e->op = fn;
+        if (B.arity == 1)
+        {
+            // как в tinyexpr: sin x == sin(x)
+            e->l = parsePower(p, lim);
+            return span(e, at, p);
+        }
+        if (tok(p, lim) != S.LP)
+        {
+            fail(p, std::string("\"(\" expected after ") + B.name);
+            return nullptr;
+        }
+        int close = matchClose(p, lim);
+        if (close < 0)
+        {
+            fail(p, "Closing ) not found");
+            return nullptr;
+        }
+        ++p;
+        e->l = parseOr(p, close);
+        if (!failed && tok(p, close) != S.COMMA)
+            fail(p, std::string(B.name) + " expects 2 arguments");
+        ++p;
+        if (!failed)
+            e->r = parseOr(p, close);
+        if (!failed && p != close)
+            fail(p, std::string(B.name) + " expects 2 arguments");
+        p = close + 1;
+        return span(e, at, p);
+    }
+
+    // ---------- Встраивание процедур ----------
+    // Вызов небольшой процедуры без вызовов внутри заменяется копией её тела:
+    // локальные переменные и массивы копии получают свои ячейки в кадре
+    // вызывающей функции, RETURN становится переходом в конец копии. Слова
+    // операторов остаются словами тела процедуры — ошибки те же.
+    std::vector<char> inlineState; // 0 — не смотрели, 1 — в обработке, 2 — готово
+    std::unordered_map<int, int> inlineDecls; // объявление процедуры → копия
+
+    static int countStmts(const std::vector<Stmt *> &body)
+    {
+        int k = 0;
+        for (const Stmt *s : body)
+            k += 1 + countStmts(s->body) + countStmts(s->orelse);
+        return k;
+    }
+
+    static bool exprCalls(const Expr *e)
+    {
+        return e && (e->kind == Expr::CALLP || exprCalls(e->l) || exprCalls(e->r));
+    }
+
+    // Оператор вызывает процедуру: сам или внутри выражения
+    static bool stmtCalls(const Stmt *s)
+    {
+        return s->kind == Stmt::CALL || exprCalls(s->e) || exprCalls(s->idx);
+    }
+
+    static bool hasCalls(const std::vector<Stmt *> &body)
+    {
+        for (const Stmt *s : body)
+            if (stmtCalls(s) || hasCalls(s->body) || hasCalls(s->orelse))
+                return true;
+        return false;
+    }
+
+    // Сначала встраиваем в тело функции f, потом f можно встраивать саму.
+    // Рекурсивные процедуры остаются с вызовом (состояние 1 на пути)
+    void inlineInto(int f)
+    {
+        if (inlineState[f])
+            return;
+        inlineState[f] = 1;
+        inlineBody(funcs[f].body, f);
+        inlineState[f] = 2;
+    }
+
+    bool canInline(int callee, int caller)
+    {
+        if (callee == caller || (int)inlined.size() >= policy.maxSites)
+            return false;
+        inlineInto(callee);
+        const std::vector<Stmt *> &body = funcs[callee].body;
+        return inlineState[callee] == 2 && !hasCalls(body) && countStmts(body) <= policy.maxStatements;
+    }
+
+    void inlineBody(std::vector<Stmt *> &body, int caller)
+    {
+        for (Stmt *&s : body)
+        {
+            inlineBody(s->body, caller);
+            inlineBody(s->orelse, caller);
+            if (s->kind == Stmt::CALL && canInline(s->decl, caller))
+                s = inlineCall(s, caller);
+        }
+    }
+
+    Stmt *inlineCall(const Stmt *call, int caller)
+    {
+        const int callee = call->decl;
+        curFunc = caller;
+        inlineDecls.clear();
+        Stmt *s = newStmt(Stmt::INLINE, call->word);
+        s->decl = callee;
+        // параметр-значение — новая ячейка с аргументом, массив — сам аргумент
+        const std::vector<int> &params = funcs[callee].params;
+        const Expr *a = call->e->l;
+        for (size_t k = 0; k < params.size(); ++k, a = a->r)
+        {
+            if (a->l->kind == Expr::ARR)
+            {
+                inlineDecls[params[k]] = a->l->decl;
+                continue;
+            }
+            Stmt *d = newStmt(Stmt::DECL, call->word);
+            d->decl = cloneDecl(params[k], callee);
+            d->e = a->l;
+            s->body.push_back(d);
+        }
+        for (Stmt *c : cloneBody(funcs[callee].body, callee))
+            s->body.push_back(c);
+
+        InlineSite site;
+        site.func = caller;
+        site.callee = callee;
+        site.word = call->word;
+        site.statements = countStmts(s->body);
+        inlined.push_back(site);
+        return s;
+    }
+
+    // Своё объявление процедуры — новая ячейка вызывающей функции
+    int cloneDecl(int d, int callee)
+    {
+        if (d < 0 || decls[d].func != callee)
+            return d;
+        auto it = inlineDecls.find(d);
+        if (it != inlineDecls.end())
+            return it->second;
+        VarDecl v = decls[d];
+        v.func = curFunc;
+        if (v.isArray)
+        {
+            v.slot = funcs[curFunc].narrs++;
+            funcs[curFunc].arrNames.push_back(v.name);
+        }
+        else
+            v.slot = funcs[curFunc].nlocals++;
+        decls.push_back(v);
+        inlineDecls[d] = (int)decls.size() - 1;
+        return (int)decls.size() - 1;
+    }
+
+    Expr *cloneExpr(const Expr *e, int callee)
+    {
+        if (!e)
+            return nullptr;
+        Expr *c = newExpr(e->kind, e->word);
+        *c = *e;
+        if (c->kind == Expr::VAR || c->kind == Expr::ELEM || c->kind == Expr::ARR)
+            c->decl = cloneDecl(e->decl, callee);
+        c->l = cloneExpr(e->l, callee);
+        c->r = cloneExpr(e->r, callee);
+        return c;
+    }
+
+    std::vector<Stmt *> cloneBody(const std::vector<Stmt *> &body, int callee)
+    {
+        std::vector<Stmt *> out;
+        for (const Stmt *s : body)
+        {
+            Stmt *c = newStmt(s->kind, s->word);
+            *c = *s;
+            if (c->kind != Stmt::CALL && c->kind != Stmt::INLINE)
+                c->decl = cloneDecl(s->decl, callee);
+            c->e = cloneExpr(s->e, callee);
+            c->idx = cloneExpr(s->idx, callee);
+            c->body = cloneBody(s->body, callee);
+            c->orelse = cloneBody(s->orelse, callee);
+            c->kernel = -1; // ядро ссылалось на ячейки процедуры
+            if (c->kind == Stmt::WHILE)
+                matchVecLoop(c);
+            out.push_back(c);
+        }
+        return out;
+    }
+
+    // ---------- Границы индексов ----------
+    // Счётчик цикла  i = C; WHILE (i < N) { ... i = i + K; }  с целыми C >= 0 и
+    // K > 0, числом N и без других записей i в теле внутри тела целый и лежит
+    // в [C, N). Доступы a[i], a[i + c], a[i - c] и a[число] к массиву своей
+    // функции с известным размером проверяются здесь, а не при выполнении:
+    // объявление массива стоит раньше по тексту, значит, уже выполнено.
+    struct IndexRange
+    {
+        int decl = -1;
+        double lo = 0.0, hi = 0.0; // целые границы включительно
+    };
+    std::vector<IndexRange> ranges; // счётчики объемлющих циклов
+
+    static bool isInt(double v) { return v == std::floor(v) && std::fabs(v) < 4503599627370496.0; }
+
+    // Пишет ли body переменную d (последние skipLast операторов не считаются)
+    bool writesVar(const std::vector<Stmt *> &body, int d, size_t skipLast) const
+    {
+        for (size_t k = 0; k + skipLast < body.size(); ++k)
+        {
+            const Stmt *s = body[k];
+            if ((s->kind == Stmt::ASSIGN || s->kind == Stmt::DECL) && s->decl == d)
+                return true;
+            if (stmtCalls(s) && decls[d].func == 0)
+                return true; // процедура может писать глобальные
+            if (writesVar(s->body, d, 0) || writesVar(s->orelse, d, 0))
+                return true;
+        }
+        return false;
+    }
+
+    // body[at] — WHILE со счётчиком известного начала; r — границы счётчика
+    bool inductionRange(const std::vector<Stmt *> &body, size_t at, IndexRange &r) const
+    {
+        const Stmt *w = body[at];
+        const Expr *c = w->e;
+        if (at == 0 || !c || c->kind != Expr::CMP || (c->op != CMP_LT && c->op != CMP_LE) ||
+            c->l->kind != Expr::VAR || c->r->kind != Expr::NUM || w->body.empty())
+            return false;
+        const int d = c->l->decl;
+        if (decls[d].isConst)
+            return false; // присваивание CONST ничего не делает
+
+        // перед циклом: i = C;  или  VAR i = C;
+        const Stmt *init = body[at - 1];
+        if ((init->kind != Stmt::ASSIGN && init->kind != Stmt::DECL) || init->decl != d || !init->e ||
+            init->e->kind != Expr::NUM || !isInt(init->e->num) || init->e->num < 0.0)
+            return false;
+
+        // последним в теле: i = i + K;
+        const Stmt *step = w->body.back();
+        if (step->kind != Stmt::ASSIGN || step->decl != d || step->e->kind != Expr::BIN || step->e->op != OP_ADD)
+            return false;
+        const Expr *k = isVar(step->e->l, d) ? step->e->r : isVar(step->e->r, d) ? step->e->l : nullptr;
+        if (!k || k->kind != Expr::NUM || !isInt(k->num) || k->num <= 0.0 || writesVar(w->body, d, 1))
+            return false;
+
+        r.decl = d;
+        r.lo = init->e->num;
+        r.hi = (c->op == CMP_LT) ? std::ceil(c->r->num) - 1.0 : std::floor(c->r->num);
+        return true;
+    }
+
+    // Индекс idx массива a доказанно целый и в границах
+    bool indexInRange(int a, const Expr *idx) const
+    {
+        const VarDecl &arr = decls[a];
+        if (!idx || arr.func != curFunc || arr.size <= 0.0)
+            return false;
+        if (idx->kind == Expr::NUM)
+            return isInt(idx->num) && idx->num >= 0.0 && idx->num < arr.size;
+
+        // i  |  i + c  |  c + i  |  i - c
+        const Expr *v = idx;
+        double off = 0.0;
+        if (idx->kind == Expr::BIN && (idx->op == OP_ADD || idx->op == OP_SUB))
+        {
+            const bool right = idx->r->kind == Expr::NUM;
+            const Expr *num = right ? idx->r : idx->l;
+            if (num->kind != Expr::NUM || !isInt(num->num) || (!right && idx->op == OP_SUB))
+                return false;
+            v = right ? idx->l : idx->r;
+            off = (idx->op == OP_SUB) ? -num->num : num->num;
+        }
+        if (v->kind != Expr::VAR)
+            return false;
+        for (const IndexRange &r : ranges)
+            if (r.decl == v->decl)
+                return r.lo + off >= 0.0 && r.hi + off < arr.size;
+        return false;
+    }
+
+    void rangeExpr(Expr *e)
+    {
+        if (!e)
+            return;
+        if (e->kind == Expr::ELEM && indexInRange(e->decl, e->l))
+        {
+            e->inRange = true;
+            wordInRange[e->word] = 1;
+        }
+        rangeExpr(e->l);
+        rangeExpr(e->r);
+    }
+
+    void rangeBody(const std::vector<Stmt *> &body)
+    {
+        for (size_t k = 0; k < body.size(); ++k)
+        {
+            Stmt *s = body[k];
+            // условие WHILE считается и после последнего шага — без своего счётчика
+            rangeExpr(s->e);
+            rangeExpr(s->idx);
+            if (s->kind == Stmt::ASSIGNARR && indexInRange(s->decl, s->idx))
+            {
+                s->inRange = true;
+                wordInRange[s->word] = 1;
+            }
+            IndexRange r;
+            const bool counted = s->kind == Stmt::WHILE && inductionRange(body, k, r);
+            if (counted)
+                ranges.push_back(r);
+            rangeBody(s->body);
+            rangeBody(s->orelse);
+            if (counted)
+                ranges.pop_back();
+        }
+    }
+
+    // ---------- Вынос инвариантов из циклов ----------
+    // Подвыражение, чьи переменные цикл не пишет, считается один раз перед
+    // входом в самый внешний такой цикл. Выносится только то, что не может
+    // ни упасть, ни зависеть от порядка вычисления: без элементов массивов,
+    // && и || (они переходы) — поэтому его можно посчитать и для цикла,
+    // который не выполнится ни разу.
+    struct HoistLoop
+    {
+        Stmt *s = nullptr;
+        std::vector<char> writes; // по объявлениям
+        bool calls = false;       // процедура может писать глобальные
+    };
+    std::vector<HoistLoop> hoistLoops; // циклы вокруг текущего оператора
+
+    void collectWrites(const std::vector<Stmt *> &body, HoistLoop &L) const
+    {
+        for (const Stmt *s : body)
+        {
+            switch (s->kind)
+            {
+            case Stmt::DECL:
+            case Stmt::DECLARR:
+            case Stmt::ASSIGN:
+            case Stmt::ASSIGNARR:
+                L.writes[s->decl] = 1;
+                break;
+            default:
+                break;
+            }
+            L.calls = L.calls || stmtCalls(s);
+            collectWrites(s->body, L);
+            collectWrites(s->orelse, L);
+        }
+    }
+
+    bool variantIn(int d, const HoistLoop &L) const
+    {
+        return L.writes[d] || (L.calls && decls[d].func == 0);
+    }
+
+    // Номер самого внешнего цикла, в котором e инвариантно (циклы вложены,
+    // поэтому дальше внутрь оно тоже инвариантно); -1 — выносить нельзя
+    int invariantFrom(const Expr *e) const
+    {
+        switch (e->kind)
+        {
+        case Expr::NUM:
+            return 0;
+        case Expr::VAR:
+        {
+            int from = 0;
+            for (int k = 0; k < (int)hoistLoops.size(); ++k)
+                if (variantIn(e->decl, hoistLoops[k]))
+                    from = k + 1;
+            return from;
+        }
+        case Expr::NEG:
+        case Expr::NOT:
+        case Expr::BIN:
+        case Expr::CMP:
+        case Expr::CALLF:
+        {
+            const int l = invariantFrom(e->l);
+            const int r = e->r ? invariantFrom(e->r) : 0;
+            return (l < 0 || r < 0) ? -1 : std::max(l, r);
+        }
+        default:
+            return -1;
+        }
+    }
+
+    void hoistExpr(Expr *e)
+    {
+        if (!e || e->kind == Expr::NUM || e->kind == Expr::VAR || e->kind == Expr::HOIST)
+            return;
+        const int from = invariantFrom(e);
+        if (from < 0 || from >= (int)hoistLoops.size() || e->from < 0)
+        {
+            hoistExpr(e->l);
+            hoistExpr(e->r);
+            return;
+        }
+        // узел становится ссылкой на регистр, исходное дерево — в l
+        HoistLoop &L = hoistLoops[from];
+        Expr *orig = newExpr(e->kind, e->word);
+        *orig = *e;
+        e->kind = Expr::HOIST;
+        e->l = orig;
+        e->r = nullptr;
+        L.s->hoisted.push_back(e);
+
+        LoopHoist h;
+        h.whileWord = L.s->word;
+        h.from = e->from;
+        h.to = e->to;
+        h.calls = L.calls;
+        hoists.push_back(h);
+    }
+
+    void hoistBody(const std::vector<Stmt *> &body)
+    {
+        for (Stmt *s : body)
+        {
+            if (s->kind == Stmt::WHILE)
+            {
+                HoistLoop L;
+                L.s = s;
+                L.writes.assign(decls.size(), 0);
+                collectWrites(s->body, L);
+                hoistLoops.push_back(std::move(L));
+            }
+            if (!hoistLoops.empty())
+            {
+                hoistExpr(s->e);
+                hoistExpr(s->idx);
+            }
+            hoistBody(s->body);
+            hoistBody(s->orelse);
+            if (s->kind == Stmt::WHILE)
+                hoistLoops.pop_back();
+        }
+    }
+
+    // ---------- Общие подвыражения ----------
+    // Выражения без побочных эффектов: в пределах одного оператора равные
+    // поддеревья дают равные значения (переменные пишутся только в конце)
+    static bool sameExpr(const Expr *a, const Expr *b)
+    {
+        if (a == b)
+            return true;
+        if (!a || !b || a->kind != b->kind || a->op != b->op || a->decl != b->decl)
+            return false;
+        if (a->kind == Expr::NUM)
+            return std::memcmp(&a->num, &b->num, sizeof(double)) == 0;
+        return sameExpr(a->l, b->l) && sameExpr(a->r, b->r);
+    }
+
+    // Примерная цена узла для tick: замыкание окупается от двух операций
+    static int cseWeight(const Expr *e)
+    {
+        if (!e)
+            return 0;
+        switch (e->kind)
+        {
+        case Expr::ELEM:
+        case Expr::CALLF:
+            return 2 + cseWeight(e->l) + cseWeight(e->r);
+        case Expr::NEG:
+        case Expr::NOT:
+        case Expr::BIN:
+        case Expr::CMP:
+            return 1 + cseWeight(e->l) + cseWeight(e->r);
+        default:
+            return 0;
+        }
+    }
+
+    // Узлы в прямом порядке; size — сколько слотов занимает поддерево
+    static void cseCollect(Expr *e, std::vector<Expr *> &nodes, std::vector<int> &size)
+    {
+        if (!e)
+            return;
+        const int at = (int)nodes.size();
+        nodes.push_back(e);
+        size.push_back(1);
+        if (e->kind != Expr::HOIST)
+        {
+            cseCollect(e->l, nodes, size);
+            cseCollect(e->r, nodes, size);
+        }
+        size[at] = (int)nodes.size() - at;
+    }
+
+    // Группы для tick: самые крупные повторы, плюс чтение элемента, который
+    // оператор name[i] = ... потом пишет (tick запишет по тому же адресу)
+    void cseStmt(const Stmt *s)
+    {
+        if (stmtCalls(s))
+            return; // процедура может изменить и переменные, и элементы
+        std::vector<Expr *> nodes;
+        std::vector<int> size;
+        cseCollect(s->e, nodes, size);
+        std::vector<char> taken(nodes.size(), 0);
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const Expr *e = nodes[i];
+            if (taken[i] || e->from < 0 || cseWeight(e) < 2)
+                continue;
+            const bool store = s->kind == Stmt::ASSIGNARR && e->kind == Expr::ELEM && e->decl == s->decl &&
+                               sameExpr(e->l, s->idx);
+            std::vector<size_t> members(1, i);
+            for (size_t j = i + 1; j < nodes.size(); ++j)
+                if (!taken[j] && nodes[j]->from >= 0 && sameExpr(e, nodes[j]))
+                    members.push_back(j);
+            if (members.size() < 2 && !store)
+                continue;
+
+            CseGroup g;
+            for (size_t m : members)
+            {
+                g.from.push_back(nodes[m]->from);
+                g.to.push_back(nodes[m]->to);
+                std::fill(taken.begin() + m, taken.begin() + m + size[m], 1);
+            }
+            if (e->kind == Expr::ELEM && e->l->from >= 0)
+            {
+                g.elem = e->word;
+                g.indexFrom = e->l->from;
+                g.indexTo = e->l->to;
+                if (store)
+                    g.store = s->word;
+            }
+            cse.push_back(g);
+        }
+    }
+
+    void cseBody(const std::vector<Stmt *> &body)
+    {
+        for (const Stmt *s : body)
+        {
+            cseStmt(s);
+            cseBody(s->body);
+            cseBody(s->orelse);
+        }
+    }
+
+    // ---------- Генерация кода ----------
+    Bytecode *bc = nullptr;
+    int nlocals = 0;
+    int tempTop = 0;
+    int tempMax = 0;
+    int tempBase = 0;   // ниже — регистры инвариантов объемлющих циклов
+    std::vector<int> inlineExits; // цепочки переходов RETURN встроенных тел
+    // Цепочки переходов BREAK и CONTINUE охватывающих циклов
+    struct LoopJumps
+    {
+        int breaks = -1;
+        int continues = -1;
+    };
+    std::vector<LoopJumps> loopJumps;
+    // Уже посчитанные в операторе подвыражения (нумерация значений):
+    // повтор берётся из регистра. Временные регистры в операторе не
+    // переиспользуются, поэтому значение в них живо до конца оператора
+    std::vector<std::pair<const Expr *, int>> known;
+    int resumeWord = 0; // stmtOf для следующих инструкций
+
+    int emit(int op, int a, int b, int c, int word)
+    {
+        Instr I;
+        I.op = (uint8_t)op;
+        I.a = a;
+        I.b = b;
+        I.c = c;
+        bc->code.push_back(I);
+        bc->wordOf.push_back(word);
+        bc->stmtOf.push_back(resumeWord);
+        return (int)bc->code.size() - 1;
+    }
+
+    int here() const { return (int)bc->code.size(); }
+
+    int konst(double v)
+    {
+        for (int i = 0; i < (int)bc->consts.size(); ++i)
+            if (std::memcmp(&bc->consts[i], &v, sizeof(double)) == 0)
+                return i;
+        bc->consts.push_back(v);
+        return (int)bc->consts.size() - 1;
+    }
+
+    int str(const char *s)
+    {
+        for (int i = 0; i < (int)bc->strings.size(); ++i)
+            if (bc->strings[i] == s)
+                return i;
+        bc->strings.push_back(s);
+        return (int)bc->strings.size() - 1;
+    }
+
+    int allocTemp()
+    {
+        int r = nlocals + tempTop++;
+        if (tempTop > tempMax)
+            tempMax = tempTop;
+        return r;
+    }
+
+    bool isLocal(int d) const { return decls[d].func == curFunc; }
+
+    // Новый оператор: временные регистры свободны, известных значений нет
+    void resetTemps()
+    {
+        tempTop = tempBase;
+        known.clear();
+    }
+
+    bool reusable(const Expr *e) const
+    {
+        if (exprCalls(e))
+            return false; // у вызова побочные эффекты: каждый выполняется
+        switch (e->kind)
+        {
+        case Expr::VAR:
+            return !isLocal(e->decl);
+        case Expr::ELEM:
+        case Expr::NEG:
+        case Expr::NOT:
+        case Expr::BIN:
+        case Expr::CMP:
+        case Expr::CALLF:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    int knownReg(const Expr *e) const
+    {
+        for (const auto &k : known)
+            if (sameExpr(k.first, e))
+                return k.second;
+        return -1;
+    }
+
+    void genFunction(int f)
+    {
+        curFunc = f;
+        nlocals = funcs[f].nlocals;
+        tempTop = tempMax = tempBase = 0;
+        FuncInfo &fi = bc->funcs[f];
+        fi.name = funcs[f].name;
+        fi.entry = here();
+        for (Stmt *s : funcs[f].body)
+            genStmt(s);
+        if (f == 0)
+            emit(OP_HALT, 0, 0, 0, n - 1);
+        else
+            emit(OP_RET, 0, 0, 0, funcs[f].close);
+        fi.nregs = nlocals + tempMax;
+        fi.nvars = nlocals;
+        fi.narrs = funcs[f].narrs;
+        fi.arrNames = funcs[f].arrNames;
+        for (char isArray : funcs[f].paramArray)
+            ++(isArray ? fi.arrayParams : fi.params);
+    }
+
+    // Значение выражения в каком-нибудь регистре (локальная переменная — без копии)
+    int genAny(Expr *e)
+    {
+        if (e->kind == Expr::VAR && isLocal(e->decl))
+            return decls[e->decl].slot;
+        if (e->kind == Expr::HOIST)
+            return e->op;
+        const int r = reusable(e) ? knownReg(e) : -1;
+        if (r >= 0)
+            return r;
+        int t = allocTemp();
+        genInto(e, t);
+        return t;
+    }
+
+    // Левый операнд, когда в правом есть вызов: процедура может записать
+    // переменную, поэтому значение копируется до вызова, как читает tick
+    int genLeft(Expr *l, const Expr *r)
+    {
+        if (!exprCalls(r))
+            return genAny(l);
+        const int t = allocTemp();
+        genInto(l, t);
+        return t;
+    }
+
+    void genInto(Expr *e, int dst)
+    {
+        const bool reuse = reusable(e);
+        if (reuse)
+        {
+            const int r = knownReg(e);
+            if (r >= 0)
+            {
+                if (r != dst)
+                    emit(OP_MOV, dst, r, 0, e->word);
+                return;
+            }
+        }
+        genValue(e, dst);
+        if (reuse && dst >= nlocals)
+            known.push_back({e, dst});
+    }
+
+    void genValue(Expr *e, int dst)
+    {
+        switch (e->kind)
+        {
+        case Expr::NUM:
+            emit(OP_LOADK, dst, konst(e->num), 0, e->word);
+            break;
+        case Expr::VAR:
+        {
+            const VarDecl &d = decls[e->decl];
+            if (!isLocal(e->decl))
+                emit(OP_GETG, dst, d.slot, 0, e->word);
+            else if (d.slot != dst)
+                emit(OP_MOV, dst, d.slot, 0, e->word);
+            break;
+        }
+        case Expr::ELEM:
+        {
+            int idx = genAny(e->l);
+            emit(e->inRange ? OP_GETAU : isLocal(e->decl) ? OP_GETA : OP_GETAG, dst, decls[e->decl].slot, idx, e->word);
+            break;
+        }
+        case Expr::NEG:
+        case Expr::NOT:
+        {
+            int a = genAny(e->l);
+            emit(e->kind == Expr::NEG ? OP_NEG : OP_NOT, dst, a, 0, e->word);
+            break;
+        }
+        case Expr::BIN:
+        {
+            Expr *l = e->l, *r = e->r;
+            if ((e->op == OP_ADD || e->op == OP_MUL) && l->kind == Expr::NUM && r->kind != Expr::NUM)
+                std::swap(l, r); // константу — вправо, в K-операнд
+            int a = genLeft(l, r);
+            if (r->kind == Expr::NUM && e->op >= OP_ADD && e->op <= OP_DIV)
+            {
+                emit(OP_ADDK + (e->op - OP_ADD), dst, a, konst(r->num), e->word);
+                break;
+            }
+            int b = genAny(r);
+            emit(e->op, dst, a, b, e->word);
+            break;
+        }
+        case Expr::CMP:
+        {
+            int a = genLeft(e->l, e->r);
+            int b = genAny(e->r);
+            emit(OP_LT + e->op, dst, a, b, e->word);
+            break;
+        }
+        case Expr::CALLF:
+        {
+            if (builtins()[e->op].arity == 1)
+            {
+                int a = genAny(e->l);
+                emit(OP_CALLF1, dst, a, e->op, e->word);
+            }
+            else
+            {
+                int t0 = allocTemp();
+                int t1 = allocTemp();
+                genInto(e->l, t0);
+                genInto(e->r, t1);
+                emit(OP_CALLF2, dst, t0, e->op, e->word);
+            }
+            break;
+        }
+        case Expr::AND:
+        case Expr::OR:
+        {
+            // 0/1 через переходы: правая часть не считается, если ответ уже ясен
+            int jf = genJump(e, false);
+            emit(OP_LOADK, dst, konst(1.0), 0, e->word);
+            int jend = emit(OP_JMP, -1, 0, 0, e->word);
+            patch(jf, here());
+            emit(OP_LOADK, dst, konst(0.0), 0, e->word);
+            patch(jend, here());
+            break;
+        }
+        case Expr::CALLP:
+            genCall(e, dst);
+            break;
+        case Expr::ARGS:
+        case Expr::ARR:
+            break; // только внутри CALLP
+        case Expr::COMMA:
+            genAny(e->l);
+            genInto(e->r, dst);
+            break;
+        case Expr::HOIST:
+            if (e->op != dst)
+                emit(OP_MOV, dst, e->op, 0, e->word);
+            break;
+        }
+    }
+
+    // Вызов процедуры: значения аргументов — подряд в регистры от b, туда же
+    // результат; dst < 0 — результат не нужен. Процедура может записать
+    // глобальные и переданные массивы — известные значения забываются.
+    // tail — RETURN f(...): TCALL, возврата сюда нет
+    void genCall(Expr *e, int dst, bool tail = false)
+    {
+        CallArgs args;
+        for (const Expr *a = e->l; a; a = a->r)
+            if (a->l->kind != Expr::ARR)
+                ++args.values;
+        const int b = allocTemp();
+        for (int k = 1; k < args.values; ++k)
+            allocTemp();
+        int k = 0;
+        for (Expr *a = e->l; a; a = a->r)
+        {
+            if (a->l->kind == Expr::ARR)
+                args.arrays.push_back({decls[a->l->decl].slot, !isLocal(a->l->decl)});
+            else
+                genInto(a->l, b + k++);
+        }
+        bc->calls.push_back(args);
+        emit(tail ? OP_TCALL : OP_CALL, e->op, b, (int)bc->calls.size() - 1, e->word);
+        known.clear();
+        if (dst >= 0 && dst != b)
+            emit(OP_MOV, dst, b, 0, e->word);
+    }
+
+    // Условный переход (адрес дописывается позже через patch).
+    // Возвращает цепочку переходов: неразрешённые связаны через поле a.
+    int genJump(Expr *c, bool ifTrue)
+    {
+        if (c->kind == Expr::AND || c->kind == Expr::OR)
+        {
+            // && к "истине" (и || к "лжи") — обход правой части, если левая решает
+            // значения правой части известны только на её пути
+            const bool same = (c->kind == Expr::OR) == ifTrue;
+            if (same)
+            {
+                const int jl = genJump(c->l, ifTrue);
+                const size_t mark = known.size();
+                const int jr = genJump(c->r, ifTrue);
+                known.resize(std::min(mark, known.size()));
+                return join(jl, jr);
+            }
+            int skip = genJump(c->l, !ifTrue);
+            const size_t mark = known.size();
+            int j = genJump(c->r, ifTrue);
+            known.resize(std::min(mark, known.size()));
+            patch(skip, here());
+            return j;
+        }
+        if (c->kind == Expr::CMP)
+        {
+            int a = genLeft(c->l, c->r);
+            if (c->r->kind == Expr::NUM)
+                return emit((ifTrue ? OP_JLTK : OP_JNLTK) + c->op, -1, a, konst(c->r->num), c->word);
+            int b = genAny(c->r);
+            return emit((ifTrue ? OP_JLT : OP_JNLT) + c->op, -1, a, b, c->word);
+        }
+        if (c->kind == Expr::NOT)
+            return genJump(c->l, !ifTrue);
+        if (c->kind == Expr::NUM)
+        {
+            // условие свернулось: переход либо всегда, либо никогда
+            if ((c->num != 0.0) != ifTrue)
+                return -1;
+            return emit(OP_JMP, -1, 0, 0, c->word);
+        }
+        int v = genAny(c);
+        return emit(ifTrue ? OP_JNZ : OP_JZ, -1, v, 0, c->word);
+    }
+
+    void patch(int at, int target)
+    {
+        while (at >= 0)
+        {
+            int next = bc->code[at].a;
+            bc->code[at].a = target;
+            at = next;
+        }
+    }
+
+    // Склеить две цепочки переходов
+    int join(int first, int second)
+    {
+        if (first < 0)
+            return second;
+        int at = first;
+        while (bc->code[at].a >= 0)
+            at = bc->code[at].a;
+        bc->code[at].a = second;
+        return first;
+    }
+
+    void genBody(const std::vector<Stmt *> &body)
+    {
+        for (Stmt *s : body)
+            genStmt(s);
+    }
+
+    void genStmt(Stmt *s)
+    {
+        resetTemps();
+        resumeWord = s->word;
+        switch (s->kind)
+        {
+        case Stmt::DECL:
+        {
+            int slot = decls[s->decl].slot;
+            if (s->e)
+                genInto(s->e, slot);
+            else
+                emit(OP_LOADK, slot, konst(0.0), 0, s->word);
+            break;
+        }
+        case Stmt::DECLARR:
+            emit(OP_NEWARR, decls[s->decl].slot, konst(s->size), 0, s->word);
+            break;
+        case Stmt::ASSIGN:
+            if (isLocal(s->decl))
+                genInto(s->e, decls[s->decl].slot);
+            else
+                emit(OP_SETG, decls[s->decl].slot, genAny(s->e), 0, s->word);
+            break;
+        case Stmt::ASSIGNARR:
+        {
+            int idx = genAny(s->idx);
+            int v = genAny(s->e);
+            emit(s->inRange ? OP_SETAU : isLocal(s->decl) ? OP_SETA : OP_SETAG, decls[s->decl].slot, idx, v, s->word);
+            break;
+        }
+        case Stmt::PRINTS:
+            emit(OP_PRINTS, str(s->text), s->ln, 0, s->word);
+            break;
+        case Stmt::PRINTE:
+            emit(OP_PRINTN, genAny(s->e), s->ln, 0, s->word);
+            break;
+        case Stmt::IF:
+        {
+            int jf = genJump(s->e, false);
+            genBody(s->body);
+            if (s->orelse.empty())
+            {
+                patch(jf, here());
+                break;
+            }
+            int jend = emit(OP_JMP, -1, 0, 0, s->word);
+            patch(jf, here());
+            genBody(s->orelse);
+            patch(jend, here());
+            break;
+        }
+        case Stmt::WHILE:
+        {
+            int jv = (s->kernel >= 0) ? emit(OP_VLOOP, s->kernel, -1, 0, s->word) : -1;
+            // инварианты — в регистры, которые живут до конца цикла
+            const int outerBase = tempBase;
+            const int hoist = here();
+            for (Expr *h : s->hoisted)
+                h->op = allocTemp();
+            tempBase = tempTop;
+            for (Expr *h : s->hoisted)
+            {
+                resetTemps();
+                genInto(h->l, h->op);
+            }
+            const int hoistEnd = here();
+            resetTemps();
+            // условие проверяется сверху один раз и дальше — в конце тела
+            int jf = genJump(s->e, false);
+            int top = here();
+            loopJumps.emplace_back();
+            genBody(s->body);
+            const LoopJumps jumps = loopJumps.back();
+            loopJumps.pop_back();
+            resetTemps();
+            // проверка в конце тела соответствует '}' у tick
+            resumeWord = s->close;
+            BytecodeLoop loop;
+            loop.func = curFunc;
+            loop.whileWord = s->word;
+            loop.closeWord = s->close;
+            loop.hoist = hoist;
+            loop.hoistEnd = hoistEnd;
+            loop.top = top;
+            loop.cond = here();
+            patch(jumps.continues, loop.cond);
+            patch(genJump(s->e, true), top);
+            patch(jf, here());
+            patch(jumps.breaks, here());
+            loop.exit = here();
+            bc->loops.push_back(loop);
+            if (jv >= 0)
+                bc->code[jv].b = here();
+            tempBase = outerBase;
+            break;
+        }
+        case Stmt::BLOCK:
+            genBody(s->body);
+            break;
+        case Stmt::CALL:
+            genCall(s->e, -1);
+            break;
+        case Stmt::INLINE:
+            inlineExits.push_back(-1);
+            genBody(s->body);
+            patch(inlineExits.back(), here());
+            inlineExits.pop_back();
+            break;
+        case Stmt::RETURN:
+        {
+            if (s->tail && inlineExits.empty())
+            {
+                genCall(s->e, -1, true);
+                break;
+            }
+            // значение встроенного тела не нужно, но считается (ошибки те же)
+            const int v = s->e ? genAny(s->e) : 0;
+            if (!inlineExits.empty())
+                inlineExits.back() = emit(OP_JMP, inlineExits.back(), 0, 0, s->word);
+            else
+                emit(OP_RET, v, s->e ? 1 : 0, 0, s->word);
+            break;
+        }
+        case Stmt::BREAK:
+            loopJumps.back().breaks = emit(OP_JMP, loopJumps.back().breaks, 0, 0, s->word);
+            break;
+        case Stmt::CONTINUE:
+            loopJumps.back().continues = emit(OP_JMP, loopJumps.back().continues, 0, 0, s->word);
+            break;
+        case Stmt::HALT:
+            emit(OP_HALT, 0, 0, 0, s->word);
+            break;
+        case Stmt::WARN:
+            emit(OP_WARN, str(s->text), 0, 0, s->word);
+            break;
+        case Stmt::ERROR:
+            emit(OP_ERR, str(s->text), 0, 0, s->word);
+            break;
+        }
+    }
+};
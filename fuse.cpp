@@ -0,0 +1,372 @@
+#pragma once
+#include "system.cpp"
+#include "token.cpp"
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <ostream>
+
+// ===== Слияние операторов для движка tick =====
+// При загрузке частые формы присваиваний и условий сопоставляются с таблицей
+// шаблонов; совпавшие операторы исполняются одним обработчиком без
+// вычислителя выражений. Операнд — число, переменная или элемент a[i].
+
+enum FuseOperandKind : uint8_t
+{
+    FO_NONE = 0,
+    FO_CONST, // value
+    FO_VAR,   // word — слово с именем (ячейка по wordRef)
+    FO_ELEM   // word — имя массива, index — слово индекса (-1 — число value)
+};
+
+struct FuseOperand
+{
+    FuseOperandKind kind = FO_NONE;
+    int word = -1;
+    int index = -1;
+    double value = 0.0;
+    bool inRange = false; // FO_ELEM: индекс доказан при загрузке
+};
+
+// Операции — те же функции, что и у tinyexpr, результат совпадает побитно
+enum FuseOp : uint8_t
+{
+    FOP_NONE = 0, // копия операнда a
+    FOP_ADD,
+    FOP_SUB,
+    FOP_MUL,
+    FOP_DIV,
+    FOP_MOD,
+    FOP_POW,
+    FOP_LT,
+    FOP_LE,
+    FOP_GT,
+    FOP_GE,
+    FOP_EQ,
+    FOP_NE,
+    FOP_AND,
+    FOP_OR
+};
+
+inline double fuseApply(FuseOp op, double x, double y)
+{
+    switch (op)
+    {
+    case FOP_ADD:
+        return x + y;
+    case FOP_SUB:
+        return x - y;
+    case FOP_MUL:
+        return x * y;
+    case FOP_DIV:
+        return x / y;
+    case FOP_MOD:
+        return std::fmod(x, y);
+    case FOP_POW:
+        return std::pow(x, y);
+    case FOP_LT:
+        return x < y;
+    case FOP_LE:
+        return x <= y;
+    case FOP_GT:
+        return x > y;
+    case FOP_GE:
+        return x >= y;
+    case FOP_EQ:
+        return x == y;
+    case FOP_NE:
+        return x != y;
+    case FOP_AND:
+        return x != 0.0 && y != 0.0;
+    case FOP_OR:
+        return x != 0.0 || y != 0.0;
+    default:
+        return x;
+    }
+}
+
+// Шаблоны — для отчёта, какие формы сколько раз слились
+enum FuseShape : uint8_t
+{
+    FZ_SET_CONST,     // x = 5;
+    FZ_SET_VAR,       // x = y;
+    FZ_VAR_OP_CONST,  // x = y + 2;  x = 2 * y;
+    FZ_VAR_OP_VAR,    // x = y * z;
+    FZ_ELEM_UPDATE,   // a[i] = ...;  x = a[i] ...;
+    FZ_COND_VAR,      // ( x )
+    FZ_COND_VAR_CONST, // ( i < 10 )
+    FZ_COND_VAR_VAR,  // ( i < n )
+    FZ_COND_ELEM,     // ( a[i] > 0 )
+    FZ_COUNT
+};
+
+inline const char *fuseShapeName(FuseShape s)
+{
+    static const char *const names[FZ_COUNT] = {
+        "x = N", "x = y", "x = y op N", "x = y op z", "array element",
+        "( x )", "( x cmp N )", "( x cmp y )", "( array element )"};
+    return names[s];
+}
+
+// Слитый оператор: dst = a [op b]; у условия dst.kind == FO_NONE
+struct Fused
+{
+    FuseShape shape = FZ_SET_CONST;
+    FuseOp op = FOP_NONE;
+    FuseOperand dst, a, b;
+    int word = -1; // первое слово оператора
+    int next = -1; // слово после ';'
+};
+
+// Сопоставление слов программы с шаблонами
+class Fuser
+{
+public:
+    Fuser(const std::vector<Id> &words, const TokenStream &tokens, const std::vector<SlotRef> &refs, const Symbols &S)
+        : words(words), tokens(tokens), refs(refs), S(S) {}
+
+    // Присваивание со слова w: name = ... ;  или  name [ i ] = ... ;
+    bool matchSet(int w, Fused &f) const
+    {
+        int p = w;
+        if (at(p + 1) == S.LBRACKET)
+        {
+            if (!operand(p, f.dst) || f.dst.kind != FO_ELEM)
+                return false;
+        }
+        else
+        {
+            if (!isScalar(p) || refs[p].isConst)
+                return false;
+            f.dst.kind = FO_VAR;
+            f.dst.word = p++;
+        }
+        if (at(p++) != S.EQ || !expr(p, f))
+            return false;
+        if (at(p) != S.SEMI)
+            return false;
+        f.word = w;
+        f.next = p + 1;
+        f.shape = setShape(f);
+        return true;
+    }
+
+    // Условие между '(' open и парной ')' close
+    bool matchCond(int open, int close, Fused &f) const
+    {
+        int p = open + 1;
+        if (!expr(p, f) || p != close)
+            return false;
+        f.shape = condShape(f);
+        return true;
+    }
+
+private:
+    const std::vector<Id> &words;
+    const TokenStream &tokens;
+    const std::vector<SlotRef> &refs;
+    const Symbols &S;
+
+    Id at(int p) const { return (p >= 0 && p < (int)words.size()) ? words[p] : nullptr; }
+
+    bool isScalar(int p) const
+    {
+        return at(p) && refs[p].slot >= 0 && !refs[p].isArray;
+    }
+
+    // a  |  a op b
+    bool expr(int &p, Fused &f) const
+    {
+        if (!operand(p, f.a))
+            return false;
+        const FuseOp op = binary(at(p));
+        if (op == FOP_NONE)
+            return true;
+        ++p;
+        if (!operand(p, f.b))
+            return false;
+        f.op = op;
+        if (f.a.kind == FO_CONST && f.b.kind == FO_CONST)
+        {
+            // оба операнда известны — сворачиваем сразу
+            f.a.value = fuseApply(op, f.a.value, f.b.value);
+            f.b = FuseOperand();
+            f.op = FOP_NONE;
+        }
+        return true;
+    }
+
+    bool operand(int &p, FuseOperand &o) const
+    {
+        const char *t = at(p);
+        if (tokens.isNumber(p))
+        {
+            o.kind = FO_CONST;
+            o.value = tokens.number(p);
+            ++p;
+            return true;
+        }
+        if (at(p + 1) == S.LBRACKET)
+        {
+            // a [ 3 ]  |  a [ i ]
+            if (!t || refs[p].slot < 0 || !refs[p].isArray || at(p + 3) != S.RBRACKET)
+                return false;
+            o.kind = FO_ELEM;
+            o.word = p;
+            o.inRange = refs[p].inRange;
+            if (tokens.kind(p + 2) == TK_INT)
+                o.value = tokens.number(p + 2);
+            else if (isScalar(p + 2) && refs[p + 2].known)
+                o.value = refs[p + 2].value;
+            else if (isScalar(p + 2))
+                o.index = p + 2;
+            else
+                return false;
+            p += 4;
+            return true;
+        }
+        if (!isScalar(p))
+            return false;
+        if (refs[p].known)
+        {
+            // CONST с известным значением — число
+            o.kind = FO_CONST;
+            o.value = refs[p].value;
+            ++p;
+            return true;
+        }
+        o.kind = FO_VAR;
+        o.word = p++;
+        return true;
+    }
+
+    FuseOp binary(Id t) const
+    {
+        if (t == S.PLUS)
+            return FOP_ADD;
+        if (t == S.MINUS)
+            return FOP_SUB;
+        if (t == S.STAR)
+            return FOP_MUL;
+        if (t == S.SLASH)
+            return FOP_DIV;
+        if (t == S.PERCENT)
+            return FOP_MOD;
+        if (t == S.CARET)
+            return FOP_POW;
+        if (t == S.LT)
+            return FOP_LT;
+        if (t == S.LEQ)
+            return FOP_LE;
+        if (t == S.GT)
+            return FOP_GT;
+        if (t == S.GEQ)
+            return FOP_GE;
+        if (t == S.EQEQ)
+            return FOP_EQ;
+        if (t == S.NEQ)
+            return FOP_NE;
+        if (t == S.ANDAND)
+            return FOP_AND;
+        if (t == S.OROR)
+            return FOP_OR;
+        return FOP_NONE;
+    }
+
+    static bool hasElem(const Fused &f)
+    {
+        return f.dst.kind == FO_ELEM || f.a.kind == FO_ELEM || f.b.kind == FO_ELEM;
+    }
+
+    static FuseShape setShape(const Fused &f)
+    {
+        if (hasElem(f))
+            return FZ_ELEM_UPDATE;
+        if (f.op == FOP_NONE)
+            return f.a.kind == FO_CONST ? FZ_SET_CONST : FZ_SET_VAR;
+        return (f.a.kind == FO_CONST || f.b.kind == FO_CONST) ? FZ_VAR_OP_CONST : FZ_VAR_OP_VAR;
+    }
+
+    static FuseShape condShape(const Fused &f)
+    {
+        if (hasElem(f))
+            return FZ_COND_ELEM;
+        if (f.op == FOP_NONE)
+            return FZ_COND_VAR;
+        return (f.a.kind == FO_CONST || f.b.kind == FO_CONST) ? FZ_COND_VAR_CONST : FZ_COND_VAR_VAR;
+    }
+};
+
+// ===== Счётные циклы =====
+// WHILE (i < N) { ... i = i + K; }, где i больше нигде в теле не пишется,
+// а N — число или переменная, которую тело не меняет. Если тело целиком из
+// слитых операторов, цикл идёт нативно: i живёт в локальной переменной и
+// пишется в ячейку только перед операторами, которые его читают, и на
+// выходе. Иначе шаг, проверка и переход — один обработчик вместо двух.
+struct CountedStmt
+{
+    int fused = -1;
+    int off = 0;        // номер итерации внутри развёрнутого прохода
+    bool reads = false; // читает i
+};
+
+struct CountedLoop
+{
+    static constexpr int kUnroll = 4;      // итераций в развёрнутом проходе
+    static constexpr int kUnrollMaxBody = 4; // разворачиваем тела до стольких операторов
+
+    int whileWord = -1;
+    int close = -1;   // '}' тела
+    int counter = -1; // слово i в условии
+    FuseOperand limit;
+    bool inclusive = false; // i <= N
+    double step = 1.0;
+    int stepWord = -1; // оператор i = i + K
+    bool native = false;
+    std::vector<CountedStmt> body;     // без шага
+    std::vector<CountedStmt> unrolled; // body × kUnroll, если N — число
+};
+
+// Сколько операторов и условий слилось
+struct FuseReport
+{
+    int sets = 0;      // присваиваний всего
+    int conds = 0;     // условий IF/WHILE всего
+    int shapes[FZ_COUNT] = {};
+    int counted = 0; // счётных циклов
+    int native = 0;  // из них нативных
+    int unrolled = 0;
+    int hoisted = 0; // инвариантов циклов
+    int cse = 0;     // повторяющихся подвыражений
+
+    int fusedSets() const
+    {
+        int n = 0;
+        for (int s = FZ_SET_CONST; s <= FZ_ELEM_UPDATE; ++s)
+            n += shapes[s];
+        return n;
+    }
+
+    int fusedConds() const
+    {
+        int n = 0;
+        for (int s = FZ_COND_VAR; s < FZ_COUNT; ++s)
+            n += shapes[s];
+        return n;
+    }
+
+    void print(std::ostream &out) const
+    {
+        out << "fused " << fusedSets() << " of " << sets << " assignments, "
+            << fusedConds() << " of " << conds << " conditions\n";
+        for (int s = 0; s < FZ_COUNT; ++s)
+            if (shapes[s])
+                out << "  " << fuseShapeName((FuseShape)s) << ": " << shapes[s] << "\n";
+        if (counted)
+            out << "counted loops: " << counted << " (native " << native << ", unrolled " << unrolled << ")\n";
+        if (hoisted)
+            out << "loop-invariant expressions: " << hoisted << "\n";
+        if (cse)
+            out << "common sub-expressions: " << cse << "\n";
+    }
+};
@@ -0,0 +1,700 @@
+#pragma once
+#include "compiler.cpp"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__)) && !defined(LILC_NO_JIT)
+#include <sys/mman.h>
+#include <unistd.h>
+#define LILC_JIT 1
+#endif
+
+// ===== JIT горячих циклов движка tick (x86-64, System V) =====
+//
+// Шаблонный JIT: каждая инструкция байткода цикла — фиксированная
+// последовательность машинных команд. Переменные живут прямо в кадре
+// controller (rbx — кадр, r12 — глобальные), временные регистры — на стеке
+// (r13), константы — в Bytecode::consts (r14), массивы — снимок {data, size}
+// на входе (r15). Всё, что JIT не умеет или что требует сообщения об
+// ошибке, — выход (deopt) с номером: tick повторяет оператор с начала.
+
+struct JitArray
+{
+    double *data;
+    size_t size;
+};
+
+struct JitState
+{
+    double *L;           // 0:  кадр текущей функции
+    double *G;           // 8:  кадр main
+    const JitArray *A;   // 16: массивы кадра, затем массивы main
+    const double *K;     // 24: константы байткода
+    void *host;          // 32: для kernel()
+};
+
+typedef int (*JitFn)(JitState *);
+
+// Вызовы из машинного кода обратно в интерпретатор
+struct JitHelpers
+{
+    int (*kernel)(void *host, int k); // векторное ядро (OP_VLOOP), 1 — выполнено
+};
+
+#ifdef LILC_JIT
+
+// Исполняемая память: пишем в RW-страницы, затем переводим в RX
+class JitMemory
+{
+public:
+    JitMemory() = default;
+    JitMemory(const JitMemory &) = delete;
+    JitMemory &operator=(const JitMemory &) = delete;
+    ~JitMemory()
+    {
+        if (mem)
+            ::munmap(mem, len);
+    }
+
+    void *commit(const std::vector<uint8_t> &code)
+    {
+        const size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+        len = (code.size() + page - 1) / page * page;
+        void *p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return nullptr;
+        std::memcpy(p, code.data(), code.size());
+        if (::mprotect(p, len, PROT_READ | PROT_EXEC) != 0)
+        {
+            ::munmap(p, len);
+            return nullptr;
+        }
+        mem = p;
+        return mem;
+    }
+
+private:
+    void *mem = nullptr;
+    size_t len = 0;
+};
+
+// Минимальный ассемблер x86-64: ровно те команды, что нужны шаблонам
+class X64Emitter
+{
+public:
+    enum Reg
+    {
+        RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15
+    };
+    enum Cond // второй байт 0F 8x
+    {
+        CC_B = 0x82,
+        CC_AE = 0x83,
+        CC_E = 0x84,
+        CC_NE = 0x85,
+        CC_BE = 0x86,
+        CC_A = 0x87,
+        CC_P = 0x8A
+    };
+
+    std::vector<uint8_t> buf;
+
+    int newLabel()
+    {
+        labels.push_back(-1);
+        return (int)labels.size() - 1;
+    }
+    void bind(int l) { labels[l] = (int)buf.size(); }
+
+    void jmp(int l)
+    {
+        byte(0xE9);
+        fixup(l);
+    }
+    void jcc(Cond cc, int l)
+    {
+        byte(0x0F);
+        byte((uint8_t)cc);
+        fixup(l);
+    }
+
+    // false — остался непривязанный переход
+    bool resolve()
+    {
+        for (const auto &f : fixups)
+        {
+            if (labels[f.second] < 0)
+                return false;
+            const int32_t rel = labels[f.second] - (f.first + 4);
+            std::memcpy(&buf[f.first], &rel, 4);
+        }
+        return true;
+    }
+
+    void push(int r)
+    {
+        if (r >= 8)
+            byte(0x41);
+        byte(0x50 + (r & 7));
+    }
+    void pop(int r)
+    {
+        if (r >= 8)
+            byte(0x41);
+        byte(0x58 + (r & 7));
+    }
+    void ret() { byte(0xC3); }
+
+    void subRsp(int32_t v) { rexW(0, RSP), byte(0x81), modrm(3, 5, RSP), u32(v); }
+    void addRsp(int32_t v) { rexW(0, RSP), byte(0x81), modrm(3, 0, RSP), u32(v); }
+
+    void movRR(int dst, int src) // mov dst, src (64)
+    {
+        rexW(src, dst);
+        byte(0x89);
+        modrm(3, src & 7, dst & 7);
+    }
+    void movRM(int dst, int base, int32_t disp) // mov dst, [base + disp] (64)
+    {
+        rexW(dst, base);
+        byte(0x8B);
+        mem(dst, base, disp);
+    }
+    void movImm64(int dst, uint64_t v)
+    {
+        rexW(0, dst);
+        byte(0xB8 + (dst & 7));
+        u64(v);
+    }
+    void movImm32(int dst, uint32_t v) // mov r32, imm (обнуляет старшую половину)
+    {
+        if (dst >= 8)
+            byte(0x41);
+        byte(0xB8 + (dst & 7));
+        u32(v);
+    }
+    void cmpRR(int a, int b) // cmp a, b (64)
+    {
+        rexW(b, a);
+        byte(0x39);
+        modrm(3, b & 7, a & 7);
+    }
+    void callR(int r)
+    {
+        if (r >= 8)
+            byte(0x41);
+        byte(0xFF);
+        modrm(3, 2, r & 7);
+    }
+    void testEax() { byte(0x85), byte(0xC0); }
+
+    // SSE2, скалярный double
+    void movsdLoad(int x, int base, int32_t disp) { sseMem(0xF2, 0x10, x, base, disp); }
+    void movsdStore(int x, int base, int32_t disp) { sseMem(0xF2, 0x11, x, base, disp); }
+    void arith(uint8_t op, int x, int base, int32_t disp) { sseMem(0xF2, op, x, base, disp); }
+    void ucomisd(int a, int b) { sseReg(0x66, 0x2E, a, b); }
+    void xorpd(int a, int b) { sseReg(0x66, 0x57, a, b); }
+    void movqXR(int x, int r) // movq xmm, r64
+    {
+        byte(0x66);
+        rexW(x, r);
+        byte(0x0F), byte(0x6E);
+        modrm(3, x & 7, r & 7);
+    }
+    void cvttsd2si(int r, int x) // r64 = (int64)xmm
+    {
+        byte(0xF2);
+        rexW(r, x);
+        byte(0x0F), byte(0x2C);
+        modrm(3, r & 7, x & 7);
+    }
+    void cvtsi2sd(int x, int r)
+    {
+        byte(0xF2);
+        rexW(x, r);
+        byte(0x0F), byte(0x2A);
+        modrm(3, x & 7, r & 7);
+    }
+    // movsd xmm, [base + index*8] и обратно (base, index < 8)
+    void movsdLoadIdx(int x, int base, int index) { sseIdx(0x10, x, base, index); }
+    void movsdStoreIdx(int x, int base, int index) { sseIdx(0x11, x, base, index); }
+
+    // xmm = константа
+    void loadConst(int x, double v)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &v, 8);
+        movImm64(RAX, bits);
+        movqXR(x, RAX);
+    }
+
+    static constexpr uint8_t ADDSD = 0x58, MULSD = 0x59, SUBSD = 0x5C, DIVSD = 0x5E;
+
+private:
+    std::vector<int> labels;
+    std::vector<std::pair<int, int>> fixups; // позиция rel32, метка
+
+    void byte(uint8_t b) { buf.push_back(b); }
+    void u32(uint32_t v)
+    {
+        for (int i = 0; i < 4; ++i)
+            byte((uint8_t)(v >> (8 * i)));
+    }
+    void u64(uint64_t v)
+    {
+        for (int i = 0; i < 8; ++i)
+            byte((uint8_t)(v >> (8 * i)));
+    }
+    void fixup(int l)
+    {
+        fixups.push_back({(int)buf.size(), l});
+        u32(0);
+    }
+    void modrm(int mod, int reg, int rm) { byte((uint8_t)((mod << 6) | ((reg & 7) << 3) | (rm & 7))); }
+    void rex(bool w, int r, int b)
+    {
+        const uint8_t v = (uint8_t)(0x40 | (w ? 8 : 0) | ((r >> 3) << 2) | (b >> 3));
+        if (v != 0x40)
+            byte(v);
+    }
+    void rexW(int r, int b) { rex(true, r, b); }
+    // [base + disp32]
+    void mem(int reg, int base, int32_t disp)
+    {
+        modrm(2, reg, base);
+        if ((base & 7) == RSP)
+            byte(0x24); // SIB для rsp/r12
+        u32((uint32_t)disp);
+    }
+    void sseMem(uint8_t prefix, uint8_t op, int x, int base, int32_t disp)
+    {
+        byte(prefix);
+        rex(false, x, base);
+        byte(0x0F), byte(op);
+        mem(x, base, disp);
+    }
+    void sseReg(uint8_t prefix, uint8_t op, int a, int b)
+    {
+        byte(prefix);
+        rex(false, a, b);
+        byte(0x0F), byte(op);
+        modrm(3, a, b);
+    }
+    void sseIdx(uint8_t op, int x, int base, int index)
+    {
+        byte(0xF2);
+        byte(0x0F), byte(op);
+        modrm(0, x, RSP); // SIB
+        byte((uint8_t)((3 << 6) | ((index & 7) << 3) | (base & 7)));
+    }
+};
+
+// Скомпилированный цикл. fn возвращает 0 — цикл завершён (выход за '}'),
+// иначе номер выхода: tick продолжает со слова bc.stmtOf[exitPc[номер]]
+struct JitLoop
+{
+    JitMemory memory;
+    JitFn fn = nullptr;
+    std::vector<int> exitPc;
+};
+
+class JitCompiler
+{
+public:
+    JitCompiler(const Bytecode &code, const BytecodeLoop &l, const JitHelpers &h) : bc(code), loop(l), helpers(h) {}
+
+    bool compile(JitLoop &out)
+    {
+        typedef X64Emitter E;
+        const FuncInfo &fi = bc.funcs[loop.func];
+        nvars = fi.nvars;
+        narrs = fi.narrs;
+        const int temps = fi.nregs - fi.nvars;
+        // на входе rsp ≡ 8 (mod 16); 6 push — снова 8; кадр ≡ 8 выравнивает вызовы
+        const int frame = (temps * 8 + 15) / 16 * 16 + 8;
+
+        pcLabel.assign(bc.code.size() + 1, -1);
+        for (int pc = loop.top; pc < loop.exit; ++pc)
+            pcLabel[pc] = e.newLabel();
+        out.exitPc.assign(1, -1);
+        done = e.newLabel();
+        epilogue = e.newLabel();
+
+        // пролог
+        for (int r : {E::RBX, E::RBP, E::R12, E::R13, E::R14, E::R15})
+            e.push(r);
+        e.subRsp(frame);
+        e.movRR(E::RBP, E::RDI);
+        e.movRM(E::RBX, E::RBP, 0);
+        e.movRM(E::R12, E::RBP, 8);
+        e.movRM(E::R15, E::RBP, 16);
+        e.movRM(E::R14, E::RBP, 24);
+        e.movRR(E::R13, E::RSP);
+        // инварианты — в временные регистры на стеке. LICM выносит выражение в
+        // самый внешний цикл, где оно не меняется, а машинный код начинается
+        // с внутреннего: считаем пре-хедеры всех охватывающих циклов, снаружи внутрь
+        std::vector<const BytecodeLoop *> outer;
+        for (const BytecodeLoop &o : bc.loops)
+            if (o.func == loop.func && o.hoist <= loop.hoist && loop.exit <= o.exit)
+                outer.push_back(&o);
+        std::sort(outer.begin(), outer.end(), [](const BytecodeLoop *a, const BytecodeLoop *b)
+                  { return a->hoist < b->hoist; });
+        for (const BytecodeLoop *o : outer)
+            for (int pc = o->hoist; pc < o->hoistEnd; ++pc)
+                if (!genInstr(pc))
+                    return false;
+        e.jmp(target(loop.cond)); // условие могло свернуться в ничто: cond == exit
+
+        for (int pc = loop.top; pc < loop.exit; ++pc)
+        {
+            e.bind(pcLabel[pc]);
+            if (!genInstr(pc))
+                return false;
+        }
+        e.jmp(done);
+
+        // выходы
+        e.bind(done);
+        e.movImm32(E::RAX, 0);
+        e.jmp(epilogue);
+        for (const auto &x : exits)
+        {
+            e.bind(x.label);
+            e.movImm32(E::RAX, (uint32_t)x.id);
+            e.jmp(epilogue);
+        }
+        e.bind(epilogue);
+        e.addRsp(frame);
+        for (int r : {E::R15, E::R14, E::R13, E::R12, E::RBP, E::RBX})
+            e.pop(r);
+        e.ret();
+
+        if (!e.resolve())
+            return false;
+        for (const auto &x : exits)
+            out.exitPc.push_back(x.pc);
+        out.fn = (JitFn)out.memory.commit(e.buf);
+        return out.fn != nullptr;
+    }
+
+private:
+    typedef X64Emitter E;
+
+    const Bytecode &bc;
+    const BytecodeLoop &loop;
+    const JitHelpers &helpers;
+    X64Emitter e;
+    int nvars = 0;
+    int narrs = 0;
+    std::vector<int> pcLabel;
+    int done = -1;
+    int epilogue = -1;
+
+    struct Exit
+    {
+        int label;
+        int id;
+        int pc;
+    };
+    std::vector<Exit> exits;
+
+    // Метка выхода в интерпретатор для оператора, которому принадлежит pc
+    int deopt(int pc)
+    {
+        const int word = bc.stmtOf[pc];
+        for (const Exit &x : exits)
+            if (bc.stmtOf[x.pc] == word)
+                return x.label;
+        exits.push_back({e.newLabel(), (int)exits.size() + 1, pc});
+        return exits.back().label;
+    }
+
+    // Переход на pc байткода: внутри цикла — метка, на выход — done
+    int target(int pc) const
+    {
+        if (pc == loop.exit)
+            return done;
+        if (pc >= loop.top && pc < loop.exit)
+            return pcLabel[pc];
+        return -1;
+    }
+
+    // Ячейка регистра: переменная кадра или временный на стеке
+    int base(int slot) const { return slot < nvars ? E::RBX : E::R13; }
+    int disp(int slot) const { return 8 * (slot < nvars ? slot : slot - nvars); }
+    void load(int x, int slot) { e.movsdLoad(x, base(slot), disp(slot)); }
+    void store(int x, int slot) { e.movsdStore(x, base(slot), disp(slot)); }
+    void loadK(int x, int k) { e.movsdLoad(x, E::R14, 8 * k); }
+
+    // Переход на l, если (xmm0 cmp xmm1) (или его отрицание)
+    void cmpJump(int cmp, bool negate, int l)
+    {
+        switch (cmp)
+        {
+        case CMP_LT:
+        case CMP_LE:
+            e.ucomisd(1, 0); // b ? a
+            break;
+        case CMP_GT:
+        case CMP_GE:
+            e.ucomisd(0, 1);
+            break;
+        default:
+        {
+            e.ucomisd(0, 1);
+            const bool equal = (cmp == CMP_EQ) != negate;
+            if (equal)
+            {
+                int skip = e.newLabel();
+                e.jcc(E::CC_P, skip);
+                e.jcc(E::CC_E, l);
+                e.bind(skip);
+            }
+            else
+            {
+                e.jcc(E::CC_P, l);
+                e.jcc(E::CC_NE, l);
+            }
+            return;
+        }
+        }
+        // неупорядоченные (NaN) дают CF=ZF=1: ни A, ни AE
+        const bool strict = (cmp == CMP_LT || cmp == CMP_GT);
+        if (strict)
+            e.jcc(negate ? E::CC_BE : E::CC_A, l);
+        else
+            e.jcc(negate ? E::CC_B : E::CC_AE, l);
+    }
+
+    // rax = целый индекс из xmm0, иначе deopt; rdx = data массива t
+    void arrayIndex(int t, int bad)
+    {
+        e.cvttsd2si(E::RAX, 0);
+        e.cvtsi2sd(1, E::RAX);
+        e.ucomisd(0, 1);
+        e.jcc(E::CC_P, bad);
+        e.jcc(E::CC_NE, bad);
+        e.movRM(E::RDX, E::R15, 16 * t + 8);
+        e.cmpRR(E::RAX, E::RDX);
+        e.jcc(E::CC_AE, bad); // отрицательные — огромные без знака
+        e.movRM(E::RDX, E::R15, 16 * t);
+    }
+
+    void callHelper(const void *fn)
+    {
+        e.movImm64(E::RAX, (uint64_t)(uintptr_t)fn);
+        e.callR(E::RAX);
+    }
+
+    static double fmodHelper(double a, double b) { return std::fmod(a, b); }
+    static double powHelper(double a, double b) { return std::pow(a, b); }
+
+    bool genInstr(int pc)
+    {
+        const Instr &I = bc.code[pc];
+        switch (I.op)
+        {
+        case OP_NOP:
+            return true;
+        case OP_MOV:
+            load(0, I.b);
+            store(0, I.a);
+            return true;
+        case OP_LOADK:
+            loadK(0, I.b);
+            store(0, I.a);
+            return true;
+        case OP_GETG:
+            e.movsdLoad(0, E::R12, 8 * I.b);
+            store(0, I.a);
+            return true;
+        case OP_SETG:
+            load(0, I.b);
+            e.movsdStore(0, E::R12, 8 * I.a);
+            return true;
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_DIV:
+        {
+            static const uint8_t ops[] = {E::ADDSD, E::SUBSD, E::MULSD, E::DIVSD};
+            load(0, I.b);
+            e.arith(ops[I.op - OP_ADD], 0, base(I.c), disp(I.c));
+            store(0, I.a);
+            return true;
+        }
+        case OP_ADDK:
+        case OP_SUBK:
+        case OP_MULK:
+        case OP_DIVK:
+        {
+            static const uint8_t ops[] = {E::ADDSD, E::SUBSD, E::MULSD, E::DIVSD};
+            load(0, I.b);
+            e.arith(ops[I.op - OP_ADDK], 0, E::R14, 8 * I.c);
+            store(0, I.a);
+            return true;
+        }
+        case OP_MOD:
+        case OP_POW:
+            load(0, I.b);
+            load(1, I.c);
+            callHelper(I.op == OP_MOD ? (const void *)&fmodHelper : (const void *)&powHelper);
+            store(0, I.a);
+            return true;
+        case OP_NEG:
+            load(0, I.b);
+            e.movImm64(E::RAX, 0x8000000000000000ULL);
+            e.movqXR(1, E::RAX);
+            e.xorpd(0, 1);
+            store(0, I.a);
+            return true;
+        case OP_NOT:
+        {
+            // (b == 0) ? 1 : 0; NaN != 0
+            int one = e.newLabel(), end = e.newLabel();
+            load(0, I.b);
+            e.xorpd(1, 1);
+            cmpJump(CMP_EQ, false, one);
+            e.loadConst(0, 0.0);
+            e.jmp(end);
+            e.bind(one);
+            e.loadConst(0, 1.0);
+            e.bind(end);
+            store(0, I.a);
+            return true;
+        }
+        case OP_LT:
+        case OP_LE:
+        case OP_GT:
+        case OP_GE:
+        case OP_EQ:
+        case OP_NE:
+        {
+            int yes = e.newLabel(), end = e.newLabel();
+            load(0, I.b);
+            load(1, I.c);
+            cmpJump(I.op - OP_LT, false, yes);
+            e.loadConst(0, 0.0);
+            e.jmp(end);
+            e.bind(yes);
+            e.loadConst(0, 1.0);
+            e.bind(end);
+            store(0, I.a);
+            return true;
+        }
+        case OP_JMP:
+        {
+            const int l = target(I.a);
+            if (l < 0)
+                return false;
+            e.jmp(l);
+            return true;
+        }
+        case OP_JZ:
+        case OP_JNZ:
+        {
+            // Истинность как у tick: 0 — ложь, >= 1 — истина, иначе tick
+            // сам сообщит об ошибке (или решит по-своему) — deopt
+            const int l = target(I.a);
+            if (l < 0)
+                return false;
+            const int bad = deopt(pc);
+            int nonzero = e.newLabel(), zero = e.newLabel();
+            load(0, I.b);
+            e.xorpd(1, 1);
+            e.ucomisd(0, 1);
+            e.jcc(E::CC_P, nonzero);
+            e.jcc(E::CC_E, I.op == OP_JZ ? l : zero);
+            e.bind(nonzero);
+            e.loadConst(1, 1.0);
+            e.ucomisd(0, 1);
+            e.jcc(E::CC_B, bad);
+            if (I.op == OP_JNZ)
+                e.jmp(l);
+            e.bind(zero);
+            return true;
+        }
+        case OP_CALLF1:
+        case OP_CALLF2:
+        {
+            const Builtin &B = builtins()[I.c];
+            load(0, I.b);
+            if (I.op == OP_CALLF2)
+                load(1, I.b + 1);
+            callHelper(I.op == OP_CALLF1 ? (const void *)B.f1 : (const void *)B.f2);
+            store(0, I.a);
+            return true;
+        }
+        case OP_GETA:
+        case OP_GETAG:
+        {
+            const int t = (I.op == OP_GETA) ? I.b : narrs + I.b;
+            load(0, I.c);
+            arrayIndex(t, deopt(pc));
+            e.movsdLoadIdx(0, E::RDX, E::RAX);
+            store(0, I.a);
+            return true;
+        }
+        case OP_SETA:
+        case OP_SETAG:
+        {
+            const int t = (I.op == OP_SETA) ? I.a : narrs + I.a;
+            load(0, I.b);
+            arrayIndex(t, deopt(pc));
+            load(0, I.c);
+            e.movsdStoreIdx(0, E::RDX, E::RAX);
+            return true;
+        }
+        case OP_GETAU:
+            load(0, I.c);
+            e.cvttsd2si(E::RAX, 0);
+            e.movRM(E::RDX, E::R15, 16 * I.b);
+            e.movsdLoadIdx(0, E::RDX, E::RAX);
+            store(0, I.a);
+            return true;
+        case OP_SETAU:
+            load(0, I.b);
+            e.cvttsd2si(E::RAX, 0);
+            e.movRM(E::RDX, E::R15, 16 * I.a);
+            load(0, I.c);
+            e.movsdStoreIdx(0, E::RDX, E::RAX);
+            return true;
+        case OP_VLOOP:
+        {
+            const int l = target(I.b);
+            if (l < 0)
+                return false;
+            e.movRM(E::RDI, E::RBP, 32);
+            e.movImm32(E::RSI, (uint32_t)I.a);
+            callHelper((const void *)helpers.kernel);
+            e.testEax();
+            e.jcc(E::CC_NE, l);
+            return true;
+        }
+        default:
+            if (I.op >= OP_JLT && I.op <= OP_JNNEK)
+            {
+                const int group = (I.op - OP_JLT) / 6; // R, K, !R, !K
+                const int l = target(I.a);
+                if (l < 0)
+                    return false;
+                load(0, I.b);
+                if (group % 2)
+                    loadK(1, I.c);
+                else
+                    load(1, I.c);
+                cmpJump((I.op - OP_JLT) % 6, group >= 2, l);
+                return true;
+            }
+            // PRINT, вызовы, NEWARR, RETURN, HALT, WARN, ERR — интерпретатору
+            e.jmp(deopt(pc));
+            return true;
+        }
+    }
+};
+
+#endif
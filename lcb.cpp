@@ -0,0 +1,296 @@
+#pragma once
+#include "system.cpp"
+#include "source.cpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <type_traits>
+
+// ===== Предкомпилированная программа (.lcb) =====
+// Результат разбора одним блоком: заголовок и секции, выровненные по 8 байт.
+//   strings — различные слова: смещение и длина в blob, текст ли это строки
+//   words   — номер строки для каждого слова программы
+//   tokens  — биты Token (token.cpp), numbers и names — таблицы TokenStream
+//   match   — таблица пар matchWord, procs — таблица процедур
+//   resolution — итог разрешения имён (LcbWriter, формат задаёт lilc)
+//   blob    — тексты слов с завершающим '\0'
+// Файл отображается в память целиком. При загрузке различные имена
+// интернируются по разу, тексты строк читаются прямо из отображения.
+// LILC_LCB_VERSION меняется вместе с лексером, токенами или таблицами;
+// config — отпечаток сборки, записавшей образ (его задаёт и проверяет lilc).
+
+#define LILC_LCB_VERSION 2
+
+struct LcbHeader
+{
+    char magic[4];      // "LCB\0"
+    uint32_t version;   // LILC_LCB_VERSION
+    uint32_t byteOrder; // kLcbByteOrder записавшей машины
+    uint32_t words;
+    uint64_t sourceHash; // lilcHash исходника; после loadProgram — хеш слов
+    uint64_t sourceSize;
+    uint64_t config;
+    uint32_t strings;
+    uint32_t numbers;
+    uint32_t names;
+    uint32_t procs;
+    uint64_t resolutionBytes;
+    uint64_t blobBytes;
+    uint64_t checksum; // lilcHash всего, что после заголовка
+};
+
+struct LcbString
+{
+    uint32_t offset;
+    uint32_t length;
+    uint32_t text; // 1 — текст строкового литерала, не интернируется
+    uint32_t reserved;
+};
+
+struct LcbProc
+{
+    uint32_t name; // номер строки
+    int32_t nameWord;
+    int32_t openBrace;
+    int32_t closeBrace;
+    int32_t params;
+};
+
+static constexpr uint32_t kLcbByteOrder = 0x01020304;
+
+// Содержимое для записи
+struct LcbData
+{
+    uint64_t sourceHash = 0;
+    uint64_t sourceSize = 0;
+    uint64_t config = 0;
+    std::vector<LcbString> strings;
+    std::vector<uint32_t> words;
+    std::vector<uint32_t> tokens;
+    std::vector<int32_t> match;
+    std::vector<double> numbers;
+    std::vector<uint32_t> names;
+    std::vector<LcbProc> procs;
+    std::string resolution;
+    std::string blob;
+
+    // Номер строки для текста (blob пополняется)
+    uint32_t addString(const char *s, bool text)
+    {
+        LcbString e{(uint32_t)blob.size(), (uint32_t)std::strlen(s), text ? 1u : 0u, 0};
+        blob.append(s, e.length + 1);
+        strings.push_back(e);
+        return (uint32_t)strings.size() - 1;
+    }
+
+    std::string encode() const
+    {
+        LcbHeader h{};
+        std::memcpy(h.magic, "LCB", 4);
+        h.version = LILC_LCB_VERSION;
+        h.byteOrder = kLcbByteOrder;
+        h.words = (uint32_t)words.size();
+        h.sourceHash = sourceHash;
+        h.sourceSize = sourceSize;
+        h.config = config;
+        h.strings = (uint32_t)strings.size();
+        h.numbers = (uint32_t)numbers.size();
+        h.names = (uint32_t)names.size();
+        h.procs = (uint32_t)procs.size();
+        h.resolutionBytes = resolution.size();
+        h.blobBytes = blob.size();
+
+        std::string out;
+        put(out, &h, sizeof(h));
+        put(out, strings.data(), strings.size() * sizeof(LcbString));
+        put(out, words.data(), words.size() * sizeof(uint32_t));
+        put(out, tokens.data(), tokens.size() * sizeof(uint32_t));
+        put(out, match.data(), match.size() * sizeof(int32_t));
+        put(out, numbers.data(), numbers.size() * sizeof(double));
+        put(out, names.data(), names.size() * sizeof(uint32_t));
+        put(out, procs.data(), procs.size() * sizeof(LcbProc));
+        put(out, resolution.data(), resolution.size());
+        put(out, blob.data(), blob.size());
+        const size_t body = (sizeof(h) + 7) & ~size_t(7);
+        h.checksum = lilcHash(out.data() + body, out.size() - body);
+        std::memcpy(&out[0], &h, sizeof(h));
+        return out;
+    }
+
+private:
+    static void put(std::string &out, const void *p, size_t n)
+    {
+        out.append(static_cast<const char *>(p), n);
+        out.resize((out.size() + 7) & ~size_t(7), '\0');
+    }
+};
+
+// Образ в памяти: проверка заголовка и границ секций, указатели на них
+class LcbImage
+{
+public:
+    // false — не .lcb этой версии, файл обрезан или повреждён
+    bool open(const char *data, size_t size)
+    {
+        base = data;
+        if (size < sizeof(LcbHeader))
+            return false;
+        std::memcpy(&h, data, sizeof(h));
+        if (std::memcmp(h.magic, "LCB", 4) != 0 || h.version != LILC_LCB_VERSION || h.byteOrder != kLcbByteOrder)
+            return false;
+        size_t at = align(sizeof(LcbHeader));
+        if (at > size || lilcHash(data + at, size - at) != h.checksum)
+            return false;
+        const bool ok = section(at, size, h.strings, sizeof(LcbString), strOff) &&
+                        section(at, size, h.words, sizeof(uint32_t), wordOff) &&
+                        section(at, size, h.words, sizeof(uint32_t), tokenOff) &&
+                        section(at, size, h.words, sizeof(int32_t), matchOff) &&
+                        section(at, size, h.numbers, sizeof(double), numberOff) &&
+                        section(at, size, h.names, sizeof(uint32_t), nameOff) &&
+                        section(at, size, h.procs, sizeof(LcbProc), procOff) &&
+                        section(at, size, h.resolutionBytes, 1, resolutionOff) &&
+                        section(at, size, h.blobBytes, 1, blobOff);
+        if (!ok)
+            return false;
+        for (uint32_t s = 0; s < h.strings; ++s)
+        {
+            const LcbString &e = strings()[s];
+            if ((uint64_t)e.offset + e.length >= h.blobBytes || blob()[e.offset + e.length] != '\0')
+                return false;
+        }
+        return true;
+    }
+
+    const LcbHeader &header() const { return h; }
+    const LcbString *strings() const { return at<LcbString>(strOff); }
+    const uint32_t *words() const { return at<uint32_t>(wordOff); }
+    const uint32_t *tokens() const { return at<uint32_t>(tokenOff); }
+    const int32_t *match() const { return at<int32_t>(matchOff); }
+    const double *numbers() const { return at<double>(numberOff); }
+    const uint32_t *names() const { return at<uint32_t>(nameOff); }
+    const LcbProc *procs() const { return at<LcbProc>(procOff); }
+    const char *resolution() const { return base + resolutionOff; }
+    const char *blob() const { return base + blobOff; }
+    const char *text(uint32_t s) const { return blob() + strings()[s].offset; }
+
+private:
+    const char *base = nullptr;
+    LcbHeader h{};
+    size_t strOff = 0, wordOff = 0, tokenOff = 0, matchOff = 0, numberOff = 0, nameOff = 0, procOff = 0;
+    size_t resolutionOff = 0, blobOff = 0;
+
+    static size_t align(size_t n) { return (n + 7) & ~size_t(7); }
+
+    static bool section(size_t &at, size_t size, uint64_t count, size_t elem, size_t &off)
+    {
+        if (at > size || count > (size - at) / elem)
+            return false;
+        off = at;
+        at = align(at + count * elem);
+        return true;
+    }
+
+    template <class T>
+    const T *at(size_t off) const { return reinterpret_cast<const T *>(base + off); }
+};
+
+// Плоские значения и векторы подряд — для секции resolution
+class LcbWriter
+{
+public:
+    explicit LcbWriter(std::string &to) : out(to) {}
+
+    template <class T>
+    void put(const T &v)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "LcbWriter: plain data only");
+        out.append(reinterpret_cast<const char *>(&v), sizeof(T));
+    }
+
+    template <class T>
+    void put(const std::vector<T> &v)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "LcbWriter: plain data only");
+        put((uint32_t)v.size());
+        out.append(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+    }
+
+private:
+    std::string &out;
+};
+
+// Чтение с проверкой границ: после выхода за конец ok() == false, а
+// значения нулевые
+class LcbReader
+{
+public:
+    LcbReader(const char *data, size_t size) : p(data), end(data + size) {}
+
+    template <class T>
+    void get(T &v)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "LcbReader: plain data only");
+        if (!take(sizeof(T)))
+        {
+            v = T();
+            return;
+        }
+        std::memcpy(&v, p - sizeof(T), sizeof(T));
+    }
+
+    template <class T>
+    void get(std::vector<T> &v)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "LcbReader: plain data only");
+        uint32_t n = 0;
+        get(n);
+        v.clear();
+        if (n > (size_t)(end - p) / sizeof(T) || !take(n * sizeof(T)))
+        {
+            good = false;
+            return;
+        }
+        v.resize(n);
+        if (n)
+            std::memcpy(v.data(), p - n * sizeof(T), n * sizeof(T));
+    }
+
+    bool ok() const { return good; }
+    bool atEnd() const { return p == end; }
+
+private:
+    const char *p;
+    const char *end;
+    bool good = true;
+
+    bool take(size_t n)
+    {
+        if (!good || n > (size_t)(end - p))
+            return good = false;
+        p += n;
+        return true;
+    }
+};
+
+// Записать файл целиком: через временный и rename, чтобы параллельный
+// запуск не прочитал недописанный образ
+inline bool lcbWriteFile(const std::string &path, const std::string &bytes)
+{
+#ifdef LILC_MMAP_SUPPORTED
+    const std::string tmp = path + "." + std::to_string((long)::getpid()) + ".tmp";
+#else
+    const std::string tmp = path + ".tmp";
+#endif
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+    const bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+    if (std::fclose(f) != 0 || !ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,281 @@
+#pragma once
+#include "system.cpp"
+#include "simd.cpp"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+// ===== Лексер =====
+// Текст программы → интернированные слова. Каждый байт — буква слова,
+// пробел, односимвольный оператор или кавычка. Длинные прогоны (имена,
+// отступы, строки) пропускаются блоками по 32 байта на AVX2: класс байта
+// берётся из двух таблиц по 16 байт — по младшей и старшей тетраде
+// (vpshufb). Двухсимвольные операторы != == <= >= && || склеиваются сразу,
+// длина слов и строк не ограничена. Слова берутся прямо из текста
+// (string_view), так что он может быть и отображённым в память файлом.
+
+enum LexClass : uint8_t
+{
+    LX_WORD = 0,
+    LX_SPACE,
+    LX_OP,
+    LX_QUOTE
+};
+
+struct LexTable
+{
+    uint8_t cls[256];
+
+    constexpr LexTable() : cls()
+    {
+        const char *ops = "[]><{}();,+-*/^%=!&|";
+        for (int i = 0; ops[i]; ++i)
+            cls[(unsigned char)ops[i]] = LX_OP;
+        const char *spaces = " \t\n\v\f\r";
+        for (int i = 0; spaces[i]; ++i)
+            cls[(unsigned char)spaces[i]] = LX_SPACE;
+        cls[(unsigned char)'"'] = LX_QUOTE;
+    }
+};
+
+inline constexpr LexTable kLexTable{};
+
+enum LexStop
+{
+    LS_WORD_END,  // первый не-буквенный байт
+    LS_SPACE_END, // первый не-пробел
+    LS_STRING     // первая кавычка или '\'
+};
+
+#ifdef LILC_VEC_AVX2
+inline int lexCtz(uint32_t m)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return (int)i;
+#else
+    return __builtin_ctz(m);
+#endif
+}
+
+// Класс 32 байт: lo[младшая тетрада] & hi[старшая]. 0 — буква слова,
+// биты 0-1 — пробелы (0x09-0x0D и ' '), биты 2-5 — операторы и кавычка
+// в строках 0x2_, 0x3_, 0x5_, 0x7_ таблицы ASCII
+LILC_AVX2_TARGET inline __m256i lexClassify(__m256i v)
+{
+    const __m256i lo = _mm256_setr_epi8(
+        0x02, 0x04, 0x04, 0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x05, 0x05, 0x3D, 0x2D, 0x3D, 0x18, 0x04,
+        0x02, 0x04, 0x04, 0x00, 0x00, 0x04, 0x04, 0x00, 0x04, 0x05, 0x05, 0x3D, 0x2D, 0x3D, 0x18, 0x04);
+    const __m256i hi = _mm256_setr_epi8(
+        0x01, 0x00, 0x06, 0x08, 0x00, 0x10, 0x00, 0x20, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x01, 0x00, 0x06, 0x08, 0x00, 0x10, 0x00, 0x20, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    const __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(v, nib));
+    const __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(v, 4), nib));
+    return _mm256_and_si256(l, h);
+}
+
+// Полные блоки от pos; хвост короче 32 байт дочищает скалярный цикл
+template <LexStop Stop>
+LILC_AVX2_TARGET inline size_t lexScanAvx2(const char *s, size_t pos, size_t len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    for (; pos + 32 <= len; pos += 32)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(s + pos));
+        uint32_t m;
+        if (Stop == LS_WORD_END)
+            m = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lexClassify(v), zero));
+        else if (Stop == LS_SPACE_END)
+            m = (uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_and_si256(lexClassify(v), _mm256_set1_epi8(0x03)), zero));
+        else
+            m = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+        if (m)
+            return pos + lexCtz(m);
+    }
+    return pos;
+}
+#endif
+
+class Lexer
+{
+public:
+    // Имена и операторы интернируются (нужна идентичность указателей),
+    // тексты строк копируются в texts
+    Lexer(const Symbols &syms, Interner &interner, TextArena &texts) : S(syms), I(interner), T(texts) {}
+
+    // AVX2 используется, если он есть на машине; false — только таблица
+    void setSimd(bool on) { simd = on && vecHasAvx2(); }
+
+    // Строка "текст" даёт три слова: QUOTE, текст без экранирующих '\', QUOTE
+    void run(const char *src, size_t len, std::vector<Id> &words)
+    {
+        size_t p = 0;
+        while (p < len)
+        {
+            switch (kLexTable.cls[(unsigned char)src[p]])
+            {
+            case LX_SPACE:
+                p = skipSpace(src, p + 1, len);
+                break;
+            case LX_OP:
+                p = op(src, p, len, words);
+                break;
+            case LX_QUOTE:
+                p = str(src, p + 1, len, words);
+                break;
+            default:
+            {
+                const size_t e = skipWord(src, p + 1, len);
+                words.push_back(I.intern(std::string_view(src + p, e - p)));
+                p = e;
+            }
+            }
+        }
+    }
+
+private:
+    const Symbols &S;
+    Interner &I;
+    TextArena &T;
+    bool simd = vecHasAvx2();
+    std::string text; // строка с экранированием
+
+    // Короткие прогоны (их большинство) дешевле пройти по таблице: блоки
+    // начинаются, только если прогон длиннее kQuick байт
+    static constexpr size_t kQuick = 16;
+
+    static bool isWord(char c) { return kLexTable.cls[(unsigned char)c] == LX_WORD; }
+    static bool isSpace(char c) { return kLexTable.cls[(unsigned char)c] == LX_SPACE; }
+    static bool isText(char c) { return c != '"' && c != '\\'; }
+
+    template <LexStop Stop, bool (*Keep)(char)>
+    size_t scan(const char *s, size_t p, size_t len) const
+    {
+        const size_t quick = p + kQuick < len ? p + kQuick : len;
+        while (p < quick && Keep(s[p]))
+            ++p;
+#ifdef LILC_VEC_AVX2
+        if (simd && p == quick)
+            p = lexScanAvx2<Stop>(s, p, len);
+#endif
+        while (p < len && Keep(s[p]))
+            ++p;
+        return p;
+    }
+
+    size_t skipWord(const char *s, size_t p, size_t len) const { return scan<LS_WORD_END, isWord>(s, p, len); }
+    size_t skipSpace(const char *s, size_t p, size_t len) const { return scan<LS_SPACE_END, isSpace>(s, p, len); }
+    size_t findQuote(const char *s, size_t p, size_t len) const { return scan<LS_STRING, isText>(s, p, len); }
+
+    size_t op(const char *s, size_t p, size_t len, std::vector<Id> &words) const
+    {
+        const char c = s[p];
+        const char next = p + 1 < len ? s[p + 1] : '\0';
+        Id pair = nullptr;
+        if (next == '=')
+            pair = c == '!' ? S.NEQ : c == '=' ? S.EQEQ : c == '<' ? S.LEQ : c == '>' ? S.GEQ : nullptr;
+        else if (c == '&' && next == '&')
+            pair = S.ANDAND;
+        else if (c == '|' && next == '|')
+            pair = S.OROR;
+        if (pair)
+        {
+            words.push_back(pair);
+            return p + 2;
+        }
+        words.push_back(single(c));
+        return p + 1;
+    }
+
+    Id single(char c) const
+    {
+        switch (c)
+        {
+        case '[':
+            return S.LBRACKET;
+        case ']':
+            return S.RBRACKET;
+        case '>':
+            return S.GT;
+        case '<':
+            return S.LT;
+        case '{':
+            return S.LBRACE;
+        case '}':
+            return S.RBRACE;
+        case '(':
+            return S.LP;
+        case ')':
+            return S.RP;
+        case ';':
+            return S.SEMI;
+        case ',':
+            return S.COMMA;
+        case '+':
+            return S.PLUS;
+        case '-':
+            return S.MINUS;
+        case '*':
+            return S.STAR;
+        case '/':
+            return S.SLASH;
+        case '^':
+            return S.CARET;
+        case '%':
+            return S.PERCENT;
+        case '=':
+            return S.EQ;
+        case '!':
+            return S.NOT;
+        case '&':
+            return S.AMP;
+        default:
+            return S.PIPE;
+        }
+    }
+
+    // p — после открывающей кавычки; '\' берёт следующий символ как есть
+    size_t str(const char *s, size_t p, size_t len, std::vector<Id> &words)
+    {
+        words.push_back(S.QUOTE);
+        const size_t from = p;
+        size_t seg = p; // начало ещё не скопированного куска
+        bool escaped = false;
+        for (;;)
+        {
+            const size_t e = findQuote(s, p, len);
+            if (e + 1 < len && s[e] == '\\')
+            {
+                if (!escaped)
+                    text.clear();
+                text.append(s + seg, e - seg);
+                text += s[e + 1];
+                escaped = true;
+                seg = p = e + 2;
+                continue;
+            }
+            p = e < len && s[e] == '\\' ? len : e; // '\' последним символом — обычный символ
+            break;
+        }
+        if (escaped)
+        {
+            text.append(s + seg, p - seg);
+            words.push_back(T.add(text));
+        }
+        else
+            words.push_back(T.add(std::string_view(s + from, p - from)));
+        if (p < len)
+        {
+            // закрывающая кавычка
+            words.push_back(S.QUOTE);
+            ++p;
+        }
+        return p;
+    }
+};
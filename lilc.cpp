@@ -3,6 +3,14 @@ extern "C"
 {
 #include "tinyexpr.h"
 }
+#include "vm.cpp"
+#include "aot.cpp"
+#include "jit.cpp"
+#include "fuse.cpp"
+#include "token.cpp"
+#include "lexer.cpp"
+#include "source.cpp"
+#include "lcb.cpp"
 #include <iostream>
 #include <vector>
 #include <cstring>
@@ -10,21 +18,62 @@ extern "C"
 #include <functional>
 #include <string>
 #include <iomanip>
-
-const static char *oneCharOperators = "[]><{}();,+-*/^%=\0";
+#include <climits>
+#include <cstdio>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+// Нижняя граница родного стека текущего потока; nullptr — неизвестна
+inline const char *nativeStackLow()
+{
+#if defined(__linux__)
+    pthread_attr_t attr;
+    void *low = nullptr;
+    size_t size = 0;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0)
+        return nullptr;
+    pthread_attr_getstack(&attr, &low, &size);
+    pthread_attr_destroy(&attr);
+    return static_cast<const char *>(low);
+#elif defined(__APPLE__)
+    const char *top = static_cast<const char *>(pthread_get_stackaddr_np(pthread_self()));
+    return top - pthread_get_stacksize_np(pthread_self());
+#else
+    return nullptr;
+#endif
+}
 
 class lilc
 {
 private:
     const Symbols *S = nullptr;
-    char *program = nullptr;
     char *expressionBuffer = nullptr; // Буфер для результата выражения
 
     std::vector<const char *> words;
+    TextArena texts;    // тексты строковых литералов (words указывают сюда)
+    TokenStream tokens; // вид и разобранный литерал каждого слова
+    SourceFile image;   // отображённый .lcb: тексты строк указывают в него
+    uint64_t sourceHash = 0, sourceSize = 0; // исходник загруженной программы
+    bool sourceHashed = false;               // sourceHash посчитан (loadFile с кэшем, .lcb)
+    bool codeCache = true;
     int currentWord = 0;
 
     controller control; // экземпляр контроллера для переменных
 
+    // Разрешение имён при загрузке: каждому слову — ячейка кадра
+    std::vector<SlotRef> wordRef;
+
+    // Поэлементные циклы (simd.cpp): слово WHILE -> ядро, -1 — обычный цикл
+    std::vector<VecKernel> kernels;
+    std::vector<int> loopKernel;
+    std::vector<double *> kArrays;
+    std::vector<size_t> kSizes;
+    std::vector<double> kScalars;
+
     enum DeepType
     {
         FREE = 0, // пустая вложенность {}
@@ -42,72 +91,202 @@ private:
         int INword = -1;    // номер слова открытия {
         int OUTword = -1;   // номер слова закрытия }
         int RETword = -1;   // слово на которое нужно вернуться после выхода из }
-
-        // fast while condition (optional)
-        bool fastCond = false;
-        enum CondOp
-        {
-            OP_LT,
-            OP_LE,
-            OP_GT,
-            OP_GE,
-            OP_EQ,
-            OP_NE
-        } condOp;
-        const char *condVarId = nullptr; // интернированное имя переменной из условия
-        double condCst = 0.0;            // правая константа
+        int cond = -1;      // слитое условие (fused), -1 — через вычислитель
     };
 
     std::vector<DeepCode> deepStack; // Стек вложенности
 
-    inline bool isExprToken(const char *w)
+    // Таблица пар, строится в loadProgram:
+    //   ( { [  <->  ) } ]   — индекс парной скобки
+    //   IF / WHILE / ELSE / PROC — индекс '{' их тела
+    //   BREAK / CONTINUE — индекс '{' тела их WHILE
+    // Остальные слова — -1
+    std::vector<int> matchWord;
+
+    // Таблица процедур: имя -> границы тела, строится в loadProgram
+    struct ProcInfo
     {
-        return w == S->PLUS || w == S->MINUS || w == S->STAR || w == S->SLASH ||
-               w == S->LP || w == S->RP || w == S->COMMA ||
-               w == S->EQEQ || w == S->NEQ || w == S->LEQ || w == S->GEQ ||
-               w == S->LT || w == S->GT ||
-               w == S->CARET || w == S->PERCENT;
-    }
+        int nameWord = -1;   // слово с именем (после PROC)
+        int openBrace = -1;  // '{' тела
+        int closeBrace = -1; // '}' тела
+        int frameVars = 0;   // размер кадра процедуры
+        int frameArrs = 0;
+        int params = 0;      // параметров в заголовке "( ... )"
+    };
+    std::unordered_map<Id, ProcInfo, PtrHash, PtrEq> procs;
 
-    inline bool isOneCharOperator(char c)
+    // Вызов процедуры с аргументами — оператором или внутри выражения.
+    // Значения кладутся в первые ячейки нового кадра, массивы — ссылками
+    struct ProcCall
     {
-        for (int i = 0; oneCharOperators[i] != '\0'; ++i)
-        {
-            if (c == oneCharOperators[i])
-            {
-                return true;
-            }
-        }
-        return false;
-    }
+        lilc *owner = nullptr;
+        const ProcInfo *proc = nullptr;
+        int word = -1;             // имя процедуры
+        int close = -1;            // ')' аргументов; -1 — "name;"
+        bool tail = false;         // RETURN name(...);
+        std::vector<int> from, to; // значения: слова [from, to)
+        std::vector<int> arrays;   // слова имён массивов-аргументов
+        std::string name;          // замыкание в тексте выражения
+    };
+    std::vector<ProcCall> procCalls;
+    std::vector<int> callAt; // слово имени -> procCalls
+    double retValue = 0.0;   // RETURN e; последней завершившейся процедуры
+
+    // Предекодированные операторы: для каждого слова — какой обработчик
+    // запустится, если выполнение дойдёт до него (порядок проверок как в
+    // прежней цепочке if в tick()). Последний элемент — конец программы.
+    enum StmtKind : uint8_t
+    {
+        ST_END = 0,
+        ST_CONST,
+        ST_VAR,
+        ST_PRINT,
+        ST_PRINTLN,
+        ST_CALL,
+        ST_SET,
+        ST_IF,
+        ST_WHILE,
+        ST_CLOSE,
+        ST_ELSE,
+        ST_SEMI,
+        ST_HALT,
+        ST_PROC,
+        ST_RETURN,
+        ST_UNKNOWN,
+        ST_FUSED, // присваивание по шаблону (fuse.cpp)
+        ST_STEP,  // шаг счётного цикла (fuse.cpp)
+        ST_BREAK,
+        ST_CONTINUE,
+        ST_COUNT
+    };
 
-    // В lilc: замени isTinyKey на это
-    inline bool isTinyKey(const char *w)
-    {
-        switch (w[0])
-        {
-        case 'a':
-            return w == SYM().ABS || w == SYM().ACOS || w == SYM().ASIN || w == SYM().ATAN || w == SYM().ATAN2;
-        case 'c':
-            return w == SYM().CEIL || w == SYM().COS || w == SYM().COSH;
-        case 'e':
-            return w == SYM().EXP;
-        case 'f':
-            return w == SYM().FAC || w == SYM().FLOOR;
-        case 'l':
-            return w == SYM().LN || w == SYM().LOG || w == SYM().LOG10;
-        case 'n':
-            return w == SYM().NCR || w == SYM().NPR;
-        case 'p':
-            return w == SYM().PIK || w == SYM().POW;
-        case 's':
-            return w == SYM().SIN || w == SYM().SINH || w == SYM().SQRT;
-        case 't':
-            return w == SYM().TAN || w == SYM().TANH;
-        default:
-            return false;
-        }
-    }
+    struct Decoded
+    {
+        StmtKind kind = ST_END;
+        int call = -1;                  // ST_CALL: procCalls
+        int fused = -1;                 // ST_FUSED
+        int loop = -1;                  // ST_STEP
+    };
+    std::vector<Decoded> decoded;
+
+    // Слитые операторы и условия; fusedCond: слово IF/WHILE -> fused
+    std::vector<Fused> fused;
+    std::vector<int> fusedCond;
+    FuseReport fuseReport;
+
+    // Счётные циклы; countedAt: слово WHILE -> countedLoops
+    std::vector<CountedLoop> countedLoops;
+    std::vector<int> countedAt;
+    long executed = 0; // операторов за последний interpretate()
+
+    // ===== Кэш выражений для tick() =====
+    // Ключ — (startWord, endWord). te_expr компилируется один раз: переменные
+    // привязаны к адресам VarEntry::value, элементы массивов читаются через
+    // замыкание. Пока эпоха контроллера не сменилась, привязка остаётся верной.
+    struct ArrayRef
+    {
+        lilc *owner = nullptr;
+        Id name = nullptr;
+        int word = -1; // первое вхождение имени в выражении
+        std::vector<double> *vec = nullptr;
+    };
+
+    struct ExprCacheEntry
+    {
+        bool built = false;
+        bool fallback = false; // tinyexpr не разобрал — старый путь через текст
+        bool constant = false; // выражение свернулось в число value
+        double value = 0.0;
+        std::string text;
+        te_expr *expr = nullptr;
+        std::vector<int> vars; // слово первого вхождения каждой переменной
+        std::vector<double *> varPtrs;
+        std::vector<ArrayRef> arrays;
+        std::vector<int> hoists; // инварианты циклов, подставленные именем
+        std::vector<int> cses;   // повторы подвыражений
+        std::vector<int> calls;  // вызовы процедур
+        // С вызовами переменные и массивы читаются через замыкания по
+        // текущему кадру, а te_expr не пересобирается: процедура меняет
+        // кадры и может вычислить это же выражение рекурсивно
+        bool live = false;
+        std::vector<ArrayRef> liveVars;
+        unsigned long epoch = 0;
+    };
+
+    std::unordered_map<long long, ExprCacheEntry> exprCache;
+    bool exprFault = false; // ошибка внутри te_eval (индекс массива)
+
+    // Инварианты циклов (LoopHoist от компилятора): в тексте выражения
+    // подвыражение заменяется именем-замыканием, которое считает его при
+    // первом обращении после входа в цикл. Циклы с вызовами процедур
+    // пропускаются: рекурсивный вход в тот же цикл перезаписал бы значение.
+    struct Hoist
+    {
+        lilc *owner = nullptr;
+        int whileWord = -1;
+        int from = -1, to = -1; // слова [from, to)
+        bool valid = false;
+        double value = 0.0;
+        std::string name;
+        ExprCacheEntry ce;
+    };
+    std::vector<Hoist> hoists;  // по возрастанию whileWord
+    std::vector<int> hoistAt;   // первое слово подвыражения -> hoists
+    std::vector<int> loopHoist; // слово WHILE -> первый из его hoists
+
+    // Повторы подвыражения в операторе (CseGroup): все вхождения — одно
+    // замыкание, которое считает значение раз за вычисление (evalSerial).
+    // Элемент a[...] читается через запомненный адрес — по нему же
+    // оператор a[i] = ... потом пишет, без второго поиска и проверки
+    struct CseValue
+    {
+        lilc *owner = nullptr;
+        int from = -1, to = -1; // первое вхождение
+        int elem = -1, indexFrom = -1, indexTo = -1;
+        unsigned long serial = 0; // вычисление, для которого верно value
+        double value = 0.0;
+        double *addr = nullptr; // элемент, прочитанный в этом вычислении
+        std::string name;
+        ExprCacheEntry ce;
+    };
+    std::vector<CseValue> cses;
+    std::vector<int> cseAt;    // слово начала вхождения -> cses
+    std::vector<int> cseEnd;   // и слово за его концом
+    std::vector<int> storeCse; // первое слово a[i] = ... -> cses
+    unsigned long evalSerial = 0;
+
+    // Байткод и ВМ (ENGINE_VM); компилируется при первом запуске
+    Bytecode bytecode;
+    VM vm;
+    bool bytecodeReady = false;
+    InlinePolicy inlining; // встраивание процедур для ENGINE_VM / ENGINE_AOT
+    int maxCallDepth = kMaxCallDepth;
+
+    // Вызов в выражении (tick) идёт по родному стеку: запас под te_eval и вывод
+    static constexpr size_t kNativeStackReserve = 256 * 1024;
+
+    // ENGINE_AOT: тот же байткод, переведённый в C++ и загруженный через dlopen
+    AotModule aot;
+    bool aotReady = false;
+
+    // JIT горячих циклов tick (jit.cpp); всё — по слову '}' цикла
+    bool jitEnabled = true;
+    int jitBypass = -1; // '}', на котором tick после deopt сам проверит условие
+    std::vector<int> loopHits;
+    std::vector<int> jitIndex; // -1 — ещё не компилировали, -2 — не компилируется
+#ifdef LILC_JIT
+    static constexpr int kJitThreshold = 64;
+
+    struct JitEntry
+    {
+        JitLoop loop;
+        int narrs = 0;                                 // массивы кадра функции цикла
+        std::vector<int> resumeWord;                   // по номеру выхода
+        std::vector<std::vector<DeepCode>> resumePath; // блоки между циклом и словом
+    };
+    std::vector<std::unique_ptr<JitEntry>> jitLoops;
+    std::vector<JitArray> jitArrays;
+#endif
 
     inline bool compareChar(const char *str1, const char *str2)
     {
@@ -122,27 +301,32 @@ private:
         return false;
     }
 
-    inline bool isNumber(const char *s)
+public:
+    enum Engine
     {
-        if (!s || !*s)
-            return false;
-        // быстрые односимвольные цифры
-        unsigned char c0 = (unsigned char)s[0];
-        if (!s[1])
-            return (c0 >= '0' && c0 <= '9');
-        // дальше — как было
-        for (const unsigned char *p = (const unsigned char *)s; *p; ++p)
-            if (*p < '0' || *p > '9')
-                return false;
-        return true;
-    }
+        ENGINE_TICK = 0, // пословный обход (tick)
+        ENGINE_VM = 1,   // байткод + регистровая ВМ
+        ENGINE_AOT = 2   // байткод → C++ → g++ → dlopen (без компилятора — ВМ)
+    };
 
-public:
     bool isHalted = false;
     std::function<void(const std::string &)> printOut;
+    Engine engine = ENGINE_TICK;
+
+    void setEngine(Engine e) { engine = e; }
+
+    // JIT горячих WHILE для ENGINE_TICK (есть только на x86-64 Linux/macOS)
+    void setJit(bool on) { jitEnabled = on; }
+
+    // Пороги встраивания процедур (ENGINE_VM / ENGINE_AOT); до loadProgram
+    void setInlining(const InlinePolicy &p) { inlining = p; }
+
+    // Наибольшая глубина вложенных вызовов процедур; до loadProgram
+    void setMaxCallDepth(int depth) { maxCallDepth = depth > 0 ? depth : kMaxCallDepth; }
 
     ~lilc()
     {
+        clearExprCache();
         // if (program)
         //     delete[] program;
         // for (auto word : words)
@@ -195,27 +379,84 @@ public:
         }
     }
 
-    void loadProgram(const char *prog)
+    void loadProgram(const char *prog) { loadProgram(prog, std::strlen(prog)); }
+
+    // Текст читается на месте и после загрузки не нужен
+    void loadProgram(const char *prog, size_t len) { loadSource(prog, len); }
+
+    // Кэш разобранных программ (.lcb) для loadFile; по умолчанию включён
+    void setCodeCache(bool on) { codeCache = on; }
+
+    // Программа из файла: отображается в память (mmap) и разбирается без
+    // копии. С кэшем неизменный исходник не разбирается вовсе: берётся
+    // lilc_<хеш>_<сборка>.v<версия>.lcb из lilcCacheDir(), иначе он
+    // создаётся. false — файл не открылся (причина в errno)
+    bool loadFile(const char *path)
     {
-        static bool syms_inited = false;
-        if (!syms_inited)
+        SourceFile src;
+        if (!src.open(path))
+            return false;
+        if (!codeCache)
         {
-            SYM().init(INTERN());
-            syms_inited = true;
+            loadSource(src.data(), src.size());
+            return true;
         }
-        S = &SYM();
-        if (program)
-            delete[] program;
-
-        words.clear();
+        const uint64_t hash = lilcHash(src.data(), src.size());
+        char key[64];
+        std::snprintf(key, sizeof(key), "/lilc_%016llx_%08x.v%d.lcb", (unsigned long long)hash,
+                      (unsigned)imageConfig(), LILC_LCB_VERSION);
+        const std::string dir = lilcCacheDir();
+        const std::string cached = dir + key;
+        if (loadCompiled(cached.c_str()) && sourceHash == hash && sourceSize == src.size())
+            return true;
+        Resolution res;
+        loadSource(src.data(), src.size(), &res);
+        sourceHash = hash;
+        sourceHashed = true;
+        if (!isHalted)
+        {
+#ifdef LILC_MMAP_SUPPORTED
+            ::mkdir(dir.c_str(), 0755);
+#endif
+            saveImage(cached.c_str(), res); // не записался — просто без кэша
+        }
+        return true;
+    }
 
-        program = new char[strlen(prog) + 1];
-        std::strcpy(program, prog);
+    // Разобранная программа (слова, токены, таблицы пар и процедур,
+    // разрешение имён) в .lcb. false — программа не загружена без ошибок
+    // или файл не записан
+    bool saveCompiled(const char *path) const
+    {
+        if (isHalted || words.empty())
+            return false;
+        Compiler resolver(words, tokens, *S);
+        Resolution res;
+        return resolver.resolve(res) && saveImage(path, res);
+    }
 
-        parseProgram();
-        currentWord = 0;
-        isHalted = false;
-        control = controller(); // создаём новый контроллер
+    // Программа из .lcb без лексера и разбора: различные имена интернируются
+    // по разу, остальное копируется таблицами. false — файла нет, он другой
+    // версии или повреждён (программа тогда не загружена)
+    bool loadCompiled(const char *path)
+    {
+        beginLoad();
+        if (!image.open(path))
+            return false;
+        LcbImage img;
+        Resolution res;
+        if (!img.open(image.data(), image.size()) || img.header().config != imageConfig() ||
+            !restoreCompiled(img, res))
+        {
+            words.clear();
+            image.close();
+            return false;
+        }
+        sourceHash = img.header().sourceHash;
+        sourceSize = img.header().sourceSize;
+        sourceHashed = true;
+        finishLoad(false, &res);
+        return true;
     }
 
     inline const char *getWord(int i) const
@@ -311,15 +552,12 @@ public:
         }
     }
 
-    int findPROC(const char *name)
-    {
-        for (int i = 1; i < (int)words.size(); ++i)
-        {
-            if (words[i] == name && words[i - 1] == S->PROC)
-                return i;
-        }
+    inline const SlotRef &ref(int word) const { return wordRef[word]; }
 
-        return -1;
+    const ProcInfo *findPROC(Id name) const
+    {
+        auto it = procs.find(name);
+        return it != procs.end() ? &it->second : nullptr;
     }
 
     const char *getExpression(int startWord, int endWord)
@@ -350,30 +588,13 @@ public:
             const char *word = words[i];
             size_t len = std::strlen(word);
 
-            // 1) Функции tiny_key
-            if (isTinyKey(word))
-            {
-                std::memcpy(ptr, word, len);
-                ptr += len;
-            }
-            // 2) Ключевые слова языка
-            else if (isExprToken(word))
+            // 1) Функции tinyexpr, операторы, разделители и числа — как есть
+            if (isExprLiteral(tokens.kind(i)))
             {
                 std::memcpy(ptr, word, len);
                 ptr += len;
             }
-            // 3) Однобуквенные операторы
-            else if (len == 1 && isOneCharOperator(word[0]))
-            {
-                *ptr++ = word[0];
-            }
-            // 4) Число: если начинается с цифры
-            else if (std::isdigit(static_cast<unsigned char>(word[0])))
-            {
-                std::memcpy(ptr, word, len);
-                ptr += len;
-            }
-            // 5) Обращение к массиву:  name [ index ]
+            // 2) Обращение к массиву:  name [ index ]
             else if (i + 3 <= endWord && words[i + 1] == S->LBRACKET && words[i + 3] == S->RBRACKET)
             {
                 const char *arrName = word;
@@ -381,34 +602,22 @@ public:
 
                 // Разбираем индекс: число или переменная
                 size_t idx = 0;
-                bool idxOk = false;
+                const TokenKind idxKind = tokens.kind(i + 2);
 
-                if (std::isdigit(static_cast<unsigned char>(idxTok[0])))
+                if (idxKind == TK_INT)
+                    idx = static_cast<size_t>(tokens.number(i + 2));
+                else if (idxKind == TK_REAL || idxKind == TK_BADNUM)
                 {
-                    // Убедимся, что весь токен — цифры, и аккуратно соберём индекс
-                    idxOk = true;
-                    for (const char *p = idxTok; *p; ++p)
-                    {
-                        if (!std::isdigit(static_cast<unsigned char>(*p)))
-                        {
-                            idxOk = false;
-                            break;
-                        }
-                        idx = idx * 10 + static_cast<size_t>(*p - '0');
-                    }
-                    if (!idxOk)
-                    {
-                        std::string er = "Invalid array index token '" + std::string(idxTok) + "'";
-                        printError(er.c_str());
-                        halt();
-                        return nullptr;
-                    }
+                    std::string er = "Invalid array index token '" + std::string(idxTok) + "'";
+                    printError(er.c_str());
+                    halt();
+                    return nullptr;
                 }
                 else
                 {
                     // Индекс — имя переменной
                     double idxVal = 0.0;
-                    if (!control.getVar(idxTok, idxVal))
+                    if (!control.getVar(ref(i + 2), idxVal))
                     {
                         std::string er = "Variable '" + std::string(idxTok) + "' not found";
                         printError(er.c_str());
@@ -422,11 +631,10 @@ public:
                         return nullptr;
                     }
                     idx = static_cast<size_t>(idxVal);
-                    idxOk = true;
                 }
 
                 double elemValue = 0.0;
-                if (!control.getArrayElem(arrName, idx, elemValue))
+                if (!control.getArrayElem(ref(i), idx, elemValue))
                 {
                     std::string er = "Array element '" + std::string(arrName) + "[" + std::to_string(idx) + "]' not found";
                     printError(er.c_str());
@@ -443,11 +651,11 @@ public:
                 // Пропускаем [, index, ]
                 i += 3;
             }
-            // 6) Остальное — переменная
+            // 3) Остальное — переменная
             else
             {
                 double value;
-                if (control.getVar(word, value))
+                if (control.getVar(ref(i), value))
                 {
                     char valueStr[64];
                     std::snprintf(valueStr, sizeof(valueStr), "%g", value);
@@ -470,72 +678,51 @@ public:
         return expressionBuffer;
     }
 
-    inline int foundCloseBrace()
+    void halt()
     {
-        const char *const *W = words.data();
-        const int n = (int)words.size();
-        int level = 0;
-        for (int i = currentWord + 1; i < n; ++i)
-        {
-            const char *w = W[i];
-            if (w == SYM().LBRACE)
-            {
-                ++level;
-            }
-            else if (w == SYM().RBRACE)
-            {
-                if (--level == 0)
-                    return i;
-            }
-        }
-        printError("Closing } not found\n");
-        halt();
-        return -1;
+        isHalted = true;
     }
 
-    inline int foundCloseParenthes()
+    // Снять со стека вложенности блоки внутри тела цикла с '{' в body;
+    // false — BREAK/CONTINUE не внутри WHILE
+    bool unwindToLoop(int body)
     {
-        const char *const *W = words.data();
-        const int n = (int)words.size();
-        int level = 0;
-        for (int i = currentWord + 1; i < n; ++i)
+        if (body < 0)
         {
-            const char *w = W[i];
-            if (w == SYM().LP)
-            {
-                ++level;
-            }
-            else if (w == SYM().RP)
-            {
-                if (--level == 0)
-                    return i;
-            }
+            printError((std::string(words[currentWord]) + " outside of WHILE").c_str());
+            halt();
+            return false;
         }
-        printError("Closing ) not found\n");
-        halt();
-        return -1;
-    }
-
-    void halt()
-    {
-        isHalted = true;
+        while (deepStack.back().type != DeepType::WHILE || deepStack.back().INword != body)
+            deepStack.pop_back();
+        return true;
     }
 
+    // К '}' цикла: там проверяется условие
     void _opCONTINUE()
     {
-        int closeBrace = foundNextWord(S->RBRACE);
-        currentWord = closeBrace;
+        const int body = matchWord[currentWord];
+        if (unwindToLoop(body))
+            currentWord = matchWord[body];
     }
 
     void _opBREAK()
     {
-        int closeBrace = foundNextWord(S->RBRACE);
-        currentWord = closeBrace + 1;
-        control.outLevel();
+        const int body = matchWord[currentWord];
+        if (!unwindToLoop(body))
+            return;
+        deepStack.pop_back();
+        currentWord = matchWord[body] + 1;
     }
 
-    void _opCreateVar(bool isConst = false)
+    void _opCreateVar()
     {
+        if (words[currentWord] != S->VAR) // CONST без VAR
+        {
+            printError("VAR expected after CONST");
+            halt();
+            return;
+        }
         const char *islineEnd = getWordUnchecked(2);
         if (islineEnd == S->SEMI) // VAR x;
         {
@@ -545,10 +732,7 @@ public:
                 printError("VAR name not found\n", 1);
                 halt();
             }
-            if (!control.setVar(varName, 0))
-            {
-                control.addVar(varName, 0, isConst); // создаём новую переменную
-            }
+            control.addVar(ref(currentWord + 1), 0); // ячейка назначена при загрузке
             currentWord += 2;
             return;
         }
@@ -568,7 +752,13 @@ public:
             {
                 if (lineEnd == S->SEMI)
                 {
-                    control.addArray(varName, std::stoi(getWordUnchecked(3)));
+                    if (!tokens.isNumber(currentWord + 3))
+                    {
+                        printError("VAR array syntax: VAR name[size];", 2);
+                        halt();
+                        return;
+                    }
+                    control.addArray(ref(currentWord + 1), (int)tokens.number(currentWord + 3));
                     currentWord += 5;
                     return;
                 }
@@ -598,19 +788,65 @@ public:
         {                                     // var x = 5 + 5 + 5;
             double value = _fnEval(currentWord + 3, lineEnd3 - 1);
 
-            if (!control.setVar(varName, value))
-            {
-                control.addVar(varName, value, isConst); // создаём новую переменную
-            }
+            control.addVar(ref(currentWord + 1), value);
             currentWord = lineEnd3;
             return;
         }
-        double value = std::atof(valueStr);
-        if (!control.setVar(varName, value))
+        // VAR x = 5;  VAR x = y;  — одно слово: число уже разобрано при загрузке
+        double value = tokens.isNumber(currentWord + 3) ? tokens.number(currentWord + 3)
+                                                        : _fnEval(currentWord + 3, currentWord + 3);
+        control.addVar(ref(currentWord + 1), value);
+        currentWord += 4;
+    }
+
+    void printText(const char *text, bool ln)
+    {
+        if (ln)
         {
-            control.addVar(varName, value, isConst); // создаём новую переменную
+            if (printOut)
+            {
+                std::string t = std::string(text) + "\n";
+                printOut(t);
+            }
+            std::cout << text << std::endl;
         }
-        currentWord += 4;
+        else
+        {
+            if (printOut)
+            {
+                printOut(text);
+            }
+            std::cout << text;
+        }
+    }
+
+    void printValue(double value, bool ln)
+    {
+        if (ln)
+        {
+            if (printOut)
+            {
+                std::string t = std::to_string(value) + "\n";
+                printOut(t);
+            }
+            std::cout << std::setprecision(15) << std::defaultfloat << value << std::endl;
+        }
+        else
+        {
+            if (printOut)
+            {
+                printOut(std::to_string(value));
+            }
+            std::cout << std::setprecision(15) << std::defaultfloat << value;
+        }
+    }
+
+    static bool isBuiltinConst(const char *w)
+    {
+        for (const Builtin &b : builtins())
+            if (b.arity == 0 && std::strcmp(b.name, w) == 0)
+                return true;
+        return false;
     }
 
     void _opPrint(bool ln = 0)
@@ -632,23 +868,7 @@ public:
                 halt();
             }
 
-            if (ln)
-            {
-                if (printOut)
-                {
-                    std::string t = std::string(text) + "\n";
-                    printOut(t);
-                }
-                std::cout << text << std::endl;
-            }
-            else
-            {
-                if (printOut)
-                {
-                    printOut(text);
-                }
-                std::cout << text;
-            }
+            printText(text, ln);
             currentWord += 4;
             return;
         }
@@ -657,6 +877,18 @@ public:
 
         bool isArray = (getWordUnchecked(2) == S->LBRACKET) && (getWordUnchecked(4) == S->RBRACKET);
 
+        // Не имя и не элемент — печатаем выражение до ';'
+        const int endI = foundNextWord(S->SEMI);
+        if (endI > currentWord + 1 && endI != currentWord + (isArray ? 5 : 2))
+        {
+            value = _fnEval(currentWord + 1, endI - 1);
+            if (isHalted)
+                return;
+            printValue(value, ln);
+            currentWord = endI + 1;
+            return;
+        }
+
         const char *varName = getWordUnchecked(1);
         const char *lineEnd = getWordUnchecked(2);
         if (!varName)
@@ -671,50 +903,52 @@ public:
         // }
         if (isArray == false)
         {
-            if (!control.getVar(varName, value))
+            // число или встроенная константа (pi) — как выражение
+            const bool literal = tokens.isNumber(currentWord + 1);
+            if (literal || !control.getVar(ref(currentWord + 1), value))
             {
-
-                printError("PRINT VAR variable name not found");
-                halt();
+                if (!literal && !isBuiltinConst(words[currentWord + 1]))
+                {
+                    std::string er = "Variable '" + std::string(words[currentWord + 1]) + "' not found";
+                    printError(er.c_str(), 1);
+                    halt();
+                    return;
+                }
+                value = _fnEval(currentWord + 1, currentWord + 1);
+                if (isHalted)
+                    return;
             }
         }
         else
         {
 
             double index = -1;
-            if (isNumber(getWordUnchecked(3)))
+            if (tokens.kind(currentWord + 3) == TK_INT)
             {
-                index = std::stoi(getWordUnchecked(3));
+                index = tokens.number(currentWord + 3);
             }
             else
             {
-                control.getVar(getWordUnchecked(3), index);
+                control.getVar(ref(currentWord + 3), index);
             }
 
-            if (!control.getArrayElem(varName, int(index), value))
+            // сообщения — как при чтении элемента в выражении
+            if (index < 0)
             {
-                printError("PRINT VAR array name not found");
+                printError("Array index must be >= 0");
                 halt();
+                return;
             }
-        }
-
-        if (ln)
-        {
-            if (printOut)
-            {
-                std::string t = std::to_string(value) + "\n";
-                printOut(t);
-            }
-            std::cout << std::setprecision(15) << std::defaultfloat << value << std::endl;
-        }
-        else
-        {
-            if (printOut)
+            if (!control.getArrayElem(ref(currentWord + 1), int(index), value))
             {
-                printOut(std::to_string(value));
+                std::string er = "Array element '" + std::string(words[currentWord + 1]) + "[" + std::to_string((size_t)index) + "]' not found";
+                printError(er.c_str());
+                halt();
+                return;
             }
-            std::cout << std::setprecision(15) << std::defaultfloat << value;
         }
+
+        printValue(value, ln);
         if (!isArray)
         {
             currentWord += 3;
@@ -725,82 +959,432 @@ public:
         }
     }
 
-    double _fnEval(int startWord, int endWord)
+    void clearExprCache()
     {
-        const char *expr = getExpression(startWord, endWord);
-        if (!expr)
+        for (auto &kv : exprCache)
         {
-            halt();
-            return 0;
+            te_free(kv.second.expr);
         }
+        exprCache.clear();
+        for (Hoist &h : hoists)
+            te_free(h.ce.expr);
+        hoists.clear();
+        for (CseValue &c : cses)
+            te_free(c.ce.expr);
+        cses.clear();
+    }
 
-        // Поиск оператора
-        const char *ops[] = {"!=", "==", ">=", "<=", ">", "<"};
-        const char *foundOp = nullptr;
-        int foundOpLen = 0;
-        int opIndex = -1;
-        const char *p = expr; // <<< Вынесли p сюда!
-
-        for (; *p; ++p)
+    static double cseClosure(void *ctx)
+    {
+        CseValue *c = static_cast<CseValue *>(ctx);
+        lilc *self = c->owner;
+        if (self->exprFault)
+            return 0;
+        if (c->serial != self->evalSerial)
         {
-            for (int i = 0; i < 6; ++i)
-            {
-                int len = std::strlen(ops[i]);
-                if (std::strncmp(p, ops[i], len) == 0)
-                {
-                    foundOp = ops[i];
-                    foundOpLen = len;
-                    opIndex = i; // <— запомнили какой именно оператор нашли
-                    goto operator_found;
-                }
-            }
+            c->serial = self->evalSerial;
+            c->addr = c->elem >= 0 ? self->cseElem(*c) : nullptr;
+            c->value = c->elem >= 0 ? (c->addr ? *c->addr : 0.0)
+                                    : self->evalEntry(c->ce, c->from, c->to - 1, true, false);
         }
+        return c->value;
+    }
 
-    operator_found:
+    double *cseElem(CseValue &c)
+    {
+        const double index = evalEntry(c.ce, c.indexFrom, c.indexTo - 1, true, false);
+        if (exprFault || isHalted)
+            return nullptr;
+        std::vector<double> *v = control.getArrayPtr(ref(c.elem));
+        if (!v)
+        {
+            std::string er = "Array '" + std::string(words[c.elem]) + "' not found";
+            printError(er.c_str());
+            halt();
+            exprFault = true;
+            return nullptr;
+        }
+        return elemPtr(words[c.elem], *v, index);
+    }
 
-        if (foundOp)
+    static double hoistClosure(void *ctx)
+    {
+        Hoist *h = static_cast<Hoist *>(ctx);
+        if (!h->valid)
         {
-            int pos = int(p - expr);
-            int exprLen = std::strlen(expr);
+            h->value = h->owner->evalEntry(h->ce, h->from, h->to - 1, false, false);
+            h->valid = true;
+        }
+        return h->value;
+    }
 
-            // Левое выражение
-            char *exprLeft = new char[pos + 1];
-            std::strncpy(exprLeft, expr, pos);
-            exprLeft[pos] = '\0';
+    // Вход в цикл: его инварианты посчитаются заново при первом обращении
+    void resetHoists(int whileWord)
+    {
+        for (int i = loopHoist[whileWord]; i >= 0 && i < (int)hoists.size() && hoists[i].whileWord == whileWord; ++i)
+            hoists[i].valid = false;
+    }
+
+    static double liveVarClosure(void *ctx)
+    {
+        ArrayRef *r = static_cast<ArrayRef *>(ctx);
+        const double *p = r->owner->control.getVarPtr(r->owner->ref(r->word));
+        return p ? *p : 0;
+    }
+
+    static double liveElemClosure(void *ctx, double index)
+    {
+        ArrayRef *r = static_cast<ArrayRef *>(ctx);
+        lilc *self = r->owner;
+        if (self->exprFault)
+            return 0;
+        std::vector<double> *v = self->control.getArrayPtr(self->ref(r->word));
+        const double *p = v ? self->elemPtr(r->name, *v, index) : nullptr;
+        return p ? *p : 0;
+    }
+
+    // Вызов процедуры изнутри te_eval: по аргументу на параметр-значение
+    template <typename... Args>
+    static double procClosure(void *ctx, Args... args)
+    {
+        ProcCall *c = static_cast<ProcCall *>(ctx);
+        const double values[] = {0.0, args...};
+        return c->owner->callInExpr(*c, values + 1);
+    }
+
+    static const void *procThunk(size_t values)
+    {
+        static const void *const thunks[kMaxProcParams + 1] = {
+            reinterpret_cast<const void *>(&lilc::procClosure<>),
+            reinterpret_cast<const void *>(&lilc::procClosure<double>),
+            reinterpret_cast<const void *>(&lilc::procClosure<double, double>),
+            reinterpret_cast<const void *>(&lilc::procClosure<double, double, double>),
+            reinterpret_cast<const void *>(&lilc::procClosure<double, double, double, double>),
+            reinterpret_cast<const void *>(&lilc::procClosure<double, double, double, double, double>),
+            reinterpret_cast<const void *>(&lilc::procClosure<double, double, double, double, double, double>),
+            reinterpret_cast<const void *>(&lilc::procClosure<double, double, double, double, double, double, double>)};
+        return thunks[values];
+    }
+
+    // Процедура выполняется до своего выхода прямо здесь, затем выражение
+    // продолжается с того же слова
+    double callInExpr(const ProcCall &c, const double *args)
+    {
+        if (exprFault || isHalted)
+            return 0;
+        if (nativeStackShort(c.word))
+            return 0;
+        const int back = currentWord;
+        const size_t depth = deepStack.size();
+        std::vector<double> *arrays[kMaxProcParams];
+        argArrays(c, arrays);
+        enterProc(c, args, arrays, -1);
+        while (!isHalted && deepStack.size() > depth)
+            tick();
+        currentWord = back;
+        exprFault = isHalted;
+        return isHalted ? 0 : retValue;
+    }
+
+    // Хватит ли родного стека ещё на один вызов; нет — ошибка вместо падения
+    bool nativeStackShort(int word)
+    {
+        const char here = 0;
+        static thread_local const char *stackFloor = nullptr; // граница — своя у каждого потока
+        if (!stackFloor)
+        {
+            const char *low = nativeStackLow();
+            stackFloor = low ? low + kNativeStackReserve : &here - 4 * kNativeStackReserve;
+        }
+        if (&here >= stackFloor)
+            return false;
+        currentWord = word;
+        printError(("Call stack overflow: native stack exhausted at " + std::to_string(control.depth()) + " nested calls").c_str());
+        halt();
+        exprFault = true;
+        return true;
+    }
+
+    static double arrayElemClosure(void *ctx, double index)
+    {
+        ArrayRef *ref = static_cast<ArrayRef *>(ctx);
+        lilc *self = ref->owner;
+        if (self->exprFault)
+            return 0;
+        const double *p = self->elemPtr(ref->name, *ref->vec, index);
+        return p ? *p : 0;
+    }
+
+    // Адрес элемента для чтения внутри te_eval; ошибка — exprFault
+    double *elemPtr(Id name, std::vector<double> &v, double index)
+    {
+        if (index < 0)
+        {
+            printError("Array index must be >= 0");
+            exprFault = true;
+            return nullptr;
+        }
+        const size_t idx = static_cast<size_t>(index);
+        if (idx >= v.size())
+        {
+            std::cerr << "Index out of bounds for array '" << name << "': "
+                      << idx << " >= " << v.size() << "\n";
+            std::string er = "Array element '" + std::string(name) + "[" + std::to_string(idx) + "]' not found";
+            printError(er.c_str());
+            exprFault = true;
+            return nullptr;
+        }
+        return &v[idx];
+    }
+
+    // Текст выражения для tinyexpr: имена вместо значений, a[i] → a(i).
+    // CONST с известным значением пишется числом — tinyexpr свернёт его,
+    // инвариант цикла и повтор в операторе — именем замыкания
+    bool exprText(int from, int to, ExprCacheEntry &ce, std::string &out, bool useHoists, bool useCse)
+    {
+        for (int i = from; i <= to; ++i)
+        {
+            const char *w = words[i];
+            const int c = useCse ? cseAt[i] : -1;
+            const int h = useHoists ? hoistAt[i] : -1;
+            if (c >= 0 && cseEnd[i] - 1 <= to)
+            {
+                if (std::find(ce.cses.begin(), ce.cses.end(), c) == ce.cses.end())
+                    ce.cses.push_back(c);
+                out += cses[c].name;
+                i = cseEnd[i] - 1;
+            }
+            else if (h >= 0 && hoists[h].to - 1 <= to)
+            {
+                if (std::find(ce.hoists.begin(), ce.hoists.end(), h) == ce.hoists.end())
+                    ce.hoists.push_back(h);
+                out += hoists[h].name;
+                i = hoists[h].to - 1;
+            }
+            else if (callAt[i] >= 0 && i < to && words[i + 1] == S->LP)
+            {
+                // вызов процедуры — замыкание от значений аргументов
+                const ProcCall &pc = procCalls[callAt[i]];
+                if (std::find(ce.calls.begin(), ce.calls.end(), callAt[i]) == ce.calls.end())
+                    ce.calls.push_back(callAt[i]);
+                out += pc.name;
+                out += '(';
+                for (size_t k = 0; k < pc.from.size(); ++k)
+                {
+                    if (k)
+                        out += ',';
+                    if (!exprText(pc.from[k], pc.to[k] - 1, ce, out, false, false))
+                        return false;
+                }
+                out += ')';
+                i = pc.close;
+            }
+            else if (i < to && words[i + 1] == S->LP && findPROC(w))
+            {
+                badCall(i);
+                return false;
+            }
+            else if (ref(i).known && std::isfinite(ref(i).value))
+            {
+                char num[40];
+                std::snprintf(num, sizeof(num), "(%.17g)", ref(i).value);
+                out += num;
+            }
+            else if (w == S->LBRACKET)
+                out += '(';
+            else if (w == S->RBRACKET)
+                out += ')';
+            else if (isExprLiteral(tokens.kind(i)))
+                out += w;
+            else
+            {
+                // tinyexpr понимает только [a-z][a-z0-9_]*
+                if (!std::isalpha(static_cast<unsigned char>(w[0])))
+                    return false;
+                for (const char *p = w; *p; ++p)
+                    if (!std::isalnum(static_cast<unsigned char>(*p)) && *p != '_')
+                        return false;
 
-            // Правое выражение
-            const char *rightStart = p + foundOpLen;
-            int rightLen = exprLen - pos - foundOpLen;
-            char *exprRight = new char[rightLen + 1];
-            std::strncpy(exprRight, rightStart, rightLen);
-            exprRight[rightLen] = '\0';
+                if (i < to && words[i + 1] == S->LBRACKET)
+                {
+                    bool seen = false;
+                    for (const ArrayRef &a : ce.arrays)
+                        seen = seen || a.name == w;
+                    if (!seen)
+                    {
+                        ArrayRef a;
+                        a.owner = this;
+                        a.name = w;
+                        a.word = i;
+                        ce.arrays.push_back(a);
+                    }
+                }
+                else
+                {
+                    bool seen = false;
+                    for (int v : ce.vars)
+                        seen = seen || words[v] == w;
+                    if (!seen)
+                    {
+                        ce.vars.push_back(i);
+                        ce.varPtrs.push_back(nullptr);
+                    }
+                }
+                out += w;
+            }
+            out += ' ';
+        }
+        return true;
+    }
 
-            // Вычисляем
-            double leftVal = te_interp(exprLeft, 0);
-            double rightVal = te_interp(exprRight, 0);
+    void buildExprCache(ExprCacheEntry &ce, int startWord, int endWord, bool useHoists, bool useCse)
+    {
+        ce.built = true;
+        if (!exprText(startWord, endWord, ce, ce.text, useHoists, useCse))
+        {
+            ce.fallback = true;
+            return;
+        }
+        ce.live = !ce.calls.empty();
+        for (size_t i = 0; ce.live && i < ce.vars.size(); ++i)
+        {
+            ArrayRef r;
+            r.owner = this;
+            r.name = words[ce.vars[i]];
+            r.word = ce.vars[i];
+            ce.liveVars.push_back(r);
+        }
+        if (ce.vars.empty() && ce.arrays.empty() && ce.hoists.empty() && ce.cses.empty() && ce.calls.empty())
+        {
+            // ни одной переменной: значение считается один раз
+            te_expr *e = te_compile(ce.text.c_str(), nullptr, 0, nullptr);
+            if (e)
+            {
+                ce.constant = true;
+                ce.value = te_eval(e);
+                te_free(e);
+            }
+        }
+    }
 
-            delete[] exprLeft;
-            delete[] exprRight;
+    // Привязка переменных к текущим адресам; te_expr пересобирается,
+    // только если какое-то имя теперь указывает на другую ячейку
+    bool bindExpr(ExprCacheEntry &ce)
+    {
+        bool moved = (ce.expr == nullptr);
+        for (size_t i = 0; i < ce.vars.size(); ++i)
+        {
+            double *p = control.getVarPtr(ref(ce.vars[i]));
+            if (!p)
+            {
+                std::string er = "Variable '" + std::string(words[ce.vars[i]]) + "' not found";
+                printError(er.c_str());
+                halt();
+                return false;
+            }
+            if (p != ce.varPtrs[i])
+            {
+                ce.varPtrs[i] = p;
+                moved = true;
+            }
+        }
+        for (ArrayRef &a : ce.arrays)
+        {
+            a.vec = control.getArrayPtr(ref(a.word));
+            if (!a.vec)
+            {
+                std::string er = "Array '" + std::string(a.name) + "' not found";
+                printError(er.c_str());
+                halt();
+                return false;
+            }
+        }
 
-            // Сравнение
-            switch (opIndex)
+        if (moved)
+        {
+            std::vector<te_variable> vars;
+            vars.reserve(ce.vars.size() + ce.arrays.size() + ce.hoists.size() + ce.cses.size() + ce.calls.size());
+            for (size_t i = 0; i < ce.vars.size(); ++i)
+            {
+                if (ce.live)
+                    vars.push_back({words[ce.vars[i]], reinterpret_cast<const void *>(&lilc::liveVarClosure), TE_CLOSURE0, &ce.liveVars[i]});
+                else
+                    vars.push_back({words[ce.vars[i]], ce.varPtrs[i], TE_VARIABLE, nullptr});
+            }
+            for (ArrayRef &a : ce.arrays)
+                vars.push_back({a.name, ce.live ? reinterpret_cast<const void *>(&lilc::liveElemClosure)
+                                                : reinterpret_cast<const void *>(&lilc::arrayElemClosure),
+                                TE_CLOSURE1, &a});
+            for (int c : ce.calls)
+                vars.push_back({procCalls[c].name.c_str(), procThunk(procCalls[c].from.size()),
+                                TE_CLOSURE0 + (int)procCalls[c].from.size(), &procCalls[c]});
+            for (int h : ce.hoists)
+                vars.push_back({hoists[h].name.c_str(), reinterpret_cast<const void *>(&lilc::hoistClosure), TE_CLOSURE0, &hoists[h]});
+            for (int c : ce.cses)
+                vars.push_back({cses[c].name.c_str(), reinterpret_cast<const void *>(&lilc::cseClosure), TE_CLOSURE0, &cses[c]});
+
+            te_free(ce.expr);
+            ce.expr = te_compile(ce.text.c_str(), vars.data(), (int)vars.size(), nullptr);
+            if (!ce.expr)
             {
-            case 1:
-                return leftVal == rightVal; // "=="
-            case 0:
-                return leftVal != rightVal; // "!="
-            case 4:
-                return leftVal > rightVal; // ">"
-            case 5:
-                return leftVal < rightVal; // "<"
-            case 2:
-                return leftVal >= rightVal; // ">="
-            case 3:
-                return leftVal <= rightVal; // "<="
+                ce.fallback = true;
+                return true;
             }
         }
+        ce.epoch = control.epoch();
+        return true;
+    }
+
+    double _fnEval(int startWord, int endWord)
+    {
+        if (startWord < 0 || endWord >= static_cast<int>(words.size()) || startWord > endWord)
+            return _fnEvalText(startWord, endWord);
+
+        ExprCacheEntry &ce = exprCache[(static_cast<long long>(startWord) << 32) | static_cast<unsigned>(endWord)];
+        exprFault = false;
+        ++evalSerial;
+        return evalEntry(ce, startWord, endWord, true, true);
+    }
+
+    // Вычисление по записи кэша; замыкания вызывают его и изнутри te_eval
+    double evalEntry(ExprCacheEntry &ce, int startWord, int endWord, bool useHoists, bool useCse)
+    {
+        if (!ce.built)
+            buildExprCache(ce, startWord, endWord, useHoists, useCse);
+        if (isHalted)
+            return 0;
+        if (ce.constant)
+            return ce.value;
+        if (!ce.fallback && (ce.expr == nullptr || (!ce.live && ce.epoch != control.epoch())) && !bindExpr(ce))
+            return 0;
+        if (ce.fallback)
+            return _fnEvalText(startWord, endWord);
+
+        // вложенный вызов не должен стереть ошибку внешнего te_eval
+        const bool outerFault = exprFault;
+        exprFault = false;
+        const double value = te_eval(ce.expr);
+        const bool fault = exprFault;
+        exprFault = outerFault || fault;
+        if (fault)
+        {
+            halt();
+            return 0;
+        }
+        return value;
+    }
+
+    // Старый путь: подстановка значений в текст и te_interp
+    double _fnEvalText(int startWord, int endWord)
+    {
+        const char *expr = getExpression(startWord, endWord);
+        if (!expr)
+        {
+            halt();
+            return 0;
+        }
 
-        // Если оператор не найден
+        // Сравнения и && || ! tinyexpr разбирает сам
         return te_interp(expr, 0);
     }
 
@@ -827,9 +1411,8 @@ public:
         // ---------- Ветка: присваивание элементу массива: name [ index ] = expr ;
         if (t1[0] == '[' && t1[1] == '\0')
         {
-            const char *idxTok = getWordUnchecked(2);
-            const char *t3 = getWordUnchecked(3); // ожидаем ']'
-            if (!idxTok || !t3 || !(t3[0] == ']' && t3[1] == '\0'))
+            const int close = matchWord[currentWord + 1]; // парная ']'
+            if (close <= currentWord + 2)
             {
                 printError("SET array syntax error: missing ']' or index\n");
                 halt();
@@ -846,22 +1429,34 @@ public:
                 return;
             }
 
-            // Индекс: число или имя переменной
+            // Индекс: число, имя переменной или выражение
             int idx;
-            if (isNumber(idxTok))
+            if (close != currentWord + 3)
             {
-                idx = (int)std::strtol(idxTok, 0, 10);
+                idx = (int)_fnEval(currentWord + 2, close - 1);
+                if (isHalted)
+                    return;
+            }
+            else if (tokens.kind(currentWord + 2) == TK_INT)
+            {
+                idx = (int)tokens.number(currentWord + 2);
             }
             else
             {
                 double tmp = 0.0;
-                control.getVar(idxTok, tmp); // внутри есть обработка ошибок
+                control.getVar(ref(currentWord + 2), tmp); // внутри есть обработка ошибок
                 idx = (int)tmp;
             }
 
             // Вычисляем выражение справа от '='
             const double value = _fnEval(eqI + 1, endI - 1);
-            control.setArrayElem(name, idx, value);
+            const int c = storeCse[currentWord];
+            if (c >= 0 && cses[c].serial == evalSerial && cses[c].addr && !isHalted)
+                *cses[c].addr = value; // элемент уже найден и проверен при чтении справа
+            else if (ref(currentWord).inRange)
+                (*control.getArrayPtr(ref(currentWord)))[idx] = value;
+            else
+                control.setArrayElem(ref(currentWord), idx, value);
 
             currentWord = endI; // встанем на ';' — tick() сам перепрыгнет
             return;
@@ -875,118 +1470,6 @@ public:
             return;
         }
 
-        // Быстрый путь: ровно 4 токена: name = value ;
-        {
-            const char *t3 = getWordUnchecked(3);
-            if (t3 && t3[0] == ';' && t3[1] == '\0')
-            {
-                const char *rhs = getWordUnchecked(2);
-                if (!rhs)
-                {
-                    printError("SET value not found\n");
-                    halt();
-                    return;
-                }
-
-                // x = число;
-                if (isNumber(rhs))
-                {
-                    const double v = std::strtod(rhs, 0);
-                    if (!control.setVar(name, v))
-                    {
-                        if (control.isVarConstant(name))
-                        {
-                            printWarning("Attempt to assign a value to a constant", 1);
-                        }
-                        else
-                        {
-                            printError("SET name not found", 1);
-                        }
-                    }
-                    currentWord += 4; // name '=' value ';'
-                    return;
-                }
-
-                // x = y;  (переменная справа)
-                // Это быстрее, чем вызывать общий вычислитель.
-                double tmp = 0.0;
-                control.getVar(rhs, tmp); // если переменной нет — ожидается внутренняя ошибка
-                if (!control.setVar(name, tmp))
-                {
-                    if (control.isVarConstant(name))
-                    {
-                        printWarning("Attempt to assign a value to a constant", 1);
-                    }
-                    else
-                    {
-                        printError("SET name not found", 1);
-                    }
-                }
-                currentWord += 4;
-                return;
-            }
-        }
-
-        // ---------- Супер-быстрые шаблоны без вычислителя ----------
-        // Паттерны: name = name + 1;  |  name = 1 + name;  |  name = name - 1;
-        {
-            const char *a = getWordUnchecked(2);
-            const char *op = getWordUnchecked(3);
-            const char *b = getWordUnchecked(4);
-            const char *t5 = getWordUnchecked(5);
-
-            auto isOne = [](const char *tok) noexcept
-            {
-                // дешёвая проверка числа "1" (в языке числа — только цифры)
-                return tok && tok[0] == '1' && tok[1] == '\0';
-            };
-
-            if (t5 == S->SEMI && a && op && b)
-            {
-                // name = name + 1;  или  name = 1 + name;
-                if (op == S->PLUS && ((a == name && isOne(b)) || (isOne(a) && b == name)))
-                {
-                    double cur = 0.0;
-                    if (!control.getVar(name, cur) || !control.setVar(name, cur + 1.0))
-                    {
-                        if (control.isVarConstant(name))
-                        {
-                            printWarning("Attempt to assign a value to a constant", 1);
-                        }
-                        else
-                        {
-                            printError("SET name not found", 1);
-                        }
-                        halt();
-                        return;
-                    }
-                    currentWord += 6; // name '=' a '+' b ';'
-                    return;
-                }
-
-                // name = name - 1;
-                if (op == S->MINUS && a == name && isOne(b))
-                {
-                    double cur = 0.0;
-                    if (!control.getVar(name, cur) || !control.setVar(name, cur - 1.0))
-                    {
-                        if (control.isVarConstant(name))
-                        {
-                            printWarning("Attempt to assign a value to a constant", 1);
-                        }
-                        else
-                        {
-                            printError("SET name not found", 1);
-                        }
-                        halt();
-                        return;
-                    }
-                    currentWord += 6; // name '=' name '-' '1' ';'
-                    return;
-                }
-            }
-        }
-
         // ---------- Общий случай: name = <выражение...> ;
         const int endI = foundNextWord(S->SEMI);
         if (endI < 0)
@@ -997,8 +1480,8 @@ public:
         }
 
         const double result = _fnEval(currentWord + 2, endI - 1);
-        if (!control.setVar(name, result))
-            if (control.isVarConstant(name))
+        if (!control.setVar(ref(currentWord), result))
+            if (control.isVarConstant(ref(currentWord)))
             {
                 printWarning("Attempt to assign a value to a constant", 1);
             }
@@ -1010,21 +1493,174 @@ public:
         currentWord = endI; // встанем на ';' — tick() сам перепрыгнет
     }
 
-    void _opIF()
+    // Значение операнда слитого оператора. false — особый случай (индекс вне
+    // массива и т.п.): оператор выполнит общий путь с его сообщениями
+    inline bool fusedLoad(const FuseOperand &o, double &v)
+    {
+        switch (o.kind)
+        {
+        case FO_CONST:
+            v = o.value;
+            return true;
+        case FO_VAR:
+            return control.getVar(ref(o.word), v);
+        case FO_ELEM:
+        {
+            double i = o.value;
+            if (o.index >= 0 && !control.getVar(ref(o.index), i))
+                return false;
+            const std::vector<double> *a = control.getArrayPtr(ref(o.word));
+            if (!o.inRange && (!a || !(i >= 0.0) || !(i < (double)a->size())))
+                return false;
+            v = (*a)[(size_t)i];
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    inline bool fusedValue(const Fused &f, double &v)
     {
-        int closeParenthes = foundCloseParenthes();
-        int openBrace = foundNextWord(S->LBRACE);
-        int closeBrace = foundCloseBrace();
-        const char *openParenthes = getWordUnchecked(1);
+        double x, y = 0.0;
+        if (!fusedLoad(f.a, x) || (f.op != FOP_NONE && !fusedLoad(f.b, y)))
+            return false;
+        v = fuseApply(f.op, x, y);
+        return true;
+    }
 
-        // std::cout << "close Parenthes " << closeParenthes << " openBrace " << openBrace << " closeBrace " << closeBrace << "\n";
+    inline bool fusedCondValue(int cond, double &v)
+    {
+        return cond >= 0 && fusedValue(fused[cond], v);
+    }
 
-        if (openParenthes != S->LP)
+    // Слитое присваивание; false — особый случай, его выполнит общий путь
+    inline bool fusedStore(const Fused &f)
+    {
+        double v;
+        if (!fusedValue(f, v))
+            return false;
+        if (f.dst.kind == FO_VAR)
         {
-            printError("IF \"(\" not found", 1);
-            halt();
+            control.setVar(ref(f.dst.word), v);
+            return true;
+        }
+        // индекс приводится к int, как в _opSet
+        double i = f.dst.value;
+        std::vector<double> *a = control.getArrayPtr(ref(f.dst.word));
+        if (f.dst.index >= 0 && !control.getVar(ref(f.dst.index), i))
+            return false;
+        if (!f.dst.inRange && (!a || !(i > -1.0) || !(i < (double)a->size())))
+            return false;
+        (*a)[(size_t)(int)i] = v;
+        return true;
+    }
+
+    void _opFused(const Fused &f)
+    {
+        if (!fusedStore(f))
+        {
+            _opSet();
+            return;
+        }
+        currentWord = f.next;
+    }
+
+    // Нативный счётный цикл (fuse.cpp) от проверки условия до выхода.
+    // Оператор, которому нужен общий путь, продолжает цикл в интерпретаторе
+    bool runCounted(const CountedLoop &L)
+    {
+        double *ip = control.getVarPtr(ref(L.counter));
+        double n;
+        if (!ip || !fusedLoad(L.limit, n))
+            return false;
+        auto inside = [&](double v)
+        { return L.inclusive ? v <= n : v < n; };
+
+        double iv = *ip;
+        const double span = (CountedLoop::kUnroll - 1) * L.step;
+        while (inside(iv))
+        {
+            // развёрнутый проход, если все его итерации точно внутри цикла
+            const bool wide = !L.unrolled.empty() && iv == std::floor(iv) &&
+                              std::fabs(iv) < 4503599627370496.0 && inside(iv + span);
+            for (const CountedStmt &s : wide ? L.unrolled : L.body)
+            {
+                const double cur = s.off ? iv + s.off * L.step : iv;
+                if (s.reads)
+                    *ip = cur;
+                if (!fusedStore(fused[s.fused]))
+                {
+                    *ip = cur;
+                    deepStack.push_back(whileCode(L.whileWord));
+                    currentWord = fused[s.fused].word;
+                    return true;
+                }
+            }
+            iv += wide ? CountedLoop::kUnroll * L.step : L.step;
+        }
+        *ip = iv;
+        currentWord = L.close + 1;
+        return true;
+    }
+
+    // i = i + K в конце счётного цикла: шаг, проверка и переход сразу
+    void _opStep(const CountedLoop &L)
+    {
+        double *ip = control.getVarPtr(ref(L.counter));
+        *ip += L.step;
+        currentWord = L.close;
+        if (jitHook())
+            return;
+        double n = 0.0;
+        fusedLoad(L.limit, n);
+        if (L.inclusive ? *ip <= n : *ip < n)
+            currentWord = deepStack.back().INword + 1;
+        else
+        {
+            deepStack.pop_back();
+            currentWord = L.close + 1;
+        }
+    }
+
+    // JIT включён и цикл с '}' в close ещё не признан некомпилируемым
+    bool jitMayCompile(int close) const
+    {
+#ifdef LILC_JIT
+        return jitEnabled && jitIndex[close] != -2;
+#else
+        (void)close;
+        return false;
+#endif
+    }
+
+    // На '}' горячего цикла — попробовать машинный код (jit.cpp)
+    bool jitHook()
+    {
+#ifdef LILC_JIT
+        if (currentWord == jitBypass)
+        {
+            jitBypass = -1;
+            return false;
         }
-        double result = _fnEval(currentWord + 2, closeParenthes - 1);
+        return jitEnabled && enterJit();
+#else
+        return false;
+#endif
+    }
+
+    void _opIF()
+    {
+        // Заголовок проверен в buildMatchTable: IF ( ... ) { ... }
+        const int closeParenthes = matchWord[currentWord + 1];
+        const int openBrace = matchWord[currentWord];
+        const int closeBrace = matchWord[openBrace];
+
+        // std::cout << "close Parenthes " << closeParenthes << " openBrace " << openBrace << " closeBrace " << closeBrace << "\n";
+
+        double result;
+        if (!fusedCondValue(fusedCond[currentWord], result))
+            result = _fnEval(currentWord + 2, closeParenthes - 1);
         // std::cout << "result = " << result << "\n";
         if (result == 1 || result > 1)
         {
@@ -1035,7 +1671,6 @@ public:
             deepStack.push_back(stack);
 
             currentWord = openBrace + 1;
-            control.inLevel();
             return;
         }
         else if (result == 0)
@@ -1059,13 +1694,7 @@ public:
 
     void _opELSE()
     {
-        const char *openBrace = getWordUnchecked(1);
-        if (openBrace != S->LBRACE)
-        {
-            printError("ELSE \"{\" not found", 1);
-            halt();
-        }
-        int closeBrace = foundCloseBrace();
+        const int closeBrace = matchWord[matchWord[currentWord]];
         DeepCode stack;
         stack.INword = currentWord + 1;
         stack.OUTword = closeBrace;
@@ -1073,118 +1702,96 @@ public:
         deepStack.push_back(stack);
 
         currentWord = currentWord + 2;
-        control.inLevel();
     }
 
     void _opPROC()
     {
-        int closeBrace = foundCloseBrace();
-        currentWord = closeBrace + 1;
+        currentWord = findPROC(getWordUnchecked(1))->closeBrace + 1;
     }
 
-    void _opWHILE()
+    // Поэлементный цикл целиком; false — выполнять цикл обычным путём
+    bool runKernel(const VecKernel &k)
     {
-        // Находим границы "( ... ) { ... }"
-        int closeParenthes = foundCloseParenthes();
-        int openBrace = foundNextWord(S->LBRACE);
-        int closeBrace = foundCloseBrace();
+        double *i = control.getVarPtr(ref(k.counter.word));
+        double n = k.limitConst;
+        if (!i || (k.limitVar.word >= 0 && !control.getVar(ref(k.limitVar.word), n)))
+            return false;
+        const long count = vecTripCount(k.inclusive, *i, n);
+        if (count <= 0)
+            return false;
 
-        const char *openParenthes = getWordUnchecked(1);
-        if (openParenthes != S->LP)
+        kArrays.clear();
+        kSizes.clear();
+        kScalars.clear();
+        for (const VecRef &r : k.arrays)
         {
-            printError("WHILE \"(\" not found", 1);
-            halt();
-            return;
+            std::vector<double> *v = control.getArrayPtr(ref(r.word));
+            if (!v)
+                return false;
+            kArrays.push_back(v->data());
+            kSizes.push_back(v->size());
+        }
+        for (const VecRef &r : k.scalars)
+        {
+            double v;
+            if (!control.getVar(ref(r.word), v))
+                return false;
+            kScalars.push_back(v);
         }
+        if (!vecRun(k, kArrays.data(), kSizes.data(), kScalars.data(), *i, count))
+            return false;
+        *i += (double)count;
+        return true;
+    }
+
+    // Запись стека вложенностей для WHILE в слове w
+    DeepCode whileCode(int w) const
+    {
+        const int closeParenthes = matchWord[w + 1];
+        const int openBrace = matchWord[w];
 
-        // Готовим запись для стека вложенностей
         DeepCode dc;
         dc.type = DeepType::WHILE;
         dc.INword = openBrace;
-        dc.OUTword = closeBrace;
-        dc.EXPRstart = currentWord + 2;  // содержимое условия без '('
+        dc.OUTword = matchWord[openBrace];
+        dc.EXPRstart = w + 2;            // содержимое условия без '('
         dc.EXPRend = closeParenthes - 1; // и без ')'
 
-        // --- Попытка быстрого условия: ( ident < number ) ---
-        // Быстрая форма строго из трёх токенов между скобками:
-        //   tok2 = идентификатор переменной
-        //   tok3 = оператор сравнения
-        //   tok4 = целочисленная константа (строка цифр)
-        const char *tok2 = getWordUnchecked(2);
-        const char *tok3 = getWordUnchecked(3);
-        const char *tok4 = getWordUnchecked(4);
+        dc.cond = fusedCond[w];
+        return dc;
+    }
 
-        auto isNum = [&](const char *s) -> bool
-        {
-            if (!s || !*s)
-                return false;
-            for (const unsigned char *p = (const unsigned char *)s; *p; ++p)
-                if (!std::isdigit(*p))
-                    return false;
-            return true;
-        };
+    void _opWHILE()
+    {
+        // Границы "{ ... }" — из таблицы пар
+        const int openBrace = matchWord[currentWord];
+        const int closeBrace = matchWord[openBrace];
 
-        dc.fastCond = false;
-        if (tok2 && tok3 && tok4 &&
-            getWordUnchecked(5) == S->RP && // ровно три токена внутри ( ... )
-            isNum(tok4) &&
-            (tok3 == S->LT || tok3 == S->LEQ || tok3 == S->GT || tok3 == S->GEQ || tok3 == S->EQEQ || tok3 == S->NEQ))
-        {
-            dc.fastCond = true;
-            dc.condVarId = tok2;
-            dc.condCst = std::strtod(tok4, nullptr);
-
-            if (tok3 == S->LT)
-                dc.condOp = DeepCode::OP_LT;
-            else if (tok3 == S->LEQ)
-                dc.condOp = DeepCode::OP_LE;
-            else if (tok3 == S->GT)
-                dc.condOp = DeepCode::OP_GT;
-            else if (tok3 == S->GEQ)
-                dc.condOp = DeepCode::OP_GE;
-            else if (tok3 == S->EQEQ)
-                dc.condOp = DeepCode::OP_EQ;
-            else
-                dc.condOp = DeepCode::OP_NE;
+        const int kernel = loopKernel[currentWord];
+        if (kernel >= 0 && runKernel(kernels[kernel]))
+        {
+            currentWord = closeBrace + 1;
+            return;
         }
 
-        // Функция локальной оценки условия
-        auto evalCond = [&]() -> double
-        {
-            if (!dc.fastCond)
-            {
-                return _fnEval(dc.EXPRstart, dc.EXPRend);
-            }
-            double cur = 0.0;
-            // быстрый путь всё равно читает текущее значение переменной
-            if (!control.getVar(dc.condVarId, cur))
-                return 0.0;
+        resetHoists(currentWord);
 
-            switch (dc.condOp)
-            {
-            case DeepCode::OP_LT:
-                return (cur < dc.condCst) ? 1.0 : 0.0;
-            case DeepCode::OP_LE:
-                return (cur <= dc.condCst) ? 1.0 : 0.0;
-            case DeepCode::OP_GT:
-                return (cur > dc.condCst) ? 1.0 : 0.0;
-            case DeepCode::OP_GE:
-                return (cur >= dc.condCst) ? 1.0 : 0.0;
-            case DeepCode::OP_EQ:
-                return (cur == dc.condCst) ? 1.0 : 0.0;
-            case DeepCode::OP_NE:
-                return (cur != dc.condCst) ? 1.0 : 0.0;
-            }
-            return 0.0;
-        };
+        // нативный счётный цикл — если этот цикл не возьмёт JIT (он быстрее)
+        const int counted = countedAt[currentWord];
+        if (counted >= 0 && countedLoops[counted].native && !jitMayCompile(closeBrace) &&
+            runCounted(countedLoops[counted]))
+            return;
+
+        const DeepCode dc = whileCode(currentWord);
 
-        const double result = evalCond();
+        double result;
+        if (!fusedCondValue(dc.cond, result))
+            result = _fnEval(dc.EXPRstart, dc.EXPRend);
         if (result >= 1.0)
         {
             // Входим в тело цикла
             deepStack.push_back(dc);
             currentWord = openBrace + 1;
-            control.inLevel();
             return;
         }
         else if (result == 0.0)
@@ -1201,14 +1808,120 @@ public:
         }
     }
 
-    void _opRETURN()
+    // Вызов, который не принял компилятор: неверное число аргументов
+    void badCall(int w)
     {
-        if (deepStack[deepStack.size() - 1].type == DeepType::PROC)
+        const ProcInfo *proc = findPROC(words[w]);
+        const std::string er = "Procedure '" + std::string(words[w]) + "' expects " +
+                               std::to_string(proc ? proc->params : 0) + " arguments";
+        const int back = currentWord;
+        currentWord = w;
+        printError(er.c_str());
+        currentWord = back;
+        halt();
+    }
+
+    void _opCALL(int call)
+    {
+        if (call < 0)
+            return badCall(currentWord);
+        // аргументы считаются в кадре вызывающей
+        const ProcCall &c = procCalls[call];
+        double args[kMaxProcParams];
+        for (size_t k = 0; k < c.from.size(); ++k)
+        {
+            args[k] = _fnEval(c.from[k], c.to[k] - 1);
+            if (isHalted)
+                return;
+        }
+        std::vector<double> *arrays[kMaxProcParams];
+        argArrays(c, arrays);
+        enterProc(c, args, arrays, c.close < 0 ? currentWord + 1 : c.close + 1);
+    }
+
+    // Массивы-аргументы в кадре вызывающей
+    void argArrays(const ProcCall &c, std::vector<double> **arrays)
+    {
+        for (size_t k = 0; k < c.arrays.size(); ++k)
+            arrays[k] = control.getArrayPtr(ref(c.arrays[k]));
+    }
+
+    // Кадр процедуры: значения — в первые ячейки, массивы вызывающей — по ссылке
+    void enterProc(const ProcCall &c, const double *args, std::vector<double> *const *arrays, int retWord)
+    {
+        if (control.depth() >= maxCallDepth)
         {
-            currentWord = deepStack[deepStack.size() - 1].RETword;
+            currentWord = c.word;
+            printError(callDepthError(maxCallDepth).c_str());
+            halt();
+            return;
+        }
+        DeepCode t;
+        t.RETword = retWord;
+        t.type = DeepType::PROC;
+        deepStack.push_back(t);
+        control.enterFrame(c.proc->frameVars, c.proc->frameArrs);
+        std::copy(args, args + c.from.size(), control.frameVars());
+        for (size_t k = 0; k < c.arrays.size(); ++k)
+            control.bindArray((int)k, arrays[k]);
+        retValue = 0.0;
+        currentWord = c.proc->openBrace + 1; // name ( ... ) { ...
+    }
+
+    // RETURN f(...); — аргументы считаются здесь, затем кадр процедуры
+    // освобождается и f получает его место и адрес возврата
+    void _opTAILCALL(const ProcCall &c)
+    {
+        double args[kMaxProcParams];
+        std::vector<double> *arrays[kMaxProcParams];
+        for (size_t k = 0; k < c.from.size(); ++k)
+        {
+            args[k] = _fnEval(c.from[k], c.to[k] - 1);
+            if (isHalted)
+                return;
+        }
+        argArrays(c, arrays); // глобальные или параметры: переживут кадр
+        while (deepStack.back().type != DeepType::PROC)
             deepStack.pop_back();
+        const int retWord = deepStack.back().RETword;
+        deepStack.pop_back();
+        control.leaveFrame();
+        enterProc(c, args, arrays, retWord);
+    }
+
+    void _opRETURN()
+    {
+        const int call = callAt[currentWord + 1];
+        if (call >= 0 && procCalls[call].tail)
+            return _opTAILCALL(procCalls[call]);
+        // RETURN e; — значение для вызова внутри выражения
+        retValue = 0.0;
+        const char *next = getWord(1);
+        if (next && next != S->SEMI && next != S->RBRACE)
+        {
+            const int semi = foundNextWord(S->SEMI);
+            if (semi < 0)
+            {
+                printError("RETURN \";\" not found");
+                halt();
+                return;
+            }
+            const double value = _fnEval(currentWord + 1, semi - 1);
+            if (isHalted)
+                return;
+            retValue = value;
+        }
+        // RETURN выходит из ближайшей процедуры, минуя открытые блоки
+        while (!deepStack.empty() && deepStack.back().type != DeepType::PROC)
+            deepStack.pop_back();
+        if (deepStack.empty())
+        {
+            halt(); // RETURN в main — конец программы
             return;
         }
+        currentWord = deepStack.back().RETword;
+        deepStack.pop_back();
+        control.leaveFrame();
     }
     void _opCLOSEBRACE()
     {
@@ -1217,44 +1930,22 @@ public:
         {
             currentWord = deepStack[deepStack.size() - 1].RETword;
             deepStack.pop_back();
+            control.leaveFrame();
+            retValue = 0.0; // процедура дошла до конца без RETURN
             return;
         }
 
         if (deepStack.back().type == DeepType::WHILE)
         {
-            DeepCode &dc = deepStack.back();
+            if (jitHook())
+                return;
+            // копия: вызов процедуры в условии может перераспределить стек
+            const DeepCode dc = deepStack.back();
 
-            bool ok;
-            if (dc.fastCond)
-            {
-                double cur = 0.0;
-                control.getVar(dc.condVarId, cur);
-                switch (dc.condOp)
-                {
-                case DeepCode::OP_LT:
-                    ok = (cur < dc.condCst);
-                    break;
-                case DeepCode::OP_LE:
-                    ok = (cur <= dc.condCst);
-                    break;
-                case DeepCode::OP_GT:
-                    ok = (cur > dc.condCst);
-                    break;
-                case DeepCode::OP_GE:
-                    ok = (cur >= dc.condCst);
-                    break;
-                case DeepCode::OP_EQ:
-                    ok = (cur == dc.condCst);
-                    break;
-                case DeepCode::OP_NE:
-                    ok = (cur != dc.condCst);
-                    break;
-                }
-            }
-            else
-            {
-                ok = _fnEval(dc.EXPRstart, dc.EXPRend);
-            }
+            double value;
+            const bool ok = fusedCondValue(dc.cond, value) ? value != 0.0 : _fnEval(dc.EXPRstart, dc.EXPRend) != 0.0;
+            if (isHalted)
+                return;
 
             if (ok)
             {
@@ -1276,121 +1967,451 @@ public:
             if (word == S->ELSE)
             {
                 // std::cout << "IF ok, next ELSE\n";
-                int closeELSE = foundCloseBrace();
-                currentWord = closeELSE + 1;
+                currentWord = matchWord[matchWord[currentWord + 1]] + 1;
                 deepStack.pop_back();
-                control.outLevel();
                 return;
             }
         }
 
-        control.outLevel();
         deepStack.pop_back();
         currentWord++;
     }
 
-    void tick()
+#ifdef LILC_JIT
+    // Мы на '}' горячего цикла: дальше цикл крутит машинный код, пока не
+    // завершится или не дойдёт до оператора, который выполняет tick
+    bool enterJit()
     {
-        if (isHalted)
+        const int close = currentWord;
+        int &idx = jitIndex[close];
+        if (idx == -1)
         {
-            return;
+            if (++loopHits[close] < kJitThreshold)
+                return false;
+            idx = compileJit(close);
         }
+        if (idx < 0)
+            return false;
 
-        const char *word = getWord(0);
-        if (!word)
+        JitEntry &J = *jitLoops[idx];
+        jitArrays.clear();
+        for (int a = 0; a < J.narrs; ++a)
         {
-            halt();
-            return;
+            std::vector<double> &v = control.frameArray(a);
+            jitArrays.push_back({v.data(), v.size()});
         }
-
-        // обработка команд
-        if (word == S->CONST)
+        for (int a = 0; a < bytecode.funcs[0].narrs; ++a)
         {
-
-            currentWord += 1;
-            _opCreateVar(true);
+            std::vector<double> &v = control.globalArray(a);
+            jitArrays.push_back({v.data(), v.size()});
         }
-        else if (word == S->VAR)
+        JitState st{control.frameVars(), control.globalVars(), jitArrays.data(), bytecode.consts.data(), this};
+
+        const int exit = J.loop.fn(&st);
+        if (exit == 0)
         {
-            _opCreateVar();
+            deepStack.pop_back();
+            currentWord = close + 1;
+            return true;
         }
-        else if (word == S->PRINT)
+        for (const DeepCode &d : J.resumePath[exit])
         {
-            _opPrint();
+            deepStack.push_back(d);
+            if (d.type == DeepType::WHILE)
+                resetHoists(d.EXPRstart - 2);
         }
-        else if (word == S->PRINTLN)
+        currentWord = J.resumeWord[exit];
+        jitBypass = currentWord;
+        return true;
+    }
+
+    static int jitKernel(void *host, int k)
+    {
+        lilc *self = static_cast<lilc *>(host);
+        return self->runKernel(self->kernels[k]) ? 1 : 0;
+    }
+
+    int compileJit(int close)
+    {
+        if (!bytecodeReady && !compileBytecode())
+            return -2;
+        if (!bytecode.inlined.empty())
+            return -2; // собран для ВМ: копии тел процедур не совпадают с кадрами tick
+        const BytecodeLoop *loop = nullptr;
+        for (const BytecodeLoop &l : bytecode.loops)
+            if (l.closeWord == close)
+                loop = &l;
+        if (!loop)
+            return -2;
+
+        std::unique_ptr<JitEntry> entry(new JitEntry());
+        const JitHelpers helpers{&lilc::jitKernel};
+        if (!JitCompiler(bytecode, *loop, helpers).compile(entry->loop))
+            return -2;
+        entry->narrs = bytecode.funcs[loop->func].narrs;
+
+        const size_t exits = entry->loop.exitPc.size();
+        entry->resumeWord.assign(exits, -1);
+        entry->resumePath.resize(exits);
+        for (size_t x = 1; x < exits; ++x)
+        {
+            entry->resumeWord[x] = bytecode.stmtOf[entry->loop.exitPc[x]];
+            if (!blockPath(matchWord[loop->whileWord], entry->resumeWord[x], entry->resumePath[x]))
+                return -2;
+        }
+        jitLoops.push_back(std::move(entry));
+        return (int)jitLoops.size() - 1;
+    }
+#endif
+
+    // Записи стека вложенностей для блоков, открытых между '{' open и словом
+    // target, — как если бы tick дошёл до target сам
+    bool blockPath(int open, int target, std::vector<DeepCode> &out) const
+    {
+        std::vector<int> braces;
+        for (int i = open + 1; i < target; ++i)
         {
-            _opPrint(1);
+            if (words[i] == S->QUOTE)
+                i += 2;
+            else if (words[i] == S->LBRACE)
+                braces.push_back(i);
+            else if (words[i] == S->RBRACE && !braces.empty())
+                braces.pop_back();
         }
-        else if (getWordUnchecked(1) == S->SEMI) //(findPROC(word) != -1)
+        out.clear();
+        for (int b : braces)
         {
-            if (findPROC(word) != -1)
+            const char *before = words[b - 1];
+            if (before == S->ELSE)
             {
-                DeepCode t;
-                t.RETword = currentWord + 1;
-                t.type = DeepType::PROC;
-                deepStack.push_back(t);
-                int gotoPROC = findPROC(word);
-                currentWord = gotoPROC + 2; // name { ...
+                DeepCode dc;
+                dc.type = DeepType::ELSE;
+                dc.INword = b;
+                dc.OUTword = matchWord[b];
+                out.push_back(dc);
+                continue;
             }
+            if (before != S->RP)
+                return false;
+            const int head = matchWord[b - 1] - 1;
+            if (words[head] == S->WHILE)
+                out.push_back(whileCode(head));
+            else if (words[head] == S->IF)
+            {
+                DeepCode dc;
+                dc.type = DeepType::IF;
+                dc.INword = b;
+                dc.OUTword = matchWord[b];
+                out.push_back(dc);
+            }
+            else
+                return false;
         }
-        else if (getWordUnchecked(1) == S->EQ || getWordUnchecked(1) == S->LBRACKET)
+        return true;
+    }
+
+    // Выполнить оператор с текущего слова
+    inline void step(const Decoded &d)
+    {
+        switch (d.kind)
         {
+        case ST_CONST:
+            currentWord += 1;
+            _opCreateVar();
+            break;
+        case ST_VAR:
+            _opCreateVar();
+            break;
+        case ST_PRINT:
+            _opPrint();
+            break;
+        case ST_PRINTLN:
+            _opPrint(1);
+            break;
+        case ST_CALL:
+            _opCALL(d.call);
+            break;
+        case ST_SET:
             _opSet(); // внутри уже разберём, и если имя не найдено — выведем ошибку
-        }
-        else if (word == S->IF)
-        {
+            break;
+        case ST_FUSED:
+            _opFused(fused[d.fused]);
+            break;
+        case ST_STEP:
+            _opStep(countedLoops[d.loop]);
+            break;
+        case ST_IF:
             _opIF();
-        }
-        else if (word == S->WHILE)
-        {
+            break;
+        case ST_WHILE:
             _opWHILE();
-        }
-        else if (word == S->RBRACE)
-        {
+            break;
+        case ST_CLOSE:
             _opCLOSEBRACE();
-        }
-        else if (word == S->ELSE)
-        {
+            break;
+        case ST_ELSE:
             _opELSE();
+            break;
+        case ST_SEMI:
+            nextWord();
+            break;
+        case ST_HALT:
+        case ST_END:
+            halt();
+            break;
+        case ST_PROC:
+            _opPROC();
+            break;
+        case ST_RETURN:
+            _opRETURN();
+            break;
+        case ST_BREAK:
+            _opBREAK();
+            break;
+        case ST_CONTINUE:
+            _opCONTINUE();
+            break;
+        default:
+            printError("Unknown command");
+            halt();
+            break;
         }
-        else if (word == S->SEMI)
+    }
+
+    void tick()
+    {
+        if (isHalted)
         {
-            nextWord();
+            return;
         }
-        else if (word == S->HALT)
+        if ((size_t)currentWord >= decoded.size())
         {
             halt();
+            return;
         }
-        else if (word == S->PROC)
-        {
-            _opPROC();
+        step(decoded[currentWord]);
+    }
+
+    // Компиляция слов в байткод для ENGINE_VM
+    bool compileBytecode()
+    {
+        // tick исполняет вызовы сам, его JIT берёт байткод без встраивания
+        InlinePolicy policy = inlining;
+        if (engine == ENGINE_TICK)
+            policy.maxStatements = 0;
+        Compiler compiler(words, tokens, *S);
+        if (!compiler.compile(bytecode, policy))
+        {
+            currentWord = compiler.errorWord;
+            printError(compiler.error.c_str());
+            halt();
+            return false;
         }
-        else if (word == S->RETURN)
+        vm.onText = [this](const char *text, bool ln)
+        { printText(text, ln); };
+        vm.onNumber = [this](double value, bool ln)
+        { printValue(value, ln); };
+        vm.onDiag = [this](int word, const char *text, bool isError)
         {
-            _opRETURN();
-        }
-        else
+            currentWord = word;
+            if (isError)
+                printError(text);
+            else
+                printWarning(text);
+        };
+        vm.maxDepth = maxCallDepth;
+        vm.load(&bytecode);
+        bytecodeReady = true;
+        return true;
+    }
+
+    // ENGINE_AOT: собрать (или взять из кэша) модуль; не вышло — дальше ВМ
+    bool compileAot()
+    {
+        if (!bytecodeReady && !compileBytecode())
+            return false;
+        std::string err;
+        if (!aot.load(bytecode, maxCallDepth, err))
         {
-            printError("Unknown command");
-            halt();
+            printWarning(("AOT: " + err + ", falling back to VM").c_str());
+            engine = ENGINE_VM;
+            return false;
         }
+        aotReady = true;
+        return true;
+    }
+
+    void runAot()
+    {
+        static std::vector<BuiltinFn1> fn1;
+        static std::vector<BuiltinFn2> fn2;
+        if (fn1.empty())
+            for (const Builtin &b : builtins())
+            {
+                fn1.push_back(b.f1);
+                fn2.push_back(b.f2);
+            }
+
+        LilcAotHost host;
+        host.ctx = this;
+        host.text = [](void *c, const char *text, int ln)
+        { static_cast<lilc *>(c)->printText(text, ln != 0); };
+        host.number = [](void *c, double value, int ln)
+        { static_cast<lilc *>(c)->printValue(value, ln != 0); };
+        host.diag = [](void *c, int word, const char *text, int isError)
+        {
+            lilc *self = static_cast<lilc *>(c);
+            self->currentWord = word;
+            if (isError)
+                self->printError(text);
+            else
+                self->printWarning(text);
+        };
+        host.tripCount = [](int inclusive, double i0, double n)
+        { return vecTripCount(inclusive != 0, i0, n); };
+        host.fn1 = fn1.data();
+        host.fn2 = fn2.data();
+        aot.run(host);
     }
 
     void interpretate(int limit = -1)
     {
-        int steps = 0;
-        while (!isHalted)
+        // AOT выполняет программу целиком, limit не учитывается
+        if (engine == ENGINE_AOT)
+        {
+            if (isHalted)
+                return;
+            if (aotReady || compileAot())
+            {
+                runAot();
+                halt();
+                return;
+            }
+            if (isHalted)
+                return;
+        }
+
+        if (engine == ENGINE_VM)
+        {
+            if (isHalted || (!bytecodeReady && !compileBytecode()))
+                return;
+            vm.run(limit);
+            if (vm.halted)
+                halt();
+            return;
+        }
+
+        const long maxSteps = (limit == -1) ? LONG_MAX : limit;
+        const Decoded *D = decoded.data();
+        const size_t nDecoded = decoded.size();
+        long steps = 0;
+
+#if defined(__GNUC__) && !defined(LILC_NO_COMPUTED_GOTO)
+        // Шитый код: после каждого оператора переход сразу на метку следующего
+        static void *const labels[ST_COUNT] = {
+            &&l_end, &&l_const, &&l_var, &&l_print, &&l_println, &&l_call, &&l_set, &&l_if,
+            &&l_while, &&l_close, &&l_else, &&l_semi, &&l_end, &&l_proc, &&l_return, &&l_unknown,
+            &&l_fused, &&l_step, &&l_break, &&l_continue};
+
+#define LILC_NEXT()                                   \
+    do                                                \
+    {                                                 \
+        if (isHalted || steps >= maxSteps)            \
+            goto l_done;                              \
+        ++steps;                                      \
+        if ((size_t)currentWord >= nDecoded)          \
+            goto l_end;                               \
+        goto *labels[D[currentWord].kind];            \
+    } while (0)
+
+        LILC_NEXT();
+    l_const:
+        currentWord += 1;
+        _opCreateVar();
+        LILC_NEXT();
+    l_var:
+        _opCreateVar();
+        LILC_NEXT();
+    l_print:
+        _opPrint();
+        LILC_NEXT();
+    l_println:
+        _opPrint(1);
+        LILC_NEXT();
+    l_call:
+        _opCALL(D[currentWord].call);
+        LILC_NEXT();
+    l_set:
+        _opSet();
+        LILC_NEXT();
+    l_fused:
+        _opFused(fused[D[currentWord].fused]);
+        LILC_NEXT();
+    l_step:
+        _opStep(countedLoops[D[currentWord].loop]);
+        LILC_NEXT();
+    l_if:
+        _opIF();
+        LILC_NEXT();
+    l_while:
+        _opWHILE();
+        LILC_NEXT();
+    l_close:
+        _opCLOSEBRACE();
+        LILC_NEXT();
+    l_else:
+        _opELSE();
+        LILC_NEXT();
+    l_semi:
+        nextWord();
+        LILC_NEXT();
+    l_proc:
+        _opPROC();
+        LILC_NEXT();
+    l_return:
+        _opRETURN();
+        LILC_NEXT();
+    l_break:
+        _opBREAK();
+        LILC_NEXT();
+    l_continue:
+        _opCONTINUE();
+        LILC_NEXT();
+    l_unknown:
+        printError("Unknown command");
+        halt();
+        goto l_done;
+    l_end:
+        halt();
+    l_done:;
+#undef LILC_NEXT
+#else
+        // Переносимый вариант: switch по предекодированному виду
+        while (!isHalted && steps < maxSteps)
         {
-            tick();
             ++steps;
-            if (limit != -1 && steps >= limit)
+            if ((size_t)currentWord >= nDecoded)
             {
+                halt();
                 break;
             }
+            step(D[currentWord]);
         }
+#endif
+        executed = steps;
     }
 
+    // Сколько операторов выполнил последний interpretate() (движок tick)
+    long executedStatements() const { return executed; }
+
+    // Сколько присваиваний и условий слилось в шаблоны при загрузке
+    const FuseReport &fusionReport() const { return fuseReport; }
+    void printFusion() const { fuseReport.print(std::cout); }
+
+    // Память потока слов (указатели) и компактного потока токенов с таблицами
+    size_t wordBytes() const { return words.capacity() * sizeof(const char *); }
+    size_t tokenBytes() const { return tokens.bytes(); }
+
     void printWords() const
     {
         for (size_t i = 0; i < words.size(); ++i)
@@ -1404,6 +2425,19 @@ public:
         }
     }
 
+    void printBytecode()
+    {
+        if (bytecodeReady || compileBytecode())
+            bytecode.print(std::cout);
+    }
+
+    // Какие вызовы процедур заменены их телами (ENGINE_VM / ENGINE_AOT)
+    void printInlining()
+    {
+        if (bytecodeReady || compileBytecode())
+            bytecode.printInlining(std::cout);
+    }
+
     void printError(const char *text, int word = 0)
     {
         std::string t = "ERROR in word <" + std::to_string(currentWord) + std::to_string(word) + "><" + words[currentWord + word] + ">" + " - \n" + text + "\n";
@@ -1425,108 +2459,965 @@ public:
     }
 
 private:
-private:
-    void parseProgram()
+    // Сопоставление скобок и заголовков блоков за один проход.
+    // Ошибка вложенности сообщается один раз — при загрузке.
+    void buildMatchTable()
     {
-        char buffer[512];
-        int bufIndex = 0;
+        const int n = (int)words.size();
+        matchWord.assign(n, -1);
 
-        auto flushBuffer = [&]()
+        auto fail = [&](int at, const char *text)
         {
-            if (bufIndex > 0)
-            {
-                buffer[bufIndex] = '\0';
-                words.push_back(INTERN().intern(buffer));
-                bufIndex = 0;
-            }
+            currentWord = at;
+            printError(text);
+            currentWord = 0;
+            halt();
         };
 
-        while (*program)
+        std::vector<int> open;
+        for (int i = 0; i < n; ++i)
         {
-            if (*program == '"')
+            const char *w = words[i];
+            if (w == S->QUOTE)
             {
-                // 1) Закрываем предыдущий токен, если он есть
-                flushBuffer();
+                // QUOTE текст QUOTE — содержимое строки не скобки
+                i += (i + 2 < n && words[i + 2] == S->QUOTE) ? 2 : 1;
+                continue;
+            }
+            if (w == S->LP || w == S->LBRACE || w == S->LBRACKET)
+            {
+                open.push_back(i);
+                continue;
+            }
 
-                // 2) Открывающая кавычка как отдельный токен
-                words.push_back(S->QUOTE);
-                ++program;
+            const char *opener = (w == S->RP) ? S->LP : (w == S->RBRACE) ? S->LBRACE
+                                                    : (w == S->RBRACKET)  ? S->LBRACKET
+                                                                          : nullptr;
+            if (!opener)
+                continue;
+            if (open.empty())
+                return fail(i, "Unexpected closing bracket");
+            if (words[open.back()] != opener)
+                return fail(open.back(), "Mismatched closing bracket");
+            matchWord[i] = open.back();
+            matchWord[open.back()] = i;
+            open.pop_back();
+        }
+        if (!open.empty())
+        {
+            const char *w = words[open.back()];
+            return fail(open.back(), w == S->LBRACE ? "Closing } not found" : w == S->LP ? "Closing ) not found"
+                                                                                      : "Closing ] not found");
+        }
 
-                // 3) Собираем содержимое строки с поддержкой любого экранирования
-                char strBuffer[512];
-                int strIndex = 0;
+        // Заголовки блоков
+        for (int i = 0; i < n; ++i)
+        {
+            const char *w = words[i];
+            if (w == S->QUOTE)
+            {
+                i += (i + 2 < n && words[i + 2] == S->QUOTE) ? 2 : 1;
+                continue;
+            }
+            if (w == S->IF || w == S->WHILE)
+            {
+                const char *what = (w == S->IF) ? "IF" : "WHILE";
+                if (i + 1 >= n || words[i + 1] != S->LP)
+                    return fail(i, (std::string(what) + " \"(\" not found").c_str());
+                const int body = matchWord[i + 1] + 1;
+                if (body >= n || words[body] != S->LBRACE)
+                    return fail(i, (std::string(what) + " \"{\" not found").c_str());
+                matchWord[i] = body;
+            }
+            else if (w == S->ELSE)
+            {
+                if (i + 1 >= n || words[i + 1] != S->LBRACE)
+                    return fail(i, "ELSE \"{\" not found");
+                matchWord[i] = i + 1;
+            }
+            else if (w == S->PROC)
+            {
+                // PROC name { ... }  |  PROC name ( параметры ) { ... }
+                int body = i + 2;
+                if (body < n && words[body] == S->LP)
+                    body = matchWord[body] + 1;
+                if (body >= n || words[body] != S->LBRACE)
+                    return fail(i, "PROC \"{\" not found");
+                matchWord[i] = body;
+            }
+        }
 
-                while (*program && strIndex < (int)sizeof(strBuffer) - 1)
+        // BREAK / CONTINUE — '{' тела ближайшего WHILE той же процедуры
+        std::vector<int> blocks; // открытые '{'
+        for (int i = 0; i < n; ++i)
+        {
+            const char *w = words[i];
+            if (w == S->QUOTE)
+                i += (i + 2 < n && words[i + 2] == S->QUOTE) ? 2 : 1;
+            else if (w == S->LBRACE)
+                blocks.push_back(i);
+            else if (w == S->RBRACE && !blocks.empty())
+                blocks.pop_back();
+            else if (w == S->BREAK || w == S->CONTINUE)
+                for (size_t k = blocks.size(); k-- > 0;)
                 {
-
-                    if (*program == '\\' && program[1] != '\0')
-                    {
-
-                        // встретили '\' — значит экранирование: копируем '\' и следующий символ
-                        *program++;
-                        strBuffer[strIndex++] = *program++;
-                    }
-                    else if (*program == '"')
-                    {
-                        // настоящая кавычка — конец литерала
+                    const int owner = blocks[k] > 0 ? ownerOf(blocks[k]) : -1;
+                    if (owner >= 0 && words[owner] == S->WHILE)
+                        matchWord[i] = blocks[k];
+                    if (owner >= 0 && (words[owner] == S->WHILE || words[owner] == S->PROC))
                         break;
-                    }
-                    else
-                    {
-                        // обычный символ
-                        strBuffer[strIndex++] = *program++;
-                    }
                 }
+        }
+    }
+
+    // Слово IF/WHILE/ELSE/PROC, чьё тело открывает '{' в слове b; -1 — простой блок
+    int ownerOf(int b) const
+    {
+        if (words[b - 1] == S->ELSE)
+            return b - 1;
+        if (words[b - 1] == S->RP)
+        {
+            const int open = matchWord[b - 1];
+            if (open > 0 && (words[open - 1] == S->IF || words[open - 1] == S->WHILE))
+                return open - 1;
+            if (open > 1 && words[open - 2] == S->PROC)
+                return open - 2;
+        }
+        if (b > 1 && words[b - 2] == S->PROC)
+            return b - 2;
+        return -1;
+    }
+
+    // Процедуры собираются один раз; повтор имени и вызов
+    // несуществующей процедуры — ошибка загрузки
+    void buildProcTable()
+    {
+        procs.clear();
+        const int n = (int)words.size();
+
+        auto fail = [&](int at, const std::string &text)
+        {
+            currentWord = at;
+            printError(text.c_str());
+            currentWord = 0;
+            halt();
+        };
+
+        for (int i = 0; i + 2 < n; ++i)
+        {
+            if (words[i] == S->QUOTE)
+            {
+                i += (i + 2 < n && words[i + 2] == S->QUOTE) ? 2 : 1;
+                continue;
+            }
+            if (words[i] != S->PROC)
+                continue;
+            Id name = words[i + 1];
+            if (procs.count(name))
+                return fail(i + 1, "Duplicate PROC '" + std::string(name) + "'");
+            ProcInfo info;
+            info.nameWord = i + 1;
+            info.openBrace = matchWord[i];
+            info.closeBrace = matchWord[info.openBrace];
+            if (words[i + 2] == S->LP && matchWord[i + 2] > i + 3)
+            {
+                info.params = 1;
+                for (int k = i + 3; k < matchWord[i + 2]; ++k)
+                    info.params += words[k] == S->COMMA;
+            }
+            procs[name] = info;
+        }
+
+        // Вызовы: "name ;" в начале инструкции
+        for (int i = 0; i + 1 < n; ++i)
+        {
+            if (words[i] == S->QUOTE)
+            {
+                i += (i + 2 < n && words[i + 2] == S->QUOTE) ? 2 : 1;
+                continue;
+            }
+            if (words[i + 1] != S->SEMI)
+                continue;
+            if (i > 0 && words[i - 1] != S->SEMI && words[i - 1] != S->LBRACE && words[i - 1] != S->RBRACE)
+                continue;
+            Id w = words[i];
+            if (w == S->HALT || w == S->RETURN || w == S->SEMI || w == S->BREAK || w == S->CONTINUE)
+                continue;
+            if (!procs.count(w))
+                return fail(i, "PROC '" + std::string(w) + "' not found");
+        }
+    }
+
+    // Вид оператора для каждого слова; повторяет порядок проверок
+    // прежнего tick(): ключевые слова, вызов "name ;", присваивание, ...
+    void decodeStatements()
+    {
+        const int n = (int)words.size();
+        decoded.assign(n + 1, Decoded());
+        for (int i = 0; i < n; ++i)
+        {
+            const char *w = words[i];
+            const char *next = (i + 1 < n) ? words[i + 1] : nullptr;
+            Decoded &d = decoded[i];
+            if (w == S->CONST)
+                d.kind = ST_CONST;
+            else if (w == S->VAR)
+                d.kind = ST_VAR;
+            else if (w == S->PRINT)
+                d.kind = ST_PRINT;
+            else if (w == S->PRINTLN)
+                d.kind = ST_PRINTLN;
+            else if ((next == S->SEMI || next == S->LP) && findPROC(w))
+            {
+                d.kind = ST_CALL;
+                d.call = callAt[i];
+            }
+            else if (next == S->EQ || next == S->LBRACKET)
+                d.kind = ST_SET;
+            else if (w == S->IF)
+                d.kind = ST_IF;
+            else if (w == S->WHILE)
+                d.kind = ST_WHILE;
+            else if (w == S->RBRACE)
+                d.kind = ST_CLOSE;
+            else if (w == S->ELSE)
+                d.kind = ST_ELSE;
+            else if (w == S->SEMI)
+                d.kind = ST_SEMI;
+            else if (w == S->HALT)
+                d.kind = ST_HALT;
+            else if (w == S->PROC)
+                d.kind = ST_PROC;
+            else if (w == S->RETURN)
+                d.kind = ST_RETURN;
+            else if (w == S->BREAK)
+                d.kind = ST_BREAK;
+            else if (w == S->CONTINUE)
+                d.kind = ST_CONTINUE;
+            else
+                d.kind = ST_UNKNOWN;
+        }
+    }
 
-                // 4) Завершаем строковый буфер и сохраняем как отдельный токен
-                strBuffer[strIndex] = '\0';
-                words.push_back(INTERN().intern(strBuffer));
+    // Слияние операторов по шаблонам fuse.cpp: присваивания получают
+    // ST_FUSED, условия IF/WHILE — запись в fusedCond
+    void fuseStatements()
+    {
+        fused.clear();
+        fusedCond.assign(words.size() + 1, -1);
+        fuseReport = FuseReport();
+        fuseReport.hoisted = (int)hoists.size();
+        fuseReport.cse = (int)cses.size();
+        if (isHalted)
+            return; // загрузка уже остановлена с ошибкой
+
+#ifdef LILC_NO_FUSION
+        const bool enabled = false;
+#else
+        const bool enabled = true;
+#endif
+        Fuser fuser(words, tokens, wordRef, *S);
+        const int n = (int)words.size();
+        for (int i = 0; i < n; ++i)
+        {
+            // только начала операторов; строки пропускаем целиком
+            if (words[i] == S->QUOTE)
+            {
+                i += (i + 2 < n && words[i + 2] == S->QUOTE) ? 2 : 1;
+                continue;
+            }
+            if (i > 0 && words[i - 1] != S->SEMI && words[i - 1] != S->LBRACE && words[i - 1] != S->RBRACE)
+                continue;
 
-                // 5) Закрывающая кавычка как отдельный токен
-                if (*program == '"')
+            Decoded &d = decoded[i];
+            Fused f;
+            bool ok = false;
+            if (d.kind == ST_SET)
+            {
+                ++fuseReport.sets;
+                ok = enabled && fuser.matchSet(i, f);
+                if (ok)
                 {
-                    words.push_back(S->QUOTE);
-                    ++program;
+                    d.kind = ST_FUSED;
+                    d.fused = (int)fused.size();
                 }
             }
-            else if (isspace(*program))
+            else if (d.kind == ST_IF || d.kind == ST_WHILE)
             {
-                // пробел/перевод строки — разделитель
-                flushBuffer();
-                ++program;
+                ++fuseReport.conds;
+                ok = enabled && fuser.matchCond(i + 1, matchWord[i + 1], f);
+                if (ok)
+                    fusedCond[i] = (int)fused.size();
             }
-            else if (isOneCharOperator(*program))
+            if (!ok)
+                continue;
+            ++fuseReport.shapes[f.shape];
+            fused.push_back(f);
+        }
+    }
+
+    // Слово после оператора, начинающегося со слова p
+    int statementEnd(int p) const
+    {
+        const char *w = words[p];
+        if (w == S->IF || w == S->WHILE || w == S->ELSE || w == S->PROC)
+            return matchWord[matchWord[p]] + 1;
+        if (w == S->LBRACE)
+            return matchWord[p] + 1;
+        if (decoded[p].kind == ST_FUSED)
+            return fused[decoded[p].fused].next;
+        for (int i = p; i < (int)words.size(); ++i)
+        {
+            if (words[i] == S->QUOTE)
+                i += 2;
+            else if (words[i] == S->SEMI)
+                return i + 1;
+        }
+        return (int)words.size();
+    }
+
+    static bool sameCell(const SlotRef &a, const SlotRef &b)
+    {
+        return a.slot >= 0 && a.slot == b.slot && a.global == b.global && !a.isArray && !b.isArray;
+    }
+
+    // WHILE (i < N) { ... i = i + K; } со словом WHILE в w
+    bool matchCounted(int w, CountedLoop &L) const
+    {
+        const Fused &c = fused[fusedCond[w]];
+        if ((c.op != FOP_LT && c.op != FOP_LE) || c.a.kind != FO_VAR ||
+            (c.b.kind != FO_CONST && c.b.kind != FO_VAR))
+            return false;
+        const SlotRef &i = ref(c.a.word);
+        const bool limitVar = (c.b.kind == FO_VAR);
+        if (i.isConst || (limitVar && sameCell(ref(c.b.word), i)))
+            return false;
+
+        const int open = matchWord[w];
+        const int close = matchWord[open];
+        std::vector<int> stmts;
+        for (int p = open + 1; p < close; p = statementEnd(p))
+            stmts.push_back(p);
+        if (stmts.empty() || decoded[stmts.back()].kind != ST_FUSED)
+            return false;
+
+        // последний оператор — i = i + K (или K + i), K > 0
+        const Fused &inc = fused[decoded[stmts.back()].fused];
+        if (inc.next != close || inc.dst.kind != FO_VAR || !sameCell(ref(inc.dst.word), i) || inc.op != FOP_ADD)
+            return false;
+        const FuseOperand *k = nullptr;
+        if (inc.a.kind == FO_VAR && sameCell(ref(inc.a.word), i) && inc.b.kind == FO_CONST)
+            k = &inc.b;
+        else if (inc.b.kind == FO_VAR && sameCell(ref(inc.b.word), i) && inc.a.kind == FO_CONST)
+            k = &inc.a;
+        if (!k || !(k->value > 0.0) || !std::isfinite(k->value))
+            return false;
+
+        // i и N в теле больше не пишутся; процедура может записать глобальную
+        bool calls = false;
+        for (int p = open + 1; p < stmts.back(); ++p)
+        {
+            calls = calls || decoded[p].kind == ST_CALL;
+            if (words[p + 1] == S->EQ && (sameCell(ref(p), i) || (limitVar && sameCell(ref(p), ref(c.b.word)))))
+                return false;
+        }
+        if (calls && (i.global || (limitVar && ref(c.b.word).global)))
+            return false;
+
+        L.whileWord = w;
+        L.close = close;
+        L.counter = c.a.word;
+        L.limit = c.b;
+        L.inclusive = (c.op == FOP_LE);
+        L.step = k->value;
+        L.stepWord = stmts.back();
+
+        // нативно — только тело из слитых операторов
+        L.native = true;
+        for (size_t s = 0; s + 1 < stmts.size() && L.native; ++s)
+        {
+            const int p = stmts[s];
+            if (decoded[p].kind == ST_SEMI)
+                continue;
+            if (decoded[p].kind != ST_FUSED)
             {
-                // операторы одиночного символа тоже отдельные токены
-                flushBuffer();
-                char op[2] = {*program, '\0'};
-                words.push_back(INTERN().intern(op));
-                ++program;
+                L.native = false;
+                break;
             }
-            else
+            const Fused &f = fused[decoded[p].fused];
+            auto reads = [&](const FuseOperand &o)
             {
-                // часть обычного идентификатора/числа/слова
-                if (bufIndex < (int)sizeof(buffer) - 1)
-                    buffer[bufIndex++] = *program;
-                ++program;
+                return (o.kind == FO_VAR && sameCell(ref(o.word), i)) ||
+                       (o.kind == FO_ELEM && o.index >= 0 && sameCell(ref(o.index), i));
+            };
+            CountedStmt cs;
+            cs.fused = decoded[p].fused;
+            cs.reads = reads(f.a) || reads(f.b) || reads(f.dst);
+            L.body.push_back(cs);
+        }
+        if (!L.native)
+            L.body.clear();
+        else if (!limitVar && L.body.size() <= (size_t)CountedLoop::kUnrollMaxBody && L.step == std::floor(L.step))
+        {
+            for (int u = 0; u < CountedLoop::kUnroll; ++u)
+                for (CountedStmt cs : L.body)
+                {
+                    cs.off = u;
+                    L.unrolled.push_back(cs);
+                }
+        }
+        return true;
+    }
+
+    void findCountedLoops()
+    {
+        countedLoops.clear();
+        countedAt.assign(words.size() + 1, -1);
+        if (isHalted)
+            return;
+        for (int w = 0; w < (int)words.size(); ++w)
+        {
+            CountedLoop L;
+            if (decoded[w].kind != ST_WHILE || fusedCond[w] < 0 || !matchCounted(w, L))
+                continue;
+            countedAt[w] = (int)countedLoops.size();
+            decoded[L.stepWord].kind = ST_STEP;
+            decoded[L.stepWord].loop = (int)countedLoops.size();
+            ++fuseReport.counted;
+            fuseReport.native += L.native ? 1 : 0;
+            fuseReport.unrolled += L.unrolled.empty() ? 0 : 1;
+            countedLoops.push_back(std::move(L));
+        }
+    }
+
+    // Статическое разрешение имён (те же правила, что у компилятора ВМ):
+    // VAR в блоке затеняет внешнюю, процедура видит свои локальные и
+    // верхний уровень main. Каждому слову-имени — ячейка кадра.
+    // keep — сюда переносится итог разрешения (для записи в .lcb)
+    void resolveSlots(Resolution *keep = nullptr)
+    {
+        kernels.clear();
+        loopKernel.assign(words.size() + 1, -1);
+
+        Compiler resolver(words, tokens, *S);
+        Resolution res;
+        if (!resolver.resolve(res))
+        {
+            currentWord = resolver.errorWord;
+            printError(resolver.error.c_str());
+            currentWord = 0;
+            halt();
+            return;
+        }
+        applyResolution(res);
+        if (keep)
+            *keep = std::move(res);
+    }
+
+    void applyResolution(Resolution &res)
+    {
+        loopKernel.assign(words.size() + 1, -1);
+        wordRef.assign(words.size(), SlotRef());
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            wordRef[i].name = words[i];
+            const int d = res.wordDecl[i];
+            if (d < 0)
+                continue;
+            const VarDecl &decl = res.decls[d];
+            wordRef[i].slot = decl.slot;
+            wordRef[i].global = (decl.func == 0);
+            wordRef[i].isConst = decl.isConst;
+            wordRef[i].isArray = decl.isArray;
+            wordRef[i].known = res.wordKnown[i] != 0;
+            wordRef[i].value = res.wordValue[i];
+            wordRef[i].inRange = res.wordInRange[i] != 0;
+        }
+
+        for (auto &kv : procs)
+        {
+            auto it = res.procIndex.find(kv.first);
+            if (it == res.procIndex.end())
+                continue;
+            kv.second.frameVars = res.frameVars[it->second];
+            kv.second.frameArrs = res.frameArrs[it->second];
+        }
+
+        kernels = res.kernels;
+        for (size_t k = 0; k < kernels.size(); ++k)
+            loopKernel[kernels[k].whileWord] = (int)k;
+        const std::string prefix = closurePrefix();
+        buildHoists(res.hoists, prefix);
+        buildCse(res.cse, prefix);
+        buildCalls(res.calls, prefix);
+
+        control.reset(res.frameVars[0], res.frameArrs[0]);
+        // стеки кадров и вложенности — сразу на всю глубину вызовов
+        int procVars = 0, procArrs = 0;
+        for (size_t f = 1; f < res.frameVars.size(); ++f)
+        {
+            procVars = std::max(procVars, res.frameVars[f]);
+            procArrs = std::max(procArrs, res.frameArrs[f]);
+        }
+        control.reserveFrames(maxCallDepth, procVars, procArrs);
+        deepStack.reserve(maxCallDepth);
+    }
+
+    // Начало имён замыканий: с него не начинается ни одно слово программы
+    std::string closurePrefix() const
+    {
+        std::string prefix = "lilc_";
+        for (bool clash = true; clash;)
+        {
+            clash = false;
+            for (const char *w : words)
+                clash = clash || std::strncmp(w, prefix.c_str(), prefix.size()) == 0;
+            if (clash)
+                prefix += 'x';
+        }
+        return prefix;
+    }
+
+    void buildHoists(std::vector<LoopHoist> &list, const std::string &prefix)
+    {
+        std::stable_sort(list.begin(), list.end(),
+                         [](const LoopHoist &a, const LoopHoist &b) { return a.whileWord < b.whileWord; });
+        hoists.reserve(list.size());
+        for (const LoopHoist &l : list)
+        {
+            if (l.calls)
+                continue;
+            Hoist h;
+            h.owner = this;
+            h.whileWord = l.whileWord;
+            h.from = l.from;
+            h.to = l.to;
+            h.name = prefix + "h" + std::to_string(hoists.size());
+            hoistAt[l.from] = (int)hoists.size();
+            if (loopHoist[l.whileWord] < 0)
+                loopHoist[l.whileWord] = (int)hoists.size();
+            hoists.push_back(std::move(h));
+        }
+    }
+
+    void buildCse(const std::vector<CseGroup> &list, const std::string &prefix)
+    {
+        cses.reserve(list.size());
+        for (const CseGroup &g : list)
+        {
+            const int id = (int)cses.size();
+            CseValue c;
+            c.owner = this;
+            c.from = g.from[0];
+            c.to = g.to[0];
+            c.elem = g.elem;
+            c.indexFrom = g.indexFrom;
+            c.indexTo = g.indexTo;
+            c.name = prefix + "c" + std::to_string(id);
+            for (size_t k = 0; k < g.from.size(); ++k)
+            {
+                cseAt[g.from[k]] = id;
+                cseEnd[g.from[k]] = g.to[k];
             }
+            if (g.store >= 0)
+                storeCse[g.store] = id;
+            cses.push_back(std::move(c));
         }
+    }
 
-        // последний буфер
-        flushBuffer();
+    void buildCalls(const std::vector<CallWords> &list, const std::string &prefix)
+    {
+        procCalls.clear();
+        procCalls.reserve(list.size());
+        for (const CallWords &w : list)
+        {
+            ProcCall c;
+            c.owner = this;
+            c.proc = findPROC(words[w.word]);
+            c.word = w.word;
+            c.close = w.close;
+            c.tail = w.tail;
+            for (size_t k = 0; k < w.from.size(); ++k)
+            {
+                if (w.isArray[k])
+                    c.arrays.push_back(w.from[k]);
+                else
+                {
+                    c.from.push_back(w.from[k]);
+                    c.to.push_back(w.to[k]);
+                }
+            }
+            c.name = prefix + "p" + std::to_string(procCalls.size());
+            callAt[w.word] = (int)procCalls.size();
+            procCalls.push_back(std::move(c));
+        }
+    }
+
+    void parseProgram(const char *prog, size_t len)
+    {
+        Lexer lexer(*S, INTERN(), texts);
+        lexer.run(prog, len, words);
+    }
+
+    void loadSource(const char *prog, size_t len, Resolution *keep = nullptr)
+    {
+        beginLoad();
+        sourceHash = 0;
+        sourceHashed = false;
+        sourceSize = len;
+        parseProgram(prog, len);
+        finishLoad(true, nullptr, keep);
+    }
+
+    void beginLoad()
+    {
+        static bool syms_inited = false;
+        if (!syms_inited)
+        {
+            SYM().init(INTERN());
+            syms_inited = true;
+        }
+        S = &SYM();
 
-        // пост проход. Убираем !, = в !=
-        for (size_t i = 0; i + 1 < words.size();)
+        words.clear();
+        texts.clear();
+        image.close();
+        clearExprCache();
+    }
+
+    // Разбор после слов. parseTables = false — токены, пары и процедуры
+    // уже восстановлены из .lcb, restored — разрешение имён оттуда же
+    void finishLoad(bool parseTables, Resolution *restored = nullptr, Resolution *keep = nullptr)
+    {
+        hoistAt.assign(words.size() + 1, -1);
+        loopHoist.assign(words.size() + 1, -1);
+        cseAt.assign(words.size() + 1, -1);
+        cseEnd.assign(words.size() + 1, -1);
+        storeCse.assign(words.size() + 1, -1);
+        callAt.assign(words.size() + 1, -1);
+        currentWord = 0;
+        isHalted = false;
+        control = controller(); // создаём новый контроллер
+        bytecodeReady = false;
+        aotReady = false;
+        if (parseTables)
         {
-            if (words[i] == S->NOT && words[i + 1] == S->EQ)
+            if (!tokens.build(words, *S))
             {
-                words[i] = S->NEQ;
-                words.erase(words.begin() + (i + 1));
+                printError(tokens.lastError().c_str());
+                halt();
             }
-            else
+            buildMatchTable();
+            if (!isHalted)
+                buildProcTable();
+        }
+        if (!isHalted && restored)
+            applyResolution(*restored);
+        else if (!isHalted)
+            resolveSlots(keep);
+        decodeStatements();
+        fuseStatements();
+        findCountedLoops();
+
+        jitBypass = -1;
+        loopHits.assign(words.size() + 1, 0);
+        jitIndex.assign(words.size() + 1, -1);
+#ifdef LILC_JIT
+        jitLoops.clear();
+#endif
+    }
+
+    // Текст loadProgram после загрузки не хранится: для образа без хеша
+    // исходника берётся хеш слов — только когда образ записывается
+    uint64_t programHash() const
+    {
+        uint64_t h = lilcHash("", 0);
+        for (Id w : words)
+            h = lilcHash(w, std::strlen(w) + 1, h);
+        return h;
+    }
+
+    // Сборка, чей разбор лежит в образе: ядра, вынос инвариантов и прочее
+    // зависят от флагов LILC_NO_* и набора операций. Образ другой сборки
+    // не подходит
+    static uint64_t imageConfig()
+    {
+        const char *flags = ""
+#ifdef LILC_NO_VECLOOP
+                            " NO_VECLOOP"
+#endif
+#ifdef LILC_NO_LICM
+                            " NO_LICM"
+#endif
+#ifdef LILC_NO_INLINE
+                            " NO_INLINE"
+#endif
+#ifdef LILC_NO_FUSION
+                            " NO_FUSION"
+#endif
+#ifdef LILC_NO_COMPUTED_GOTO
+                            " NO_COMPUTED_GOTO"
+#endif
+#ifdef LILC_NO_JIT
+                            " NO_JIT"
+#endif
+            ;
+        const uint32_t layout[] = {OP_COUNT, V_STORE + 1u, sizeof(VecInstr), sizeof(VecRef), sizeof(LoopHoist)};
+        const uint64_t h = lilcHash(flags, std::strlen(flags));
+        return lilcHash(reinterpret_cast<const char *>(layout), sizeof(layout), h);
+    }
+
+    bool saveImage(const char *path, const Resolution &res) const
+    {
+        if (isHalted || words.empty())
+            return false;
+        LcbData d;
+        d.sourceHash = sourceHashed ? sourceHash : programHash();
+        d.sourceSize = sourceSize;
+        d.config = imageConfig();
+
+        // Номер строки для каждого различного слова. Текст строки — слово
+        // после открывающей кавычки (так их выдаёт лексер)
+        std::unordered_map<Id, uint32_t, PtrHash> index;
+        auto add = [&](size_t i, bool text)
+        {
+            auto it = index.find(words[i]);
+            d.words[i] = it != index.end() ? it->second : index[words[i]] = d.addString(words[i], text);
+        };
+        const size_t n = words.size();
+        d.words.resize(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            add(i, false);
+            if (words[i] == S->QUOTE && i + 1 < n)
             {
-                ++i;
+                add(++i, true);
+                if (i + 1 < n && words[i + 1] == S->QUOTE)
+                    add(++i, false);
             }
         }
+
+        for (const Token &t : tokens.tokenArray())
+            d.tokens.push_back(t.bits);
+        d.numbers = tokens.numberTable();
+        for (Id w : tokens.nameTable())
+            d.names.push_back(index.at(w));
+        d.match.assign(matchWord.begin(), matchWord.end());
+        for (const auto &p : procs)
+            d.procs.push_back(LcbProc{index.at(p.first), p.second.nameWord, p.second.openBrace,
+                                      p.second.closeBrace, p.second.params});
+        LcbWriter out(d.resolution);
+        writeResolution(out, res, index);
+        return lcbWriteFile(path, d.encode());
+    }
+
+    // Разрешение имён: объявления без имён, процедуры — номерами строк
+    void writeResolution(LcbWriter &out, const Resolution &res,
+                         const std::unordered_map<Id, uint32_t, PtrHash> &index) const
+    {
+        out.put(res.wordDecl);
+        out.put(res.wordKnown);
+        out.put(res.wordValue);
+        out.put(res.wordInRange);
+        out.put((uint32_t)res.decls.size());
+        for (const VarDecl &d : res.decls)
+        {
+            out.put(d.func);
+            out.put(d.slot);
+            out.put(d.isArray);
+            out.put(d.isConst);
+        }
+        out.put(res.frameVars);
+        out.put(res.frameArrs);
+        out.put((uint32_t)res.procIndex.size());
+        for (const auto &p : res.procIndex)
+        {
+            out.put(index.at(p.first));
+            out.put(p.second);
+        }
+        out.put((uint32_t)res.kernels.size());
+        for (const VecKernel &k : res.kernels)
+        {
+            out.put(k.whileWord);
+            out.put(k.counter);
+            out.put(k.limitVar);
+            out.put(k.limitConst);
+            out.put(k.inclusive);
+            out.put(k.arrays);
+            out.put(k.scalars);
+            out.put(k.consts);
+            out.put(k.code);
+        }
+        out.put(res.hoists);
+        out.put((uint32_t)res.cse.size());
+        for (const CseGroup &g : res.cse)
+        {
+            out.put(g.from);
+            out.put(g.to);
+            out.put(g.elem);
+            out.put(g.indexFrom);
+            out.put(g.indexTo);
+            out.put(g.store);
+        }
+        out.put((uint32_t)res.calls.size());
+        for (const CallWords &c : res.calls)
+        {
+            out.put(c.word);
+            out.put(c.func);
+            out.put(c.close);
+            out.put(c.tail);
+            out.put(c.from);
+            out.put(c.to);
+            out.put(c.isArray);
+        }
+    }
+
+    // Обратное к writeResolution; false — данные не сходятся с программой
+    bool readResolution(LcbReader &in, Resolution &res, const std::vector<Id> &ids) const
+    {
+        const size_t n = words.size();
+        auto word = [n](int w) { return w >= 0 && (size_t)w <= n; };
+        uint32_t count = 0;
+
+        in.get(res.wordDecl);
+        in.get(res.wordKnown);
+        in.get(res.wordValue);
+        in.get(res.wordInRange);
+        in.get(count);
+        res.decls.resize(in.ok() ? count : 0);
+        for (VarDecl &d : res.decls)
+        {
+            in.get(d.func);
+            in.get(d.slot);
+            in.get(d.isArray);
+            in.get(d.isConst);
+        }
+        in.get(res.frameVars);
+        in.get(res.frameArrs);
+        in.get(count);
+        for (uint32_t k = 0; in.ok() && k < count; ++k)
+        {
+            uint32_t name = 0;
+            int func = 0;
+            in.get(name);
+            in.get(func);
+            if (name >= ids.size() || func < 0 || (size_t)func >= res.frameVars.size())
+                return false;
+            res.procIndex[ids[name]] = func;
+        }
+        in.get(count);
+        res.kernels.resize(in.ok() ? count : 0);
+        for (VecKernel &k : res.kernels)
+        {
+            in.get(k.whileWord);
+            in.get(k.counter);
+            in.get(k.limitVar);
+            in.get(k.limitConst);
+            in.get(k.inclusive);
+            in.get(k.arrays);
+            in.get(k.scalars);
+            in.get(k.consts);
+            in.get(k.code);
+            if (!word(k.whileWord))
+                return false;
+        }
+        in.get(res.hoists);
+        for (const LoopHoist &l : res.hoists)
+            if (!word(l.whileWord) || !word(l.from))
+                return false;
+        in.get(count);
+        res.cse.resize(in.ok() ? count : 0);
+        for (CseGroup &g : res.cse)
+        {
+            in.get(g.from);
+            in.get(g.to);
+            in.get(g.elem);
+            in.get(g.indexFrom);
+            in.get(g.indexTo);
+            in.get(g.store);
+            if (g.from.empty() || g.from.size() != g.to.size() || (g.store != -1 && !word(g.store)))
+                return false;
+            for (int w : g.from)
+                if (!word(w))
+                    return false;
+        }
+        in.get(count);
+        res.calls.resize(in.ok() ? count : 0);
+        for (CallWords &c : res.calls)
+        {
+            in.get(c.word);
+            in.get(c.func);
+            in.get(c.close);
+            in.get(c.tail);
+            in.get(c.from);
+            in.get(c.to);
+            in.get(c.isArray);
+            if (!word(c.word) || (size_t)c.word == n || c.from.size() != c.to.size() ||
+                c.from.size() != c.isArray.size())
+                return false;
+        }
+        if (!in.ok() || !in.atEnd() || res.frameVars.empty() || res.frameVars.size() != res.frameArrs.size() ||
+            res.wordDecl.size() != n || res.wordKnown.size() != n || res.wordValue.size() != n ||
+            res.wordInRange.size() != n)
+            return false;
+        for (int d : res.wordDecl)
+            if (d < -1 || d >= (int)res.decls.size())
+                return false;
+        return true;
+    }
+
+    // Таблицы из образа с проверкой номеров
+    bool restoreCompiled(const LcbImage &img, Resolution &res)
+    {
+        const LcbHeader &h = img.header();
+        std::vector<Id> ids(h.strings);
+        for (uint32_t s = 0; s < h.strings; ++s)
+        {
+            const LcbString &e = img.strings()[s];
+            ids[s] = e.text ? img.text(s) : INTERN().intern(std::string_view(img.text(s), e.length));
+        }
+
+        const int n = (int)h.words;
+        const uint32_t *w = img.words();
+        words.resize(n);
+        for (int i = 0; i < n; ++i)
+        {
+            if (w[i] >= h.strings)
+                return false;
+            words[i] = ids[w[i]];
+        }
+
+        std::vector<Id> names(h.names);
+        for (uint32_t k = 0; k < h.names; ++k)
+        {
+            if (img.names()[k] >= h.strings)
+                return false;
+            names[k] = ids[img.names()[k]];
+        }
+        if (!tokens.assign(img.tokens(), n, img.numbers(), h.numbers, std::move(names)))
+            return false;
+
+        const int32_t *m = img.match();
+        matchWord.assign(m, m + n);
+        for (int i = 0; i < n; ++i)
+            if (matchWord[i] < -1 || matchWord[i] >= n)
+                return false;
+
+        procs.clear();
+        for (uint32_t k = 0; k < h.procs; ++k)
+        {
+            const LcbProc &p = img.procs()[k];
+            auto in = [n](int32_t x) { return x >= 0 && x < n; };
+            if (p.name >= h.strings || !in(p.nameWord) || !in(p.openBrace) || !in(p.closeBrace))
+                return false;
+            ProcInfo info;
+            info.nameWord = p.nameWord;
+            info.openBrace = p.openBrace;
+            info.closeBrace = p.closeBrace;
+            info.params = p.params;
+            procs[ids[p.name]] = info;
+        }
+        LcbReader in(img.resolution(), img.header().resolutionBytes);
+        return readResolution(in, res, ids);
     }
 };
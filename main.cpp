@@ -3,50 +3,40 @@
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include "lilc.cpp"
 #include <chrono>
 
-const char *loadFile(const char *filename)
+int main(int argc, char *argv[])
 {
-    FILE *file = std::fopen(filename, "rb"); // Открываем в бинарном режиме
-    if (!file)
+    // test [файл.lc] [--vm | --aot] [--no-jit] [--no-cache]
+    const char *path = "LILC_PROG/prog2.lc";
+    lilc::Engine engine = lilc::ENGINE_TICK;
+    bool jit = true;
+    bool cache = true;
+    for (int i = 1; i < argc; ++i)
     {
-        std::perror("Ошибка при открытии файла");
-        return nullptr;
+        if (std::strcmp(argv[i], "--vm") == 0)
+            engine = lilc::ENGINE_VM;
+        else if (std::strcmp(argv[i], "--aot") == 0)
+            engine = lilc::ENGINE_AOT;
+        else if (std::strcmp(argv[i], "--no-jit") == 0)
+            jit = false;
+        else if (std::strcmp(argv[i], "--no-cache") == 0)
+            cache = false;
+        else
+            path = argv[i];
     }
 
-    // Узнаём размер файла
-    std::fseek(file, 0, SEEK_END);
-    long size = std::ftell(file);
-    std::rewind(file);
-
-    // Выделяем память (+1 байт под '\0')
-    char *buffer = (char *)std::malloc(size + 1);
-    if (!buffer)
-    {
-        std::fclose(file);
-        std::fprintf(stderr, "Не удалось выделить память\n");
-        return nullptr;
-    }
-
-    // Читаем файл в буфер
-    size_t readBytes = std::fread(buffer, 1, size, file);
-    buffer[readBytes] = '\0'; // Добавляем null-терминатор
-
-    std::fclose(file);
-    return buffer; // Возвращаем указатель (нужно будет освободить вручную!)
-}
-
-
-int main(int argc, char *argv[])
-{
-    const char *text = loadFile("LILC_PROG/prog2.lc");
     lilc interpreter;
+    interpreter.setEngine(engine);
+    interpreter.setJit(jit);
+    interpreter.setCodeCache(cache);
 
-
-    if (text)
+    if (!interpreter.loadFile(path))
+        std::perror("Ошибка при открытии файла");
+    else
     {
-        interpreter.loadProgram(text);
         //interpreter.printWords();
 
        
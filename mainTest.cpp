@@ -5,6 +5,12 @@
 #include <cstdlib>
 #include "lilc.cpp"
 #include <chrono>
+#include <initializer_list>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 const char *loadFile(const char *filename)
 {
@@ -55,10 +61,569 @@ void calc()
     }
 }
 
+// Цена диспетчеризации движка tick: короткие операторы, почти без работы.
+// Шаг i — не последним: иначе это счётный цикл и он идёт одним оператором
+const char *dispatchProg =
+    "VAR i = 0; VAR x = 0; VAR y = 0;"
+    "WHILE (i < 300000) { i = i + 1; x = 1; y = x; ; }";
+
+void dispatchBench()
+{
+    {
+        // tick() на каждый оператор — switch по предекодированному виду
+        lilc interpreter;
+        interpreter.setJit(false); // меряем именно диспетчеризацию
+        interpreter.loadProgram(dispatchProg);
+        long steps = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        while (!interpreter.isHalted)
+        {
+            interpreter.tick();
+            ++steps;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::nano> duration = end - start;
+        std::cout << "tick() loop: " << duration.count() / steps << " ns/stmt (" << steps << " stmts)" << std::endl;
+    }
+    {
+        // interpretate() — шитый код (computed goto) на GCC/Clang
+        lilc interpreter;
+        interpreter.setJit(false); // меряем именно диспетчеризацию
+        interpreter.loadProgram(dispatchProg);
+        auto start = std::chrono::high_resolution_clock::now();
+        interpreter.interpretate();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::nano> duration = end - start;
+        long steps = interpreter.executedStatements();
+        std::cout << "interpretate(): " << duration.count() / steps << " ns/stmt (" << steps << " stmts)" << std::endl;
+    }
+}
+
+// Цена вызова процедуры в ВМ: маленькая процедура в горячем цикле
+const char *callProg =
+    "VAR i = 0; VAR x = 0;"
+    "WHILE (i < 1000000) { step; i = i + 1; }"
+    "PROC step { x = x + i * 2; IF (x > 1000) { x = x - 1000; } }";
+
+void callBench()
+{
+    for (int run = 0; run < 2; ++run)
+    {
+        lilc interpreter;
+        interpreter.setEngine(lilc::ENGINE_VM);
+        InlinePolicy policy;
+        if (run == 0)
+            policy.maxStatements = 0;
+        interpreter.setInlining(policy);
+        interpreter.loadProgram(callProg);
+        auto start = std::chrono::high_resolution_clock::now();
+        interpreter.interpretate();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> duration = end - start;
+        std::cout << (run ? "VM calls (inlined): " : "VM calls: ") << duration.count() << " ms" << std::endl;
+    }
+}
+
+const char *engineName(lilc::Engine engine)
+{
+    return engine == lilc::ENGINE_VM ? "VM" : engine == lilc::ENGINE_AOT ? "AOT" : "tick";
+}
+
+// Время одной программы на каждом из движков
+void benchEngines(const char *label, const char *prog, std::initializer_list<lilc::Engine> engines)
+{
+    for (lilc::Engine engine : engines)
+    {
+        lilc interpreter;
+        interpreter.setEngine(engine);
+        interpreter.loadProgram(prog);
+        auto start = std::chrono::high_resolution_clock::now();
+        interpreter.interpretate();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> duration = end - start;
+        std::cout << engineName(engine) << " " << label << ": " << duration.count() << " ms" << std::endl;
+    }
+}
+
+// Проверка вывода: программа печатает одно и то же на всех движках,
+// tick — и с JIT, и без него (вывод обоих совпадает целиком)
+int failedChecks = 0;
+
+std::string runOutput(const char *prog, lilc::Engine engine, bool jit)
+{
+    std::string out;
+    lilc interpreter;
+    interpreter.setEngine(engine);
+    interpreter.setJit(jit);
+    interpreter.printOut = [&out](const std::string &text)
+    { out += text; };
+    interpreter.loadProgram(prog);
+    interpreter.interpretate();
+    return out;
+}
+
+void reportCheck(const char *engine, const char *label, bool ok)
+{
+    if (!ok)
+        ++failedChecks;
+    std::cout << "check " << engine << " " << label << ": " << (ok ? "ok" : "FAILED") << std::endl;
+}
+
+void checkEngines(const char *label, const char *prog, const char *expected)
+{
+    const std::string tick = runOutput(prog, lilc::ENGINE_TICK, true);
+    const std::string noJit = runOutput(prog, lilc::ENGINE_TICK, false);
+    reportCheck("tick", label, tick.find(expected) != std::string::npos);
+    reportCheck("tick (no JIT)", label, noJit == tick);
+    for (lilc::Engine engine : {lilc::ENGINE_VM, lilc::ENGINE_AOT})
+        reportCheck(engineName(engine), label, runOutput(prog, engine, true).find(expected) != std::string::npos);
+}
+
+// PRINT одного числа, константы pi и выражения
+const char *printExprProg =
+    "VAR x = 4; PRINT 2; PRINT \" \"; PRINT 2.5; PRINT \" \"; PRINT x + 1; PRINT \" \"; PRINTLN pi;";
+
+// Сравнения и && || в аргументах функций и процедур
+const char *argCompareProg =
+    "VAR w = 3; VAR a = pow(2, 1 < w) + p0(1, 2 != w && w < 5);"
+    "PRINT \"a=\"; PRINTLN a;"
+    "PROC p0(u, v) { RETURN u + v * 10; }";
+
+// Значение процедуры в выражении, рекурсия
+const char *factProg =
+    "PRINT \"fact=\"; PRINTLN fact(10);"
+    "PROC fact(n) { IF (n <= 1) { RETURN 1; } RETURN n * fact(n - 1); }";
+
+// Левый операнд читается до вызова в правом, даже если процедура его пишет
+const char *callOrderProg =
+    "VAR x = 1; VAR r = x + setx(5); x = 1; x = x + setx(9);"
+    "PRINT \"r=\"; PRINT r; PRINT \" x=\"; PRINTLN x;"
+    "PROC setx(v) { x = v; RETURN v; }";
+
+// Хвостовой вызов не растит стек; глубина 4001 — переполнение
+const char *tailSumProg =
+    "PRINT \"sum=\"; PRINTLN sumTo(100000, 0);"
+    "PROC sumTo(n, acc) { IF (n == 0) { RETURN acc; } RETURN sumTo(n - 1, acc + n); }";
+
+const char *deepCallProg =
+    "PRINTLN depth(4000);"
+    "PROC depth(n) { IF (n == 0) { RETURN 0; } RETURN depth(n - 1) + 1; }";
+
+// CONTINUE пропускает 5, BREAK выходит после 10: 1 + ... + 10 - 5
+const char *breakProg =
+    "VAR i = 0; VAR s = 0;"
+    "WHILE (i < 100) { i = i + 1; IF (i == 5) { CONTINUE; } IF (i > 10) { BREAK; } s = s + i; }"
+    "PRINT \"s=\"; PRINTLN s;";
+
+// Таблица процедур: вызовы по имени, ошибки повторного и неизвестного PROC
+const char *procTableProg =
+    "VAR s = 0; one; two; s = s + three(4);"
+    "PRINT \"s=\"; PRINTLN s;"
+    "PROC one { s = s + 1; } PROC two { one; s = s * 10; } PROC three(n) { RETURN n * 100; }";
+
+// Таблица парных скобок: вложенные IF/ELSE в WHILE и ошибки при загрузке
+const char *blocksProg =
+    "VAR i = 0; VAR s = 0;"
+    "WHILE (i < 6) { IF (i < 3) { IF (i == 1) { s = s + 10; } ELSE { s = s + 1; } }"
+    " ELSE { s = s + (i * (2 + 1)); } i = i + 1; }"
+    "PRINT \"s=\"; PRINTLN s;";
+
+// Слитые операторы в цикле; выход за массив в слитом — общий путь и его ошибка
+const char *fusionProg =
+    "VAR a[10]; VAR b[10]; VAR i = 0; VAR x = 0; VAR y = 2;"
+    "WHILE (i < 10) { a[i] = i * y; b[i] = a[i] + 1; x = x + 1; i = i + 1; }"
+    "i = 0; VAR s = 0;"
+    "WHILE (i < 10) { s = s + b[i]; i = i + 1; }"
+    "PRINT \"s=\"; PRINT s; PRINT \" x=\"; PRINTLN x;";
+
+const char *fusionRangeProg =
+    "VAR a[10]; VAR i = 10; VAR y = 0; y = a[i] + 1;";
+
+// Свёртка при загрузке: CONST подставляется, запись в него — предупреждение
+const char *foldProg =
+    "CONST VAR k = 2 * 3 + 1;"
+    "VAR x = k * (4 - 2) + -(3 - 5) + pow(2, 3);"
+    "VAR c = 0; IF (2 < 3 && k == 7) { c = 1; }"
+    "k = 9;"
+    "PRINT \"x=\"; PRINT x; PRINT \" c=\"; PRINT c; PRINT \" k=\"; PRINTLN k;";
+
+// Повторы a[i] и (y + i) считаются один раз; вызов между (x + 1) их разделяет
+const char *cseProg =
+    "VAR a[8]; VAR i = 0; VAR s = 0; VAR y = 3;"
+    "WHILE (i < 8) { a[i] = i + 1; i = i + 1; }"
+    "i = 0;"
+    "WHILE (i < 8) { a[i] = a[i] * a[i] + a[i]; s = s + (y + i) * (y + i) - a[i]; i = i + 1; }"
+    "VAR x = 1; VAR r = (x + 1) + setx(5) + (x + 1);"
+    "PRINT \"s=\"; PRINT s; PRINT \" a=\"; PRINT a[7]; PRINT \" r=\"; PRINTLN r;"
+    "PROC setx(v) { x = v; RETURN v; }";
+
+// Инвариант k * 3 выносится; (k - i) меняется; во втором цикле k пишется
+const char *licmProg =
+    "VAR i = 0; VAR k = 10; VAR s = 0; VAR t = 0;"
+    "WHILE (i < 100) { s = s + k * 3 + i; t = t + (k - i) * 2; i = i + 1; }"
+    "VAR j = 0; VAR u = 0;"
+    "WHILE (j < 100) { u = u + k * 2; k = k + 1; j = j + 1; }"
+    "PRINT \"s=\"; PRINT s; PRINT \" t=\"; PRINT t; PRINT \" u=\"; PRINTLN u;";
+
+// Инвариант вынесен во внешний цикл, а JIT компилирует внутренний
+const char *licmNestedProg =
+    "VAR x = 1; VAR z = 0; VAR c1 = 0;"
+    "WHILE (c1 < 16) { VAR c2 = 0; WHILE (c2 < 16) { x = z * 3 + 2; c2 = c2 + 1; } c1 = c1 + 1; }"
+    "PRINT \"x=\"; PRINTLN x;";
+
+// Программа из .lcb — сохранённой saveCompiled и взятой loadFile из кэша —
+// печатает то же, что из исходника
+const char *imageProg =
+    "CONST VAR n = 2 * 4; VAR a[8]; VAR i = 0; VAR s = 0;"
+    "WHILE (i < n) { a[i] = sq(i) + 1; i = i + 1; }"
+    "i = 0; WHILE (i < n) { IF (a[i] > 10) { s = s + a[i]; } ELSE { s = s - 1; } i = i + 1; }"
+    "PRINT \"s=\"; PRINTLN s;"
+    "PROC sq(v) { RETURN v * v; }";
+
+std::string runImage(const char *image, lilc::Engine engine, bool jit)
+{
+    std::string out;
+    lilc interpreter;
+    interpreter.setEngine(engine);
+    interpreter.setJit(jit);
+    interpreter.printOut = [&out](const std::string &text)
+    { out += text; };
+    if (!interpreter.loadCompiled(image))
+        return "not loaded";
+    interpreter.interpretate();
+    return out;
+}
+
+void checkImage(const char *label, const char *prog, const char *expected)
+{
+    const char *path = "lilc_check_image.lc";
+    const char *image = "lilc_check_image.lcb";
+    FILE *f = std::fopen(path, "wb");
+    if (!f)
+        return;
+    std::fputs(prog, f);
+    std::fclose(f);
+
+    lilc source;
+    source.setCodeCache(false);
+    reportCheck("saveCompiled", label, source.loadFile(path) && source.saveCompiled(image));
+    const std::string tick = runImage(image, lilc::ENGINE_TICK, true);
+    reportCheck("tick .lcb", label, tick.find(expected) != std::string::npos);
+    reportCheck("tick (no JIT) .lcb", label, runImage(image, lilc::ENGINE_TICK, false) == tick);
+    for (lilc::Engine engine : {lilc::ENGINE_VM, lilc::ENGINE_AOT})
+        reportCheck((std::string(engineName(engine)) + " .lcb").c_str(), label,
+                    runImage(image, engine, true).find(expected) != std::string::npos);
+
+    // первый loadFile пишет образ в кэш, второй берёт его оттуда
+    for (int run = 0; run < 2; ++run)
+    {
+        std::string out;
+        lilc cached;
+        cached.printOut = [&out](const std::string &text)
+        { out += text; };
+        cached.loadFile(path);
+        cached.interpretate();
+        reportCheck(run ? "tick cache hit" : "tick cache miss", label, out.find(expected) != std::string::npos);
+    }
+    std::remove(path);
+    std::remove(image);
+}
+
+// Глубина выше родного стека: tick останавливается с ошибкой, а не падает
+void checkNativeStack()
+{
+    std::string out;
+    lilc interpreter;
+    interpreter.setMaxCallDepth(200000);
+    interpreter.printOut = [&out](const std::string &text)
+    { out += text; };
+    interpreter.loadProgram("PRINTLN k(20000); PROC k(n) { IF (n == 0) { RETURN 0; } RETURN 1 + k(n - 1); }");
+    interpreter.interpretate();
+    reportCheck("tick", "native stack", out.find("20000.000000\n") != std::string::npos ||
+                                            out.find("Call stack overflow") != std::string::npos);
+}
+
+// Вызовы с аргументами и значением: рекурсивный fib в выражении
+const char *argCallProg =
+    "VAR r = fib(22);"
+    "PROC fib(n) { IF (n < 2) { RETURN n; } RETURN fib(n - 1) + fib(n - 2); }";
+
+// Хвостовая рекурсия: миллион вызовов в одном кадре
+const char *tailCallProg =
+    "VAR r = sumTo(1000000, 0);"
+    "PROC sumTo(n, acc) { IF (n == 0) { RETURN acc; } RETURN sumTo(n - 1, acc + n); }";
+
+// Большой сгенерированный скрипт: память потока токенов, загрузка и исполнение
+std::string tokenBenchProg(int statements)
+{
+    std::string prog = "VAR v0 = 1; VAR a[16];";
+    for (int k = 1; k < statements; ++k)
+    {
+        const std::string v = "v" + std::to_string(k);
+        const std::string p = "v" + std::to_string(k - 1);
+        prog += "VAR " + v + " = " + p + " * 0.5 + " + std::to_string(k % 97) + ".25;";
+        prog += "a[" + std::to_string(k % 16) + "] = " + v + " - a[" + std::to_string((k + 1) % 16) + "] / 3;";
+    }
+    return prog;
+}
+
+void tokenBench()
+{
+    const std::string prog = tokenBenchProg(20000);
+    const lilc::Engine engines[] = {lilc::ENGINE_TICK, lilc::ENGINE_VM};
+    for (lilc::Engine engine : engines)
+    {
+        lilc interpreter;
+        interpreter.setEngine(engine);
+        auto start = std::chrono::high_resolution_clock::now();
+        interpreter.loadProgram(prog.c_str());
+        auto loaded = std::chrono::high_resolution_clock::now();
+        interpreter.interpretate();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> load = loaded - start;
+        std::chrono::duration<double, std::milli> run = end - loaded;
+        if (engine == lilc::ENGINE_TICK)
+            std::cout << "Tokens: " << interpreter.tokenBytes() / 1024 << " KB packed vs "
+                      << interpreter.wordBytes() / 1024 << " KB of word pointers" << std::endl;
+        std::cout << (engine == lilc::ENGINE_VM ? "VM big script: " : "tick big script: ")
+                  << "load " << load.count() << " ms, run " << run.count() << " ms" << std::endl;
+    }
+}
+
+// Скорость лексера на скриптах в несколько МБ: таблица классов и AVX2.
+// В коротких словах время уходит на интернирование, в длинных строках и
+// отступах — на сам просмотр байтов
+std::string lexerBenchText(int lines)
+{
+    std::string prog;
+    const std::string text(160, 'x');
+    for (int k = 0; k < lines; ++k)
+        prog += "                PRINTLN \"" + text + std::to_string(k % 50) + "\";\n";
+    return prog;
+}
+
+void lexerBench()
+{
+    const std::string progs[] = {tokenBenchProg(100000), lexerBenchText(40000)};
+    const char *names[] = {"statements", "long strings"};
+    for (int k = 0; k < 2; ++k)
+    {
+        const std::string &prog = progs[k];
+        for (int simd = 0; simd < 2; ++simd)
+        {
+            if (simd && !vecHasAvx2())
+                break;
+            double best = 1e300;
+            for (int run = 0; run < 3; ++run)
+            {
+                Interner I;
+                Symbols S;
+                S.init(I);
+                TextArena texts;
+                Lexer lexer(S, I, texts);
+                lexer.setSimd(simd != 0);
+                std::vector<Id> words;
+                auto start = std::chrono::high_resolution_clock::now();
+                lexer.run(prog.data(), prog.size(), words);
+                auto end = std::chrono::high_resolution_clock::now();
+                best = std::min(best, std::chrono::duration<double>(end - start).count());
+            }
+            std::cout << "Lexer, " << names[k] << (simd ? " (AVX2): " : " (table): ") << prog.size() / best / 1e6
+                      << " MB/s on " << prog.size() / 1000000.0 << " MB" << std::endl;
+        }
+    }
+}
+
+// Память при загрузке скрипта в 50 МБ: fread в буфер или mmap. Каждый
+// способ — в своём процессе, чтобы пики не смешивались
+void rssBench()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    const char *path = "lilc_rss_bench.lc";
+    FILE *f = std::fopen(path, "wb");
+    if (!f)
+        return;
+    std::fputs("VAR x = 0;\n", f);
+    const std::string text(60, 't');
+    size_t size = 0;
+    for (int k = 0; size < (50u << 20); ++k)
+    {
+        const std::string line = "x = x + " + std::to_string(k % 1000) + "; PRINTLN \"" + text + std::to_string(k) + "\";\n";
+        std::fwrite(line.data(), 1, line.size(), f);
+        size += line.size();
+    }
+    std::fclose(f);
+
+    const char *modes[] = {"nothing loaded", "fread + loadProgram", "loadFile (mmap)"};
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        std::cout.flush();
+        const pid_t pid = fork();
+        if (pid == 0)
+        {
+            lilc interpreter;
+            if (mode == 1)
+                interpreter.loadProgram(loadFile(path));
+            else if (mode == 2)
+            {
+                interpreter.setCodeCache(false);
+                interpreter.loadFile(path);
+            }
+            struct rusage ru;
+            getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+            const long kb = ru.ru_maxrss / 1024;
+#else
+            const long kb = ru.ru_maxrss;
+#endif
+            std::cout << "RSS, " << size / 1000000 << " MB script, " << modes[mode] << ": peak " << kb / 1024 << " MB";
+#ifdef __linux__
+            // сколько осталось после загрузки: буфер fread так и живёт, mmap уже снят
+            long pages = 0, resident = 0;
+            if (FILE *statm = std::fopen("/proc/self/statm", "r"))
+            {
+                if (std::fscanf(statm, "%ld %ld", &pages, &resident) == 2)
+                    std::cout << ", after load " << resident * sysconf(_SC_PAGESIZE) / (1 << 20) << " MB";
+                std::fclose(statm);
+            }
+#endif
+            std::cout << std::endl;
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+    }
+    std::remove(path);
+#endif
+}
+
+// Старт короткого запуска: разбор исходника или готовый .lcb (кэш loadFile)
+void cacheBench()
+{
+    const char *path = "lilc_cache_bench.lc";
+    const char *image = "lilc_cache_bench.lcb";
+    const std::string prog = tokenBenchProg(50000);
+    FILE *f = std::fopen(path, "wb");
+    if (!f)
+        return;
+    std::fwrite(prog.data(), 1, prog.size(), f);
+    std::fclose(f);
+
+    double parse = 1e300, restore = 1e300;
+    for (int run = 0; run < 3; ++run)
+    {
+        lilc cold;
+        cold.setCodeCache(false);
+        auto start = std::chrono::high_resolution_clock::now();
+        cold.loadFile(path);
+        auto end = std::chrono::high_resolution_clock::now();
+        parse = std::min(parse, std::chrono::duration<double, std::milli>(end - start).count());
+        if (run == 0 && !cold.saveCompiled(image))
+            break;
+
+        lilc warm;
+        start = std::chrono::high_resolution_clock::now();
+        const bool ok = warm.loadCompiled(image);
+        end = std::chrono::high_resolution_clock::now();
+        if (ok)
+            restore = std::min(restore, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    std::cout << "Startup, " << prog.size() / 1000000.0 << " MB script: parse " << parse << " ms, .lcb "
+              << restore << " ms" << std::endl;
+    std::remove(path);
+    std::remove(image);
+}
+
+// Скорость интернирования на потоке слов, похожем на настоящие программы:
+// частоты по Ципфу — ключевые слова, операторы и короткие счётчики чаще
+// всего, длинные имена редко. Для сравнения — прежний интернер на двух
+// unordered_set
+struct SetInterner
+{
+    std::unordered_set<std::string> pool;
+    std::unordered_set<Id> ptrs;
+
+    Id intern(std::string_view s)
+    {
+        Id p = pool.emplace(s).first->c_str();
+        ptrs.insert(p);
+        return p;
+    }
+};
+
+std::vector<std::string> internBenchWords(size_t count, size_t vocabulary)
+{
+    const char *common[] = {";", "=", "(", ")", "+", "[", "]", "i", "VAR", "{", "}", "WHILE", "IF", "<",
+                            "*", "j", "n", "x", "PRINTLN", "sum", "-", "1", "0", "RETURN", "PROC", "k"};
+    const char *parts[] = {"value", "count", "index", "total", "row", "col", "buffer", "result", "tmp", "step"};
+    std::vector<std::string> vocab(std::begin(common), std::end(common));
+    for (size_t k = 0; vocab.size() < vocabulary; ++k)
+    {
+        std::string name = parts[k % 10];
+        if (k % 3 == 0)
+            name += std::string("_") + parts[(k / 10) % 10];
+        if (k % 7 == 0)
+            name += std::string("_") + parts[(k / 100) % 10] + "_of_" + parts[(k / 3) % 10];
+        vocab.push_back(name + std::to_string(k));
+    }
+
+    // номер слова по Ципфу (s = 1) через обратную функцию распределения
+    std::vector<double> cdf(vocab.size());
+    double total = 0.0;
+    for (size_t r = 0; r < vocab.size(); ++r)
+        cdf[r] = total += 1.0 / (double)(r + 1);
+    std::vector<std::string> stream;
+    stream.reserve(count);
+    uint64_t seed = 88172645463325252ULL;
+    for (size_t k = 0; k < count; ++k)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        const double u = (double)(seed >> 11) / 9007199254740992.0 * total;
+        stream.push_back(vocab[std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()]);
+    }
+    return stream;
+}
+
+template <class I>
+double internBenchRun(const std::vector<std::string> &stream)
+{
+    double best = 1e300;
+    for (int run = 0; run < 3; ++run)
+    {
+        I interner;
+        size_t check = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const std::string &w : stream)
+            check += (size_t)interner.intern(w)[0];
+        auto end = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+        static volatile size_t sink; // чтобы цикл не выбросили
+        sink = check;
+        (void)sink;
+    }
+    return stream.size() / best / 1e6;
+}
+
+void internBench()
+{
+    const size_t vocabularies[] = {2000, 200000};
+    for (size_t vocabulary : vocabularies)
+    {
+        const std::vector<std::string> stream = internBenchWords(4000000, vocabulary);
+        std::cout << "Interner, " << vocabulary << " names, Zipf: arena + open addressing "
+                  << internBenchRun<Interner>(stream) << " M/s, unordered_set "
+                  << internBenchRun<SetInterner>(stream) << " M/s" << std::endl;
+    }
+}
+
 int main(int argc, char *argv[])
 {
-    const char *text = loadFile("prog1.lc");
+    const char *text = loadFile("LILC_PROG/prog1.lc");
     lilc interpreter;
+    lilc interpreterVM;
+    interpreterVM.setEngine(lilc::ENGINE_VM);
 
     // interpreter.loadProgram("VAR x; WHILE ( #x < 10 ) { PRINTLN x ; IF ( #x == 5 ) { PRINTLN \"X5!\";} SET x = #x + 1;} ");
 
@@ -77,6 +642,40 @@ int main(int argc, char *argv[])
             std::chrono::duration<double, std::milli> duration = end - start;
             std::cout << "LILC: " << duration.count() << " ms" << std::endl;
         }
+        interpreter.printFusion();
+        {
+            // tick без JIT горячих циклов
+            lilc interpreterNoJit;
+            interpreterNoJit.setJit(false);
+            interpreterNoJit.loadProgram(text);
+            auto start = std::chrono::high_resolution_clock::now();
+            interpreterNoJit.interpretate();
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double, std::milli> duration = end - start;
+            std::cout << "LILC (no JIT): " << duration.count() << " ms" << std::endl;
+        }
+        {
+            interpreterVM.loadProgram(text);
+            auto start = std::chrono::high_resolution_clock::now();
+            interpreterVM.interpretate();
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double, std::milli> duration = end - start;
+            std::cout << "LILC VM: " << duration.count() << " ms" << std::endl;
+        }
+        {
+            // первый запуск собирает модуль, второй берёт его из кэша
+            for (int run = 0; run < 2; ++run)
+            {
+                lilc interpreterAOT;
+                interpreterAOT.setEngine(lilc::ENGINE_AOT);
+                interpreterAOT.loadProgram(text);
+                auto start = std::chrono::high_resolution_clock::now();
+                interpreterAOT.interpretate();
+                auto end = std::chrono::high_resolution_clock::now();
+                std::chrono::duration<double, std::milli> duration = end - start;
+                std::cout << (run ? "LILC AOT (cached): " : "LILC AOT (build): ") << duration.count() << " ms" << std::endl;
+            }
+        }
         {
 
             auto start = std::chrono::high_resolution_clock::now();
@@ -85,10 +684,44 @@ int main(int argc, char *argv[])
             std::chrono::duration<double, std::milli> duration = end - start;
             std::cout << "C++: " << duration.count() << " ms" << std::endl;
         }
+        std::cout << "Array loop kernels: " << (vecHasAvx2() ? "AVX2" : "scalar") << std::endl;
     }
 
+    dispatchBench();
+    callBench();
+    benchEngines("fib(22)", argCallProg, {lilc::ENGINE_TICK, lilc::ENGINE_VM});
+    benchEngines("tail calls", tailCallProg, {lilc::ENGINE_TICK, lilc::ENGINE_VM});
+    tokenBench();
+    lexerBench();
+    rssBench();
+    cacheBench();
+    internBench();
+
+    checkEngines("PRINT expressions", printExprProg, "2.000000 2.500000 5.000000 3.141593\n");
+    checkEngines("compare in arguments", argCompareProg, "a=13.000000\n");
+    checkEngines("fact(10)", factProg, "fact=3628800.000000\n");
+    checkEngines("call in right operand", callOrderProg, "r=6.000000 x=10.000000\n");
+    checkEngines("tail sumTo(100000)", tailSumProg, "sum=5000050000.000000\n");
+    checkEngines("call depth 4001", deepCallProg, "Call stack overflow: more than 4000 nested calls");
+    checkNativeStack();
+    checkImage("round trip", imageProg, "s=126.000000\n");
+    checkEngines("BREAK/CONTINUE", breakProg, "s=50.000000\n");
+    checkEngines("procedure table", procTableProg, "s=420.000000\n");
+    checkEngines("duplicate PROC", "PROC f { } PROC f { } f;", "Duplicate PROC 'f'");
+    checkEngines("unknown PROC", "VAR x = 1; g; PRINTLN x;", "PROC 'g' not found");
+    checkEngines("nested blocks", blocksProg, "s=48.000000\n");
+    checkEngines("missing }", "VAR x = 1; WHILE (x < 3) { x = x + 1;", "Closing } not found");
+    checkEngines("mismatched ]", "VAR x = (1 + 2]; PRINTLN x;", "Mismatched closing bracket");
+    checkEngines("stray }", "VAR x = 1; } PRINTLN x;", "Unexpected closing bracket");
+    checkEngines("fusion", fusionProg, "s=100.000000 x=10.000000\n");
+    checkEngines("fusion out of range", fusionRangeProg, "Array element 'a[10]' not found");
+    checkEngines("folding", foldProg, "x=24.000000 c=1.000000 k=7.000000\n");
+    checkEngines("CSE", cseProg, "s=140.000000 a=72.000000 r=13.000000\n");
+    checkEngines("LICM", licmProg, "s=7950.000000 t=-7900.000000 u=11900.000000\n");
+    checkEngines("LICM nested loops", licmNestedProg, "x=2.000000\n");
+
     // const char *c = "sqrt(5^2+7^2+11^2+(8-2)^2)";
     // double r = te_interp(c, 0);
     // std::cout << "The expressionres " << r << "\n";
-    // return 0;
+    return failedChecks ? 1 : 0;
 }
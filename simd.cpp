@@ -0,0 +1,259 @@
+#pragma once
+#include "system.cpp"
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define LILC_VEC_AVX2 1
+#define LILC_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <immintrin.h>
+#include <intrin.h>
+#define LILC_VEC_AVX2 1
+#define LILC_AVX2_TARGET
+#endif
+
+// ===== Векторные ядра для поэлементных циклов по массивам =====
+// WHILE (i < N) { a[i] = f(b[i], c, i ...); ... i = i + 1; }
+// выполняется блоками сразу над std::vector<double>, границы проверяются
+// один раз до цикла. Ядро строит компилятор (compiler.cpp), исполняют
+// и ВМ (OP_VLOOP), и tick (_opWHILE).
+
+enum VecOp : uint8_t
+{
+    V_ARR,    // push arrays[arg][i]
+    V_CONST,  // push consts[arg]
+    V_SCALAR, // push scalars[arg] (не меняется в цикле)
+    V_INDEX,  // push i
+    V_ADD,
+    V_SUB,
+    V_MUL,
+    V_DIV,
+    V_STORE // arrays[arg][i] = pop
+};
+
+struct VecInstr
+{
+    VecOp op;
+    int arg;
+};
+
+// Переменная ядра: ячейка для ВМ и слово программы для tick
+struct VecRef
+{
+    int slot = -1;
+    bool global = false;
+    int word = -1;
+};
+
+struct VecKernel
+{
+    static constexpr int kMaxDepth = 8;
+
+    int whileWord = -1;
+    VecRef counter;          // i
+    VecRef limitVar;         // N, если переменная (slot -1 — константа)
+    double limitConst = 0.0; // N, если число
+    bool inclusive = false;  // i <= N
+    std::vector<VecRef> arrays;
+    std::vector<VecRef> scalars;
+    std::vector<double> consts;
+    std::vector<VecInstr> code; // постфиксная запись тела
+};
+
+// Сколько раз выполнится тело при старте с i0; -1 — ядро неприменимо
+// (нецелый или отрицательный счётчик, бесконечная граница)
+inline long vecTripCount(bool inclusive, double i0, double n)
+{
+    if (!(i0 >= 0.0) || i0 != std::floor(i0) || i0 > 9007199254740992.0 || !std::isfinite(n))
+        return -1;
+    auto inside = [&](double i)
+    { return inclusive ? (i <= n) : (i < n); };
+    if (!inside(i0))
+        return 0;
+    double span = inclusive ? std::floor(n - i0) + 1.0 : std::ceil(n - i0);
+    if (span > 9007199254740992.0)
+        return -1;
+    long count = span > 0.0 ? (long)span : 0;
+    // n - i0 могло округлиться: доводим по тем же сравнениям, что и цикл
+    while (count > 0 && !inside(i0 + (double)(count - 1)))
+        --count;
+    while (inside(i0 + (double)count))
+        ++count;
+    return count;
+}
+
+// Операнд на стеке ядра: либо поток значений p[0..len), либо скаляр s
+struct VecLane
+{
+    const double *p;
+    double s;
+};
+
+inline double vecApply(VecOp op, double x, double y)
+{
+    switch (op)
+    {
+    case V_ADD:
+        return x + y;
+    case V_SUB:
+        return x - y;
+    case V_MUL:
+        return x * y;
+    default:
+        return x / y;
+    }
+}
+
+inline void vecBinaryScalar(VecOp op, double *dst, VecLane a, VecLane b, size_t len)
+{
+    for (size_t j = 0; j < len; ++j)
+        dst[j] = vecApply(op, a.p ? a.p[j] : a.s, b.p ? b.p[j] : b.s);
+}
+
+#ifdef LILC_VEC_AVX2
+LILC_AVX2_TARGET inline void vecBinaryAvx2(VecOp op, double *dst, VecLane a, VecLane b, size_t len)
+{
+    const __m256d as = _mm256_set1_pd(a.s);
+    const __m256d bs = _mm256_set1_pd(b.s);
+    size_t j = 0;
+#define LILC_AVX_LOOP(INTR)                                           \
+    for (; j + 4 <= len; j += 4)                                      \
+    {                                                                 \
+        const __m256d x = a.p ? _mm256_loadu_pd(a.p + j) : as;        \
+        const __m256d y = b.p ? _mm256_loadu_pd(b.p + j) : bs;        \
+        _mm256_storeu_pd(dst + j, INTR(x, y));                        \
+    }                                                                 \
+    break;
+    switch (op)
+    {
+    case V_ADD:
+        LILC_AVX_LOOP(_mm256_add_pd)
+    case V_SUB:
+        LILC_AVX_LOOP(_mm256_sub_pd)
+    case V_MUL:
+        LILC_AVX_LOOP(_mm256_mul_pd)
+    default:
+        LILC_AVX_LOOP(_mm256_div_pd)
+    }
+#undef LILC_AVX_LOOP
+    // хвост — скалярно
+    if (j < len)
+        vecBinaryScalar(op, dst + j, {a.p ? a.p + j : nullptr, a.s}, {b.p ? b.p + j : nullptr, b.s}, len - j);
+}
+
+inline bool vecDetectAvx2()
+{
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0);
+    if (r[0] < 7)
+        return false;
+    __cpuid(r, 1);
+    const bool osxsave = (r[2] >> 27) & 1;
+    const bool avx = (r[2] >> 28) & 1;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(r, 7, 0);
+    return (r[1] >> 5) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// AVX2 доступен на этой машине (CPUID, один раз)
+inline bool vecHasAvx2()
+{
+#ifdef LILC_VEC_AVX2
+    static const bool has = vecDetectAvx2();
+    return has;
+#else
+    return false;
+#endif
+}
+
+// Исполнить ядро на [i0, i0 + count). A — данные массивов ядра, sizes — их
+// длины, S — значения скаляров. false — индекс выходит за границы, тогда
+// цикл надо выполнить обычным путём (он и сообщит об ошибке).
+inline bool vecRun(const VecKernel &k, double *const *A, const size_t *sizes, const double *S, double i0, long count)
+{
+    const size_t from = (size_t)i0;
+    const size_t to = from + (size_t)count;
+    for (size_t a = 0; a < k.arrays.size(); ++a)
+        if (sizes[a] < to)
+            return false;
+
+    const bool avx2 = vecHasAvx2();
+    constexpr size_t B = 256;
+    alignas(32) double tmp[VecKernel::kMaxDepth][B];
+    VecLane stack[VecKernel::kMaxDepth];
+
+    for (size_t base = from; base < to; base += B)
+    {
+        const size_t len = (to - base < B) ? to - base : B;
+        int sp = 0;
+        for (size_t pc = 0; pc < k.code.size(); ++pc)
+        {
+            const VecInstr &I = k.code[pc];
+            switch (I.op)
+            {
+            case V_ARR:
+                stack[sp++] = {A[I.arg] + base, 0.0};
+                break;
+            case V_CONST:
+                stack[sp++] = {nullptr, k.consts[I.arg]};
+                break;
+            case V_SCALAR:
+                stack[sp++] = {nullptr, S[I.arg]};
+                break;
+            case V_INDEX:
+                for (size_t j = 0; j < len; ++j)
+                    tmp[sp][j] = (double)(base + j);
+                stack[sp] = {tmp[sp], 0.0};
+                ++sp;
+                break;
+            case V_STORE:
+            {
+                VecLane v = stack[--sp];
+                double *dst = A[I.arg] + base;
+                if (v.p == dst)
+                    break;
+                if (v.p)
+                    std::memmove(dst, v.p, len * sizeof(double));
+                else
+                    for (size_t j = 0; j < len; ++j)
+                        dst[j] = v.s;
+                break;
+            }
+            default:
+            {
+                VecLane b = stack[--sp];
+                VecLane a = stack[--sp];
+                if (!a.p && !b.p)
+                {
+                    stack[sp++] = {nullptr, vecApply(I.op, a.s, b.s)};
+                    break;
+                }
+                // результат последней операции пишем прямо в массив назначения
+                const VecInstr *next = (pc + 1 < k.code.size()) ? &k.code[pc + 1] : nullptr;
+                double *dst = (next && next->op == V_STORE && sp == 0) ? A[next->arg] + base : tmp[sp];
+#ifdef LILC_VEC_AVX2
+                if (avx2)
+                    vecBinaryAvx2(I.op, dst, a, b, len);
+                else
+#endif
+                    vecBinaryScalar(I.op, dst, a, b, len);
+                stack[sp++] = {dst, 0.0};
+                break;
+            }
+            }
+        }
+    }
+    (void)avx2;
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LILC_MMAP_SUPPORTED 1
+#endif
+
+// ===== Текст программы из файла =====
+// Обычный файл отображается в память только для чтения, и лексер читает
+// его на месте: загрузка не копирует текст. Без mmap (Windows, каналы)
+// файл читается в буфер.
+class SourceFile
+{
+public:
+    SourceFile() = default;
+    SourceFile(const SourceFile &) = delete;
+    SourceFile &operator=(const SourceFile &) = delete;
+    ~SourceFile() { close(); }
+
+    // false — файл не открылся (причина в errno)
+    bool open(const char *path)
+    {
+        close();
+#ifdef LILC_MMAP_SUPPORTED
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                data_ = static_cast<const char *>(p);
+                size_ = (size_t)st.st_size;
+                mapped = true;
+                ::close(fd);
+                return true;
+            }
+        }
+        ::close(fd);
+#endif
+        FILE *f = std::fopen(path, "rb");
+        if (!f)
+            return false;
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+            buffer.insert(buffer.end(), chunk, chunk + n);
+        std::fclose(f);
+        data_ = buffer.data();
+        size_ = buffer.size();
+        return true;
+    }
+
+    void close()
+    {
+#ifdef LILC_MMAP_SUPPORTED
+        if (mapped)
+            munmap(const_cast<char *>(data_), size_);
+#endif
+        mapped = false;
+        buffer.clear();
+        buffer.shrink_to_fit();
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const char *data() const { return data_ ? data_ : ""; }
+    size_t size() const { return size_; }
+    bool isMapped() const { return mapped; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped = false;
+    std::vector<char> buffer;
+};
@@ -1,33 +1,35 @@
+#pragma once
 #include <iostream>
 #include <vector>
+#include <deque>
 #include <unordered_set>
 #include <unordered_map>
 #include <string>
 #include <string_view>
 #include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <memory>
 
-// ===== Прозрачные хеш/eq для string/string_view (для интернера) =====
-struct StringHash
+// ===== Кэш на диске: каталог и ключ (FNV-1a) =====
+// LILC_AOT_CACHE — каталог для модулей AOT и предкомпилированных программ
+inline std::string lilcCacheDir()
 {
-    using is_transparent = void;
-    size_t operator()(std::string_view s) const noexcept
-    {
-        return std::hash<std::string_view>{}(s);
-    }
-    size_t operator()(const std::string &s) const noexcept
+    const char *d = std::getenv("LILC_AOT_CACHE");
+    return (d && *d) ? d : ".lilc_cache";
+}
+
+inline uint64_t lilcHash(const char *data, size_t n, uint64_t h = 1469598103934665603ULL)
+{
+    for (size_t i = 0; i < n; ++i)
     {
-        return std::hash<std::string_view>{}(s);
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
     }
-};
-struct StringEq
-{
-    using is_transparent = void;
-    bool operator()(std::string_view a, std::string_view b) const noexcept { return a == b; }
-    bool operator()(const std::string &a, const std::string &b) const noexcept { return a == b; }
-    bool operator()(const std::string &a, std::string_view b) const noexcept { return a == b; }
-    bool operator()(std::string_view a, const std::string &b) const noexcept { return a == b; }
-};
+    return h;
+}
 
 // ===== Хеш/eq по указателю (для ключа Id = const char*) =====
 using Id = const char *;
@@ -41,39 +43,166 @@ struct PtrEq
     bool operator()(Id a, Id b) const noexcept { return a == b; }
 };
 
+// ===== Арена строк: копии с '\0' в больших блоках, указатели стабильны =====
+class TextArena
+{
+public:
+    static constexpr size_t kBlock = 64 * 1024;
+
+    const char *add(std::string_view s)
+    {
+        char *p = alloc(s.size() + 1);
+        std::memcpy(p, s.data(), s.size());
+        p[s.size()] = '\0';
+        return p;
+    }
+
+    void clear()
+    {
+        blocks.clear();
+        cur = last = nullptr;
+        reserved = 0;
+    }
+
+    size_t bytes() const noexcept { return reserved; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *cur = nullptr;
+    char *last = nullptr;
+    size_t reserved = 0;
+
+    char *alloc(size_t n)
+    {
+        if (n > kBlock / 4)
+        {
+            // длинная строка — свой блок, текущий не бросаем
+            blocks.emplace_back(new char[n]);
+            reserved += n;
+            return blocks.back().get();
+        }
+        if ((size_t)(last - cur) < n)
+        {
+            blocks.emplace_back(new char[kBlock]);
+            cur = blocks.back().get();
+            last = cur + kBlock;
+            reserved += kBlock;
+        }
+        char *p = cur;
+        cur += n;
+        return p;
+    }
+};
+
 // ===== Интернер: одна копия каждой строки, стабильный const char* =====
+// Строки лежат в TextArena (указатели не двигаются), поиск — открытая
+// адресация с линейным пробированием по плоской таблице. В ячейке хранится
+// хеш и длина, так что строки сравниваются только при совпадении обоих.
+inline uint64_t internHash(const char *p, size_t n) noexcept
+{
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ n;
+    for (; n >= 8; p += 8, n -= 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+    uint64_t w = 0;
+    for (size_t i = 0; i < n; ++i)
+        w |= (uint64_t)(unsigned char)p[i] << (8 * i);
+    h = (h ^ w) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 29);
+}
+
 class Interner
 {
 public:
     void reserve(size_t n)
     {
-        pool_.reserve(n);
-        ptrs_.reserve(n);
+        size_t cap = kMinCapacity;
+        while (cap < 2 * n)
+            cap *= 2;
+        if (cap > table.size())
+            rehash(cap);
     }
 
     // Заинтернить строку и вернуть стабильный указатель
     Id intern(std::string_view s)
     {
-        auto [it, inserted] = pool_.emplace(s); // std::string создаётся один раз
-        Id p = it->c_str();
-        ptrs_.insert(p); // для отладочных проверок
-        return p;
+        const uint64_t h = internHash(s.data(), s.size());
+        if (2 * (count + 1) > table.size())
+            rehash(table.empty() ? kMinCapacity : 2 * table.size());
+        Slot &slot = table[find(s, h)];
+        if (!slot.str)
+        {
+            slot.str = arena.add(s);
+            slot.hash = (uint32_t)h;
+            slot.len = (uint32_t)s.size();
+            ++count;
+        }
+        return slot.str;
     }
 
-    // Найти без вставки (если нет — nullptr). Не используем в горячем пути.
+    // Найти без вставки (если нет — nullptr); ничего не выделяет
     Id try_get(std::string_view s) const
     {
-        auto it = pool_.find(std::string(s));
-        return (it == pool_.end()) ? nullptr : it->c_str();
+        if (table.empty())
+            return nullptr;
+        return table[find(s, internHash(s.data(), s.size()))].str;
     }
 
-    size_t size() const noexcept { return pool_.size(); }
+    size_t size() const noexcept { return count; }
 
-    bool is_interned(Id p) const noexcept { return ptrs_.find(p) != ptrs_.end(); }
+    // Память таблицы и текстов
+    size_t bytes() const noexcept { return table.capacity() * sizeof(Slot) + arena.bytes(); }
+
+    // Для отладочных проверок: p — строка из этого интернера. Отдельного
+    // множества указателей нет — p ищется по своему тексту
+    bool is_interned(Id p) const noexcept { return p && try_get(p) == p; }
 
 private:
-    std::unordered_set<std::string, StringHash, StringEq> pool_;
-    std::unordered_set<Id, PtrHash, PtrEq> ptrs_;
+    struct Slot
+    {
+        Id str = nullptr; // nullptr — пустая ячейка
+        uint32_t hash = 0;
+        uint32_t len = 0;
+    };
+
+    static constexpr size_t kMinCapacity = 1024;
+
+    std::vector<Slot> table; // размер — степень двойки, заполнен не больше чем наполовину
+    size_t count = 0;
+    TextArena arena;
+
+    // Ячейка со строкой s или пустая, куда её вставить
+    size_t find(std::string_view s, uint64_t h) const noexcept
+    {
+        const size_t mask = table.size() - 1;
+        for (size_t i = (size_t)h & mask;; i = (i + 1) & mask)
+        {
+            const Slot &slot = table[i];
+            if (!slot.str || (slot.hash == (uint32_t)h && slot.len == s.size() &&
+                              std::memcmp(slot.str, s.data(), s.size()) == 0))
+                return i;
+        }
+    }
+
+    void rehash(size_t cap)
+    {
+        std::vector<Slot> old(cap);
+        old.swap(table);
+        const size_t mask = cap - 1;
+        for (const Slot &slot : old)
+        {
+            if (!slot.str)
+                continue;
+            size_t i = slot.hash & mask; // младшие биты хеша уже сохранены
+            while (table[i].str)
+                i = (i + 1) & mask;
+            table[i] = slot;
+        }
+    }
 };
 
 // Глобальный доступ без ODR-проблем
@@ -94,14 +223,16 @@ struct Symbols
 {
     // Ключевые слова
     Id VAR = nullptr, CONST = nullptr, SET = nullptr, IF = nullptr, ELSE = nullptr, WHILE = nullptr,
-       PROC = nullptr, RETURN = nullptr, PRINT = nullptr, PRINTLN = nullptr, HALT = nullptr;
+       PROC = nullptr, RETURN = nullptr, PRINT = nullptr, PRINTLN = nullptr, HALT = nullptr,
+       BREAK = nullptr, CONTINUE = nullptr;
 
     // Разделители/операторы
     Id LBRACE = nullptr, RBRACE = nullptr, LP = nullptr, RP = nullptr,
        LBRACKET = nullptr, RBRACKET = nullptr, SEMI = nullptr, EQ = nullptr,
        PLUS = nullptr, MINUS = nullptr, STAR = nullptr, SLASH = nullptr,
        EQEQ = nullptr, NEQ = nullptr, LEQ = nullptr, GEQ = nullptr,
-       LT = nullptr, GT = nullptr, COMMA = nullptr, QUOTE = nullptr, NOT = nullptr, CARET = nullptr, PERCENT = nullptr;
+       LT = nullptr, GT = nullptr, COMMA = nullptr, QUOTE = nullptr, NOT = nullptr, CARET = nullptr, PERCENT = nullptr,
+       AMP = nullptr, PIPE = nullptr, ANDAND = nullptr, OROR = nullptr;
 
     Id ABS = nullptr, ACOS = nullptr, ASIN = nullptr, ATAN = nullptr, ATAN2 = nullptr,
        CEIL = nullptr, COS = nullptr, COSH = nullptr, EXP = nullptr, FAC = nullptr,
@@ -123,6 +254,8 @@ struct Symbols
         PRINT = I.intern("PRINT");
         PRINTLN = I.intern("PRINTLN");
         HALT = I.intern("HALT");
+        BREAK = I.intern("BREAK");
+        CONTINUE = I.intern("CONTINUE");
 
         // скобки/разделители
         LBRACE = I.intern("{");
@@ -148,6 +281,10 @@ struct Symbols
         LT = I.intern("<");
         GT = I.intern(">");
         NOT = I.intern("!");
+        AMP = I.intern("&");
+        PIPE = I.intern("|");
+        ANDAND = I.intern("&&");
+        OROR = I.intern("||");
         CARET = I.intern("^");
         PERCENT = I.intern("%");
 
@@ -190,292 +327,167 @@ inline Symbols &SYM()
     return S;
 }
 
-// ===== Вспомогательные структуры только для отладки/печати =====
-struct variable
+// ===== Ссылка на переменную, разрешённая при загрузке =====
+// Имя в каждом слове программы заранее связано с ячейкой кадра.
+struct SlotRef
 {
-    Id id = nullptr;
-    double value = 0.0;
+    Id name = nullptr;
+    int slot = -1;       // ячейка в кадре; -1 — имя не объявлено
+    bool global = false; // кадр main (глобальные)
     bool isConst = false;
-
-    variable() = default;
-    variable(Id id_, double v, bool c = false) : id(id_), value(v), isConst(c) {}
-};
-
-struct array_var
-{
-    Id id = nullptr;
-    std::vector<double> data;
-    array_var() = default;
-    array_var(Id id_, const std::vector<double> &d) : id(id_), data(d) {}
+    bool isArray = false;
+    bool known = false;  // CONST, значение которого известно при загрузке
+    double value = 0.0;
+    bool inRange = false; // имя массива в a[...], индекс которого проверен при загрузке
 };
 
-// ===== Контроллер с O(1) доступом через "живой" слой и стек затенений =====
+// ===== Контроллер: плоский стек кадров, ячейки назначены при загрузке =====
 class controller
 {
 private:
-    int currentLevel = 0;
-
-
-    struct VarEntry
+    struct Frame
     {
-        double value = 0.0;
-        bool isConst = false;
+        int varBase = 0;
+        int arrBase = 0;
+        int varSize = 0;
+        int arrSize = 0;
     };
 
-    // Фреймы, владеющие значениями
-    std::vector<std::unordered_map<Id, VarEntry, PtrHash, PtrEq>> varFrames = {{}};
-    std::vector<std::unordered_map<Id, std::vector<double>, PtrHash, PtrEq>> arrFrames = {{}};
+    // Кадры лежат подряд; первый — кадр main. Ячейка массива указывает на
+    // свой массив из arrayStore (адреса в deque не меняются при росте) или
+    // на массив вызывающей процедуры, переданный по ссылке
+    std::vector<double> vars;
+    std::deque<std::vector<double>> arrayStore;
+    std::vector<std::vector<double> *> arrays;
+    std::vector<Frame> frames{Frame()};
 
-    // Живой видимый слой: быстрые лукапы
-    std::unordered_map<Id, VarEntry *, PtrHash, PtrEq> liveVars;
-    std::unordered_map<Id, std::vector<double> *, PtrHash, PtrEq> liveArrays;
+    // Счётчик изменений раскладки: растёт при смене кадра или переразмещении
+    // ячеек, так что внешний код может держать указатели, пока эпоха та же
+    unsigned long epoch_ = 0;
 
-    // Журнал изменений для отката уровня
-    struct VarChange
-    {
-        Id id;
-        VarEntry *prev;
-    };
-    struct ArrChange
+    inline int varIndex(const SlotRef &r) const noexcept
     {
-        Id id;
-        std::vector<double> *prev;
-    };
-
-    std::vector<VarChange> varLog;
-    std::vector<ArrChange> arrLog;
-    std::vector<size_t> varMarks{0}, arrMarks{0}; // индексы начала изменений уровня
-
-
-    static constexpr int kVSlots = 5;
-    static constexpr int kASlots = 5;
-
-    mutable Id v_id_[kVSlots] = {nullptr, nullptr, nullptr, nullptr, nullptr};
-    mutable VarEntry *v_ptr_[kVSlots] = {nullptr, nullptr, nullptr, nullptr, nullptr};
-    mutable int v_hand_ = 0;
-
-    mutable Id a_id_[kASlots] = {nullptr, nullptr, nullptr, nullptr, nullptr};
-    mutable std::vector<double> *a_ptr_[kASlots] = {nullptr, nullptr, nullptr, nullptr, nullptr};
-    mutable int a_hand_ = 0;
+        return r.global ? r.slot : frames.back().varBase + r.slot;
+    }
 
-    inline void clearHotCaches() noexcept
+    inline int arrIndex(const SlotRef &r) const noexcept
     {
-        for (int i = 0; i < kVSlots; ++i)
-        {
-            v_id_[i] = nullptr;
-            v_ptr_[i] = nullptr;
-        }
-        for (int i = 0; i < kASlots; ++i)
-        {
-            a_id_[i] = nullptr;
-            a_ptr_[i] = nullptr;
-        }
-        v_hand_ = 0;
-        a_hand_ = 0;
+        return r.global ? r.slot : frames.back().arrBase + r.slot;
     }
 
-    inline VarEntry  *cacheLookupVar(Id name) const noexcept
-    {
-        // быстрый проход по 5 слотам
-        for (int i = 0; i < kVSlots; ++i)
-            if (v_id_[i] == name)
-                return v_ptr_[i];
-        // промах → один lookup в liveVars
-        auto it = liveVars.find(name);
-        if (it == liveVars.end())
-            return nullptr;
-        // заносим в кольцевой слот
-        v_id_[v_hand_] = name;
-        v_ptr_[v_hand_] = it->second;
-        v_hand_ = (v_hand_ + 1) % kVSlots;
-        return it->second;
+public:
+    // --- Кадры ---
+    void reset(int nvars, int narrs)
+    {
+        vars.assign(nvars, 0.0);
+        arrayStore.clear();
+        arrays.clear();
+        ownArrays(0, narrs);
+        frames.assign(1, Frame{0, 0, nvars, narrs});
+        ++epoch_;
     }
 
-    inline std::vector<double> *cacheLookupArr(Id name) const noexcept
+    // Стек на depth вложенных вызовов выделяется одним куском сразу после
+    // reset: кадры, ячейки (frameVars на кадр процедуры) и ссылки на массивы
+    // не переезжают, пока глубина в пределах лимита
+    void reserveFrames(int depth, int frameVars, int frameArrs)
     {
-        for (int i = 0; i < kASlots; ++i)
-            if (a_id_[i] == name)
-                return a_ptr_[i];
-        auto it = liveArrays.find(name);
-        if (it == liveArrays.end())
-            return nullptr;
-        a_id_[a_hand_] = name;
-        a_ptr_[a_hand_] = it->second;
-        a_hand_ = (a_hand_ + 1) % kASlots;
-        return it->second;
+        frames.reserve(depth + 1);
+        vars.reserve(vars.size() + (size_t)depth * frameVars);
+        arrays.reserve(arrays.size() + (size_t)depth * frameArrs);
     }
 
-public:
-    // --- Управление уровнями ---
-    void inLevel()
-    {
-        ++currentLevel;
-        if ((int)varFrames.size() <= currentLevel)
-            varFrames.emplace_back();
-        if ((int)arrFrames.size() <= currentLevel)
-            arrFrames.emplace_back();
-        varMarks.push_back(varLog.size());
-        arrMarks.push_back(arrLog.size());
-        clearHotCaches();
+    // Вызов процедуры: новый кадр сразу за текущим
+    void enterFrame(int nvars, int narrs)
+    {
+        const Frame &cur = frames.back();
+        Frame f{cur.varBase + cur.varSize, cur.arrBase + cur.arrSize, nvars, narrs};
+        if ((int)vars.size() < f.varBase + nvars)
+            vars.resize(f.varBase + nvars, 0.0); // в пределах reserveFrames
+        ownArrays(f.arrBase, narrs);
+        std::fill(vars.begin() + f.varBase, vars.begin() + f.varBase + nvars, 0.0);
+        frames.push_back(f);
+        ++epoch_;
     }
 
-    void outLevel()
+    void leaveFrame()
     {
-        if (currentLevel <= 0)
+        if (frames.size() <= 1)
         {
-            std::cerr << "Already at base level, can't go lower!\n";
+            std::cerr << "Already at base frame, can't go lower!\n";
             return;
         }
-
-        // Откат массивов
-        size_t aMark = arrMarks.back();
-        while (arrLog.size() > aMark)
-        {
-            auto ch = arrLog.back();
-            arrLog.pop_back();
-            if (ch.prev == nullptr)
-                liveArrays.erase(ch.id);
-            else
-                liveArrays[ch.id] = ch.prev;
-        }
-        arrMarks.pop_back();
-
-        // Откат переменных
-        size_t vMark = varMarks.back();
-        while (varLog.size() > vMark)
-        {
-            auto ch = varLog.back();
-            varLog.pop_back();
-            if (ch.prev == nullptr)
-                liveVars.erase(ch.id);
-            else
-                liveVars[ch.id] = ch.prev;
-        }
-        varMarks.pop_back();
-
-        // Удаляем фреймы уровня (владение значениями)
-        varFrames.pop_back();
-        arrFrames.pop_back();
-        --currentLevel;
-        clearHotCaches();
+        frames.pop_back();
+        ++epoch_;
     }
 
-    // --- Переменные ---
-    void addVar(Id name) { addVar(name, 0.0, false); }
-    void addVar(Id name, double value) { addVar(name, value, false); }
-
-    void addVar(Id name, double value, bool isConst)
+    // Параметр-массив slot текущего кадра — ссылка на массив аргумента
+    void bindArray(int slot, std::vector<double> *vec)
     {
-        auto &frame = varFrames[currentLevel];
-
-        auto [it, inserted] = frame.emplace(name, VarEntry{value, isConst});
-        if (!inserted)
-        {
-            it->second.value = value;
-            it->second.isConst = isConst;
-        }
+        arrays[frames.back().arrBase + slot] = vec;
+    }
 
-        VarEntry *prev = nullptr;
-        if (auto itLive = liveVars.find(name); itLive != liveVars.end())
-            prev = itLive->second;
+    int depth() const noexcept { return (int)frames.size() - 1; }
 
-        varLog.push_back({name, prev});
-        liveVars[name] = &it->second;
-        clearHotCaches();
-    }
+    // Сырые ячейки для JIT: действительны, пока кадр не сменился
+    double *frameVars() { return vars.data() + frames.back().varBase; }
+    double *globalVars() { return vars.data(); }
+    std::vector<double> &frameArray(int slot) { return *arrays[frames.back().arrBase + slot]; }
+    std::vector<double> &globalArray(int slot) { return *arrays[slot]; }
 
-    bool setVar(Id name, double value)
+    // --- Переменные ---
+    void addVar(const SlotRef &r, double value)
     {
-        if (VarEntry *p = cacheLookupVar(name))
-        {
-            if (p->isConst)
-                return false; // константу нельзя менять
-            p->value = value;
-            return true;
-        }
-        return false;
+        if (r.slot >= 0)
+            vars[varIndex(r)] = value;
     }
 
-    bool isVarConstant(Id name){
-        if (VarEntry *p = cacheLookupVar(name))
-        {
-            if (p->isConst){
-                return true;
-            }
-        }
-        return false;
+    bool setVar(const SlotRef &r, double value)
+    {
+        if (r.slot < 0 || r.isConst)
+            return false; // константу нельзя менять
+        vars[varIndex(r)] = value;
+        return true;
     }
 
+    bool isVarConstant(const SlotRef &r) const { return r.slot >= 0 && r.isConst; }
 
-    bool getVar(Id name, double &outValue) const
+    bool getVar(const SlotRef &r, double &outValue) const
     {
-        if (VarEntry  *p = cacheLookupVar(name))
-        {
-            outValue = p->value;
-            return true;
-        }
-        return false;
+        if (r.slot < 0 || r.isArray)
+            return false;
+        outValue = vars[varIndex(r)];
+        return true;
     }
 
-    bool findVar(Id name) const
+    double *getVarPtr(const SlotRef &r)
     {
-        return cacheLookupVar(name) != nullptr;
+        if (r.slot < 0 || r.isArray)
+            return nullptr;
+        return &vars[varIndex(r)];
     }
 
-    double *getVarPtr(Id name) const
-    { // тоже через кэш
-        if (VarEntry *p = cacheLookupVar(name))
-            return &p->value;
-        return nullptr;
-    }
-    std::vector<double> *getArrayPtr(Id name) const
+    std::vector<double> *getArrayPtr(const SlotRef &r)
     {
-        return cacheLookupArr(name);
+        if (r.slot < 0 || !r.isArray)
+            return nullptr;
+        return arrays[arrIndex(r)];
     }
 
     // --- Массивы ---
-    void addArray(Id name, size_t size, double init = 0.0)
-    {
-        auto &frame = arrFrames[currentLevel];
-        auto [it, inserted] = frame.emplace(name, std::vector<double>(size, init));
-        if (!inserted)
-            it->second.assign(size, init);
-
-        std::vector<double> *prev = nullptr;
-        if (auto itLive = liveArrays.find(name); itLive != liveArrays.end())
-            prev = itLive->second;
-        arrLog.push_back({name, prev});
-        liveArrays[name] = &it->second;
-        clearHotCaches();
-    }
-
-    void addArray(Id name, const std::vector<double> &values)
-    {
-        auto &frame = arrFrames[currentLevel];
-        auto [it, inserted] = frame.emplace(name, values);
-        if (!inserted)
-            it->second = values;
-
-        std::vector<double> *prev = nullptr;
-        if (auto itLive = liveArrays.find(name); itLive != liveArrays.end())
-            prev = itLive->second;
-        arrLog.push_back({name, prev});
-        liveArrays[name] = &it->second;
-        clearHotCaches();
-    }
-
-    bool findArray(Id name) const
+    void addArray(const SlotRef &r, size_t size, double init = 0.0)
     {
-        return cacheLookupArr(name) != nullptr;
+        if (std::vector<double> *vec = getArrayPtr(r))
+            vec->assign(size, init);
     }
 
-    bool setArrayElem(Id name, size_t index, double value)
+    bool setArrayElem(const SlotRef &r, size_t index, double value)
     {
-        if (auto *vec = cacheLookupArr(name))
+        if (auto *vec = getArrayPtr(r))
         {
             if (index >= vec->size())
             {
-                std::cerr << "Index out of bounds for array '" << name << "': "
+                std::cerr << "Index out of bounds for array '" << r.name << "': "
                           << index << " >= " << vec->size() << "\n";
                 return false;
             }
@@ -485,23 +497,23 @@ public:
         return false;
     }
 
-    bool setArrayElem(Id name, int index, double value)
+    bool setArrayElem(const SlotRef &r, int index, double value)
     {
         if (index < 0)
         {
-            std::cerr << "Negative index for array '" << name << "': " << index << "\n";
+            std::cerr << "Negative index for array '" << r.name << "': " << index << "\n";
             return false;
         }
-        return setArrayElem(name, static_cast<size_t>(index), value);
+        return setArrayElem(r, static_cast<size_t>(index), value);
     }
 
-    bool getArrayElem(Id name, size_t index, double &outValue) const
+    bool getArrayElem(const SlotRef &r, size_t index, double &outValue)
     {
-        if (auto *vec = cacheLookupArr(name))
+        if (auto *vec = getArrayPtr(r))
         {
             if (index >= vec->size())
             {
-                std::cerr << "Index out of bounds for array '" << name << "': "
+                std::cerr << "Index out of bounds for array '" << r.name << "': "
                           << index << " >= " << vec->size() << "\n";
                 return false;
             }
@@ -511,90 +523,37 @@ public:
         return false;
     }
 
-    bool getArrayElem(Id name, int index, double &outValue) const
+    bool getArrayElem(const SlotRef &r, int index, double &outValue)
     {
         if (index < 0)
         {
-            std::cerr << "Negative index for array '" << name << "': " << index << "\n";
+            std::cerr << "Negative index for array '" << r.name << "': " << index << "\n";
             return false;
         }
-        return getArrayElem(name, static_cast<size_t>(index), outValue);
-    }
-
-    bool resizeArray(Id name, size_t newSize, double init = 0.0)
-    {
-        if (auto *vec = cacheLookupArr(name))
-        {
-            vec->assign(newSize, init);
-            return true;
-        }
-        return false;
+        return getArrayElem(r, static_cast<size_t>(index), outValue);
     }
 
     // --- Отладочная печать ---
-    void printCurrentLevel() const
+    void printFrame() const
     {
-        std::cout << "Level " << currentLevel << " variables:\n";
-        for (const auto &kv : varFrames[currentLevel])
-        {
-            std::cout << kv.first << " = " << kv.second.value;
-            if (kv.second.isConst) std::cout << " [CONST]";
-            std::cout << "\n";
-        }
+        const Frame &f = frames.back();
+        std::cout << "Frame " << depth() << " (" << f.varSize << " vars, " << f.arrSize << " arrays):\n";
+        for (int i = 0; i < f.varSize; ++i)
+            std::cout << "  [" << i << "] = " << vars[f.varBase + i] << "\n";
     }
 
+    unsigned long epoch() const noexcept { return epoch_; }
 
-    void printAllLevels() const
+private:
+    // Ячейки [from, from + n) — снова свои массивы кадра
+    void ownArrays(int from, int n)
     {
-        std::cout << "All levels:\n";
-        for (size_t lvl = 0; lvl < varFrames.size(); ++lvl)
+        if (arrayStore.size() < (size_t)(from + n))
         {
-            std::cout << "Level " << lvl << ":\n";
-            for (const auto &kv : varFrames[lvl])
-            {
-                std::cout << "  " << kv.first << " = " << kv.second.value;
-                if (kv.second.isConst) std::cout << " [CONST]";
-                std::cout << "\n";
-            }
+            arrayStore.resize(from + n);
+            arrays.resize(from + n);
         }
-    }
-
-
-    // --- Снимки уровня для UI/отладки ---
-    const std::vector<variable> &getVarsAtLevel(int level) const
-    {
-        static std::vector<variable> tmp;
-        tmp.clear();
-        for (const auto &kv : varFrames[level])
-            tmp.emplace_back(kv.first, kv.second.value, kv.second.isConst);
-        return tmp;
-    }
-
-    const std::vector<array_var> &getArraysAtLevel(int level) const
-    {
-        static std::vector<array_var> tmp;
-        tmp.clear();
-        for (const auto &kv : arrFrames[level])
-            tmp.emplace_back(kv.first, kv.second);
-        return tmp;
-    }
-
-    int getCurrentLevel() const { return currentLevel; }
-
-    // --- Подготовка ёмкостей (необязательно, но уменьшает rehash) ---
-    void reserve(size_t varsPerLevel, size_t arraysPerLevel, size_t levels = 8)
-    {
-        varFrames.reserve(levels);
-        arrFrames.reserve(levels);
-        for (auto &f : varFrames)
-            f.reserve(varsPerLevel);
-        for (auto &f : arrFrames)
-            f.reserve(arraysPerLevel);
-        liveVars.reserve(varsPerLevel * levels);
-        liveArrays.reserve(arraysPerLevel * levels);
-        varLog.reserve(varsPerLevel * levels);
-        arrLog.reserve(arraysPerLevel * levels);
-        varMarks.reserve(levels + 1);
-        arrMarks.reserve(levels + 1);
+        for (int k = from; k < from + n; ++k)
+            arrays[k] = &arrayStore[k];
     }
 };
@@ -235,6 +235,17 @@ static double divide(double a, double b) {return a / b;}
 static double negate(double a) {return -a;}
 static double comma(double a, double b) {(void)a; return b;}
 
+/* LILC: comparisons and logic, result is 0 or 1. */
+static double less(double a, double b) {return a < b;}
+static double less_eq(double a, double b) {return a <= b;}
+static double greater(double a, double b) {return a > b;}
+static double greater_eq(double a, double b) {return a >= b;}
+static double equal(double a, double b) {return a == b;}
+static double not_equal(double a, double b) {return a != b;}
+static double logical_and(double a, double b) {return a != 0.0 && b != 0.0;}
+static double logical_or(double a, double b) {return a != 0.0 || b != 0.0;}
+static double logical_not(double a) {return a == 0.0;}
+
 
 void next_token(state *s) {
     s->type = TOK_NULL;
@@ -291,6 +302,33 @@ void next_token(state *s) {
                     case '/': s->type = TOK_INFIX; s->function = divide; break;
                     case '^': s->type = TOK_INFIX; s->function = pow; break;
                     case '%': s->type = TOK_INFIX; s->function = fmod; break;
+                    case '<':
+                        s->type = TOK_INFIX;
+                        if (s->next[0] == '=') {s->next++; s->function = less_eq;}
+                        else s->function = less;
+                        break;
+                    case '>':
+                        s->type = TOK_INFIX;
+                        if (s->next[0] == '=') {s->next++; s->function = greater_eq;}
+                        else s->function = greater;
+                        break;
+                    case '=':
+                        if (s->next[0] == '=') {s->next++; s->type = TOK_INFIX; s->function = equal;}
+                        else s->type = TOK_ERROR;
+                        break;
+                    case '!':
+                        s->type = TOK_INFIX;
+                        if (s->next[0] == '=') {s->next++; s->function = not_equal;}
+                        else s->function = logical_not;
+                        break;
+                    case '&':
+                        if (s->next[0] == '&') {s->next++; s->type = TOK_INFIX; s->function = logical_and;}
+                        else s->type = TOK_ERROR;
+                        break;
+                    case '|':
+                        if (s->next[0] == '|') {s->next++; s->type = TOK_INFIX; s->function = logical_or;}
+                        else s->type = TOK_ERROR;
+                        break;
                     case '(': s->type = TOK_OPEN; break;
                     case ')': s->type = TOK_CLOSE; break;
                     case ',': s->type = TOK_SEP; break;
@@ -305,10 +343,11 @@ void next_token(state *s) {
 
 static te_expr *list(state *s);
 static te_expr *expr(state *s);
+static te_expr *or_expr(state *s);
 static te_expr *power(state *s);
 
 static te_expr *base(state *s) {
-    /* <base>      =    <constant> | <variable> | <function-0> {"(" ")"} | <function-1> <power> | <function-X> "(" <expr> {"," <expr>} ")" | "(" <list> ")" */
+    /* <base>      =    <constant> | <variable> | <function-0> {"(" ")"} | <function-1> <power> | <function-X> "(" <or> {"," <or>} ")" | "(" <list> ")" */
     te_expr *ret;
     int arity;
 
@@ -378,7 +417,7 @@ static te_expr *base(state *s) {
                 int i;
                 for(i = 0; i < arity; i++) {
                     next_token(s);
-                    ret->parameters[i] = expr(s);
+                    ret->parameters[i] = or_expr(s); /* LILC: arguments may hold comparisons and && ||. */
                     CHECK_NULL(ret->parameters[i], te_free(ret));
 
                     if(s->type != TOK_SEP) {
@@ -420,7 +459,19 @@ static te_expr *base(state *s) {
 
 
 static te_expr *power(state *s) {
-    /* <power>     =    {("-" | "+")} <base> */
+    /* <power>     =    {("-" | "+")} <base> | "!" <power> */
+    if (s->type == TOK_INFIX && s->function == logical_not) {
+        next_token(s);
+        te_expr *p = power(s);
+        CHECK_NULL(p);
+
+        te_expr *ret = NEW_EXPR(TE_FUNCTION1 | TE_FLAG_PURE, p);
+        CHECK_NULL(ret, te_free(p));
+
+        ret->function = logical_not;
+        return ret;
+    }
+
     int sign = 1;
     while (s->type == TOK_INFIX && (s->function == add || s->function == sub)) {
         if (s->function == sub) sign = -sign;
@@ -568,14 +619,49 @@ static te_expr *expr(state *s) {
 }
 
 
+#define TE_BINARY_LEVEL(NAME, NEXT, COND)                                   \
+static te_expr *NAME(state *s) {                                            \
+    te_expr *ret = NEXT(s);                                                 \
+    CHECK_NULL(ret);                                                        \
+                                                                            \
+    while (s->type == TOK_INFIX && (COND)) {                                \
+        te_fun2 t = s->function;                                            \
+        next_token(s);                                                      \
+        te_expr *r = NEXT(s);                                               \
+        CHECK_NULL(r, te_free(ret));                                        \
+                                                                            \
+        te_expr *prev = ret;                                                \
+        ret = NEW_EXPR(TE_FUNCTION2 | TE_FLAG_PURE, ret, r);                \
+        CHECK_NULL(ret, te_free(r), te_free(prev));                         \
+                                                                            \
+        ret->function = t;                                                  \
+    }                                                                       \
+                                                                            \
+    return ret;                                                             \
+}
+
+/* LILC: C-like precedence below <expr>.
+   <rel>  =  <expr> {("<" | "<=" | ">" | ">=") <expr>}
+   <eq>   =  <rel> {("==" | "!=") <rel>}
+   <and>  =  <eq> {"&&" <eq>}
+   <or>   =  <and> {"||" <and>}          */
+TE_BINARY_LEVEL(rel, expr, s->function == less || s->function == less_eq ||
+                           s->function == greater || s->function == greater_eq)
+TE_BINARY_LEVEL(eq, rel, s->function == equal || s->function == not_equal)
+TE_BINARY_LEVEL(and_expr, eq, s->function == logical_and)
+TE_BINARY_LEVEL(or_expr, and_expr, s->function == logical_or)
+
+#undef TE_BINARY_LEVEL
+
+
 static te_expr *list(state *s) {
-    /* <list>      =    <expr> {"," <expr>} */
-    te_expr *ret = expr(s);
+    /* <list>      =    <or> {"," <or>} */
+    te_expr *ret = or_expr(s);
     CHECK_NULL(ret);
 
     while (s->type == TOK_SEP) {
         next_token(s);
-        te_expr *e = expr(s);
+        te_expr *e = or_expr(s);
         CHECK_NULL(e, te_free(ret));
 
         te_expr *prev = ret;
@@ -602,30 +688,47 @@ double te_eval(const te_expr *n) {
 
         case TE_FUNCTION0: case TE_FUNCTION1: case TE_FUNCTION2: case TE_FUNCTION3:
         case TE_FUNCTION4: case TE_FUNCTION5: case TE_FUNCTION6: case TE_FUNCTION7:
-            switch(ARITY(n->type)) {
-                case 0: return TE_FUN(void)();
-                case 1: return TE_FUN(double)(M(0));
-                case 2: return TE_FUN(double, double)(M(0), M(1));
-                case 3: return TE_FUN(double, double, double)(M(0), M(1), M(2));
-                case 4: return TE_FUN(double, double, double, double)(M(0), M(1), M(2), M(3));
-                case 5: return TE_FUN(double, double, double, double, double)(M(0), M(1), M(2), M(3), M(4));
-                case 6: return TE_FUN(double, double, double, double, double, double)(M(0), M(1), M(2), M(3), M(4), M(5));
-                case 7: return TE_FUN(double, double, double, double, double, double, double)(M(0), M(1), M(2), M(3), M(4), M(5), M(6));
-                default: return NAN;
+            /* LILC: && and || do not evaluate the right side when not needed. */
+            if (n->function == logical_and) return (M(0) != 0.0 && M(1) != 0.0) ? 1.0 : 0.0;
+            if (n->function == logical_or) return (M(0) != 0.0 || M(1) != 0.0) ? 1.0 : 0.0;
+            {
+                /* LILC: arguments are evaluated left to right, a procedure call may change variables. */
+                double a[7];
+                const int arity = ARITY(n->type);
+                int i;
+                for (i = 0; i < arity; ++i) a[i] = M(i);
+                switch(arity) {
+                    case 0: return TE_FUN(void)();
+                    case 1: return TE_FUN(double)(a[0]);
+                    case 2: return TE_FUN(double, double)(a[0], a[1]);
+                    case 3: return TE_FUN(double, double, double)(a[0], a[1], a[2]);
+                    case 4: return TE_FUN(double, double, double, double)(a[0], a[1], a[2], a[3]);
+                    case 5: return TE_FUN(double, double, double, double, double)(a[0], a[1], a[2], a[3], a[4]);
+                    case 6: return TE_FUN(double, double, double, double, double, double)(a[0], a[1], a[2], a[3], a[4], a[5]);
+                    case 7: return TE_FUN(double, double, double, double, double, double, double)(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+                    default: return NAN;
+                }
             }
 
         case TE_CLOSURE0: case TE_CLOSURE1: case TE_CLOSURE2: case TE_CLOSURE3:
         case TE_CLOSURE4: case TE_CLOSURE5: case TE_CLOSURE6: case TE_CLOSURE7:
-            switch(ARITY(n->type)) {
-                case 0: return TE_FUN(void*)(n->parameters[0]);
-                case 1: return TE_FUN(void*, double)(n->parameters[1], M(0));
-                case 2: return TE_FUN(void*, double, double)(n->parameters[2], M(0), M(1));
-                case 3: return TE_FUN(void*, double, double, double)(n->parameters[3], M(0), M(1), M(2));
-                case 4: return TE_FUN(void*, double, double, double, double)(n->parameters[4], M(0), M(1), M(2), M(3));
-                case 5: return TE_FUN(void*, double, double, double, double, double)(n->parameters[5], M(0), M(1), M(2), M(3), M(4));
-                case 6: return TE_FUN(void*, double, double, double, double, double, double)(n->parameters[6], M(0), M(1), M(2), M(3), M(4), M(5));
-                case 7: return TE_FUN(void*, double, double, double, double, double, double, double)(n->parameters[7], M(0), M(1), M(2), M(3), M(4), M(5), M(6));
-                default: return NAN;
+            {
+                double a[7];
+                const int arity = ARITY(n->type);
+                void *ctx = n->parameters[arity];
+                int i;
+                for (i = 0; i < arity; ++i) a[i] = M(i);
+                switch(arity) {
+                    case 0: return TE_FUN(void*)(ctx);
+                    case 1: return TE_FUN(void*, double)(ctx, a[0]);
+                    case 2: return TE_FUN(void*, double, double)(ctx, a[0], a[1]);
+                    case 3: return TE_FUN(void*, double, double, double)(ctx, a[0], a[1], a[2]);
+                    case 4: return TE_FUN(void*, double, double, double, double)(ctx, a[0], a[1], a[2], a[3]);
+                    case 5: return TE_FUN(void*, double, double, double, double, double)(ctx, a[0], a[1], a[2], a[3], a[4]);
+                    case 6: return TE_FUN(void*, double, double, double, double, double, double)(ctx, a[0], a[1], a[2], a[3], a[4], a[5]);
+                    case 7: return TE_FUN(void*, double, double, double, double, double, double, double)(ctx, a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+                    default: return NAN;
+                }
             }
 
         default: return NAN;
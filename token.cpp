@@ -0,0 +1,241 @@
+#pragma once
+#include "system.cpp"
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// ===== Компактный поток токенов =====
+// Каждому слову программы — 32 бита: вид в старшем байте и 24-битный номер
+// в таблице чисел (уже разобранных) или имён. Вид определяется один раз при
+// загрузке, и потребители делают switch вместо цепочки сравнений и strtod.
+
+enum TokenKind : uint8_t
+{
+    TK_NAME = 0, // идентификатор
+    TK_INT,      // целое без знака: 42
+    TK_REAL,     // прочее число: 1.5  .5  1e3
+    TK_BADNUM,   // начинается как число, но не разбирается целиком: 2x
+    TK_KEYWORD,  // VAR, WHILE, ...
+    TK_FUNC,     // функция tinyexpr: sin, pow, ...
+    TK_OP,       // оператор выражения: + - * / ( ) , == != ...
+    TK_PUNCT,    // прочие разделители: [ ] { } ; = & |
+    TK_QUOTE,    // "
+    TK_TEXT,     // содержимое строки между кавычками
+    TK_COUNT
+};
+
+struct Token
+{
+    static constexpr uint32_t kIndexBits = 24;
+    static constexpr uint32_t kMaxIndex = (1u << kIndexBits) - 1;
+
+    uint32_t bits = 0;
+
+    Token() = default;
+    Token(TokenKind k, uint32_t index) : bits((uint32_t(k) << kIndexBits) | index) {}
+
+    TokenKind kind() const { return TokenKind(bits >> kIndexBits); }
+    uint32_t index() const { return bits & kMaxIndex; }
+};
+static_assert(sizeof(Token) == 4, "Token must stay 32-bit");
+
+// Слово переносится в текст выражения tinyexpr как есть
+inline bool isExprLiteral(TokenKind k)
+{
+    switch (k)
+    {
+    case TK_FUNC:
+    case TK_OP:
+    case TK_PUNCT:
+    case TK_INT:
+    case TK_REAL:
+    case TK_BADNUM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+class TokenStream
+{
+public:
+    // Классифицирует слова; false — таблица переполнила 24-битный номер
+    bool build(const std::vector<Id> &words, const Symbols &S)
+    {
+        clear();
+        tokens.reserve(words.size());
+        const size_t n = words.size();
+        for (size_t i = 0; i < n; ++i)
+        {
+            Id w = words[i];
+            if (w == S.QUOTE && i + 2 < n && words[i + 2] == S.QUOTE)
+            {
+                // строковый литерал: " текст "
+                tokens.push_back(Token(TK_QUOTE, addName(w)));
+                tokens.push_back(Token(TK_TEXT, addName(words[i + 1])));
+                tokens.push_back(Token(TK_QUOTE, addName(w)));
+                i += 2;
+            }
+            else
+                tokens.push_back(classify(w, S));
+            if (overflow)
+            {
+                error = "Too many distinct literals: more than " + std::to_string(Token::kMaxIndex + 1);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clear()
+    {
+        tokens.clear();
+        numbers.clear();
+        names.clear();
+        numberIndex.clear();
+        nameIndex.clear();
+        overflow = false;
+        error.clear();
+    }
+
+    size_t size() const { return tokens.size(); }
+
+    TokenKind kind(int w) const
+    {
+        return (w >= 0 && w < (int)tokens.size()) ? tokens[w].kind() : TK_COUNT;
+    }
+
+    bool isNumber(int w) const
+    {
+        const TokenKind k = kind(w);
+        return k == TK_INT || k == TK_REAL;
+    }
+
+    // Значение числового токена (TK_INT / TK_REAL)
+    double number(int w) const { return numbers[tokens[w].index()]; }
+
+    // Слово нечислового токена из таблицы имён
+    Id name(int w) const { return names[tokens[w].index()]; }
+
+    // Память потока с таблицами (без текста самих слов)
+    size_t bytes() const
+    {
+        return tokens.capacity() * sizeof(Token) + numbers.capacity() * sizeof(double) +
+               names.capacity() * sizeof(Id);
+    }
+
+    const std::string &lastError() const { return error; }
+
+    // Таблицы как есть — для записи в .lcb
+    const std::vector<Token> &tokenArray() const { return tokens; }
+    const std::vector<double> &numberTable() const { return numbers; }
+    const std::vector<Id> &nameTable() const { return names; }
+
+    // Поток из готовых таблиц (.lcb) без разбора слов; false — номер вне таблицы
+    bool assign(const uint32_t *bits, size_t n, const double *nums, size_t numCount, std::vector<Id> nameTable)
+    {
+        clear();
+        names = std::move(nameTable);
+        numbers.assign(nums, nums + numCount);
+        tokens.resize(n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            tokens[i].bits = bits[i];
+            const TokenKind k = tokens[i].kind();
+            const size_t limit = (k == TK_INT || k == TK_REAL) ? numbers.size() : names.size();
+            if (k >= TK_COUNT || tokens[i].index() >= limit)
+            {
+                clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    std::vector<Token> tokens;
+    std::vector<double> numbers;
+    std::vector<Id> names;
+    std::unordered_map<uint64_t, uint32_t> numberIndex; // биты double -> номер
+    std::unordered_map<Id, uint32_t, PtrHash> nameIndex;
+    bool overflow = false;
+    std::string error;
+
+    Token classify(Id w, const Symbols &S)
+    {
+        const unsigned char c0 = (unsigned char)w[0];
+        if ((c0 >= '0' && c0 <= '9') || (c0 == '.' && w[1] >= '0' && w[1] <= '9'))
+        {
+            bool digits = true;
+            for (const char *p = w; *p; ++p)
+                digits = digits && *p >= '0' && *p <= '9';
+            char *end = nullptr;
+            const double v = std::strtod(w, &end);
+            if (*end != '\0')
+                return Token(TK_BADNUM, addName(w));
+            return Token(digits ? TK_INT : TK_REAL, addNumber(v));
+        }
+        return Token(kindOf(w, S), addName(w));
+    }
+
+    static TokenKind kindOf(Id w, const Symbols &S)
+    {
+        if (w == S.VAR || w == S.CONST || w == S.SET || w == S.IF || w == S.ELSE || w == S.WHILE ||
+            w == S.PROC || w == S.RETURN || w == S.PRINT || w == S.PRINTLN || w == S.HALT ||
+            w == S.BREAK || w == S.CONTINUE)
+            return TK_KEYWORD;
+        if (w == S.PLUS || w == S.MINUS || w == S.STAR || w == S.SLASH ||
+            w == S.LP || w == S.RP || w == S.COMMA ||
+            w == S.EQEQ || w == S.NEQ || w == S.LEQ || w == S.GEQ ||
+            w == S.LT || w == S.GT ||
+            w == S.ANDAND || w == S.OROR || w == S.NOT ||
+            w == S.CARET || w == S.PERCENT)
+            return TK_OP;
+        if (w == S.LBRACKET || w == S.RBRACKET || w == S.LBRACE || w == S.RBRACE ||
+            w == S.SEMI || w == S.EQ || w == S.AMP || w == S.PIPE)
+            return TK_PUNCT;
+        if (w == S.QUOTE)
+            return TK_QUOTE;
+        if (w == S.ABS || w == S.ACOS || w == S.ASIN || w == S.ATAN || w == S.ATAN2 ||
+            w == S.CEIL || w == S.COS || w == S.COSH || w == S.EXP || w == S.FAC ||
+            w == S.FLOOR || w == S.LN || w == S.LOG || w == S.LOG10 || w == S.NCR || w == S.NPR ||
+            w == S.PIK || w == S.POW || w == S.SIN || w == S.SINH || w == S.SQRT || w == S.TAN || w == S.TANH)
+            return TK_FUNC;
+        return TK_NAME;
+    }
+
+    uint32_t addNumber(double v)
+    {
+        uint64_t key;
+        std::memcpy(&key, &v, sizeof(key));
+        auto it = numberIndex.find(key);
+        if (it != numberIndex.end())
+            return it->second;
+        return add(numbers, numberIndex, key, v);
+    }
+
+    uint32_t addName(Id w)
+    {
+        auto it = nameIndex.find(w);
+        if (it != nameIndex.end())
+            return it->second;
+        return add(names, nameIndex, w, w);
+    }
+
+    template <class T, class Map, class Key>
+    uint32_t add(std::vector<T> &table, Map &index, Key key, T value)
+    {
+        if (table.size() > Token::kMaxIndex)
+        {
+            overflow = true;
+            return 0;
+        }
+        const uint32_t k = (uint32_t)table.size();
+        table.push_back(value);
+        index.emplace(key, k);
+        return k;
+    }
+};
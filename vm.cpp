@@ -0,0 +1,439 @@
+#pragma once
+#include "compiler.cpp"
+#include <functional>
+#include <iostream>
+#include <deque>
+
+// ===== Регистровая ВМ для байткода из compiler.cpp =====
+class VM
+{
+public:
+    // вывод и диагностика делегируются хозяину (lilc)
+    std::function<void(const char *, bool)> onText;
+    std::function<void(double, bool)> onNumber;
+    std::function<void(int, const char *, bool)> onDiag; // слово, текст, ошибка?
+
+    bool halted = false;
+    int maxDepth = kMaxCallDepth; // вложенных вызовов; до load
+
+    void load(const Bytecode *code)
+    {
+        bc = code;
+        pc = 0;
+        base = 0;
+        abase = 0;
+        func = 0;
+        halted = false;
+        frames.clear();
+        depthError = callDepthError(maxDepth);
+        regs.assign(code->funcs[0].nregs + 1, 0.0);
+        store.clear();
+        arrs.clear();
+        ownArrays(0, code->funcs[0].narrs);
+
+        // стек на maxDepth кадров самой большой процедуры выделен заранее:
+        // регистры и кадры не переезжают при вызовах
+        size_t procRegs = 0, procArrs = 0;
+        for (size_t f = 1; f < code->funcs.size(); ++f)
+        {
+            procRegs = std::max(procRegs, (size_t)code->funcs[f].nregs);
+            procArrs = std::max(procArrs, (size_t)code->funcs[f].narrs);
+        }
+        frames.reserve(maxDepth);
+        regs.reserve(regs.size() + maxDepth * procRegs);
+        arrs.reserve(arrs.size() + maxDepth * procArrs);
+    }
+
+    int getPc() const { return pc; }
+
+    // Выполняет не более limit инструкций (-1 — до остановки)
+    long run(long limit = -1)
+    {
+        if (halted || !bc)
+            return 0;
+
+        const Instr *code = bc->code.data();
+        const double *K = bc->consts.data();
+        double *G = regs.data();
+        double *R = G + base;
+        long steps = 0;
+
+        for (;;)
+        {
+            if (limit >= 0 && steps >= limit)
+                break;
+            ++steps;
+
+            const Instr &I = code[pc];
+            switch (I.op)
+            {
+            case OP_NOP:
+                ++pc;
+                break;
+            case OP_MOV:
+                R[I.a] = R[I.b];
+                ++pc;
+                break;
+            case OP_LOADK:
+                R[I.a] = K[I.b];
+                ++pc;
+                break;
+            case OP_GETG:
+                R[I.a] = G[I.b];
+                ++pc;
+                break;
+            case OP_SETG:
+                G[I.a] = R[I.b];
+                ++pc;
+                break;
+
+            case OP_ADD:
+                R[I.a] = R[I.b] + R[I.c];
+                ++pc;
+                break;
+            case OP_SUB:
+                R[I.a] = R[I.b] - R[I.c];
+                ++pc;
+                break;
+            case OP_MUL:
+                R[I.a] = R[I.b] * R[I.c];
+                ++pc;
+                break;
+            case OP_DIV:
+                R[I.a] = R[I.b] / R[I.c];
+                ++pc;
+                break;
+            case OP_MOD:
+                R[I.a] = std::fmod(R[I.b], R[I.c]);
+                ++pc;
+                break;
+            case OP_POW:
+                R[I.a] = std::pow(R[I.b], R[I.c]);
+                ++pc;
+                break;
+            case OP_ADDK:
+                R[I.a] = R[I.b] + K[I.c];
+                ++pc;
+                break;
+            case OP_SUBK:
+                R[I.a] = R[I.b] - K[I.c];
+                ++pc;
+                break;
+            case OP_MULK:
+                R[I.a] = R[I.b] * K[I.c];
+                ++pc;
+                break;
+            case OP_DIVK:
+                R[I.a] = R[I.b] / K[I.c];
+                ++pc;
+                break;
+            case OP_NEG:
+                R[I.a] = -R[I.b];
+                ++pc;
+                break;
+            case OP_NOT:
+                R[I.a] = (R[I.b] == 0.0) ? 1.0 : 0.0;
+                ++pc;
+                break;
+
+            case OP_LT:
+                R[I.a] = (R[I.b] < R[I.c]) ? 1.0 : 0.0;
+                ++pc;
+                break;
+            case OP_LE:
+                R[I.a] = (R[I.b] <= R[I.c]) ? 1.0 : 0.0;
+                ++pc;
+                break;
+            case OP_GT:
+                R[I.a] = (R[I.b] > R[I.c]) ? 1.0 : 0.0;
+                ++pc;
+                break;
+            case OP_GE:
+                R[I.a] = (R[I.b] >= R[I.c]) ? 1.0 : 0.0;
+                ++pc;
+                break;
+            case OP_EQ:
+                R[I.a] = (R[I.b] == R[I.c]) ? 1.0 : 0.0;
+                ++pc;
+                break;
+            case OP_NE:
+                R[I.a] = (R[I.b] != R[I.c]) ? 1.0 : 0.0;
+                ++pc;
+                break;
+
+#define LILC_VM_JUMP(OP, COND) \
+    case OP:                   \
+        pc = (COND) ? I.a : pc + 1; \
+        break;
+                LILC_VM_JUMP(OP_JLT, R[I.b] < R[I.c])
+                LILC_VM_JUMP(OP_JLE, R[I.b] <= R[I.c])
+                LILC_VM_JUMP(OP_JGT, R[I.b] > R[I.c])
+                LILC_VM_JUMP(OP_JGE, R[I.b] >= R[I.c])
+                LILC_VM_JUMP(OP_JEQ, R[I.b] == R[I.c])
+                LILC_VM_JUMP(OP_JNE, R[I.b] != R[I.c])
+                LILC_VM_JUMP(OP_JLTK, R[I.b] < K[I.c])
+                LILC_VM_JUMP(OP_JLEK, R[I.b] <= K[I.c])
+                LILC_VM_JUMP(OP_JGTK, R[I.b] > K[I.c])
+                LILC_VM_JUMP(OP_JGEK, R[I.b] >= K[I.c])
+                LILC_VM_JUMP(OP_JEQK, R[I.b] == K[I.c])
+                LILC_VM_JUMP(OP_JNEK, R[I.b] != K[I.c])
+                LILC_VM_JUMP(OP_JNLT, !(R[I.b] < R[I.c]))
+                LILC_VM_JUMP(OP_JNLE, !(R[I.b] <= R[I.c]))
+                LILC_VM_JUMP(OP_JNGT, !(R[I.b] > R[I.c]))
+                LILC_VM_JUMP(OP_JNGE, !(R[I.b] >= R[I.c]))
+                LILC_VM_JUMP(OP_JNEQ, !(R[I.b] == R[I.c]))
+                LILC_VM_JUMP(OP_JNNE, !(R[I.b] != R[I.c]))
+                LILC_VM_JUMP(OP_JNLTK, !(R[I.b] < K[I.c]))
+                LILC_VM_JUMP(OP_JNLEK, !(R[I.b] <= K[I.c]))
+                LILC_VM_JUMP(OP_JNGTK, !(R[I.b] > K[I.c]))
+                LILC_VM_JUMP(OP_JNGEK, !(R[I.b] >= K[I.c]))
+                LILC_VM_JUMP(OP_JNEQK, !(R[I.b] == K[I.c]))
+                LILC_VM_JUMP(OP_JNNEK, !(R[I.b] != K[I.c]))
+                LILC_VM_JUMP(OP_JZ, R[I.b] == 0.0)
+                LILC_VM_JUMP(OP_JNZ, R[I.b] != 0.0)
+#undef LILC_VM_JUMP
+            case OP_JMP:
+                pc = I.a;
+                break;
+
+            case OP_CALLF1:
+                R[I.a] = builtins()[I.c].f1(R[I.b]);
+                ++pc;
+                break;
+            case OP_CALLF2:
+                R[I.a] = builtins()[I.c].f2(R[I.b], R[I.b + 1]);
+                ++pc;
+                break;
+
+            case OP_NEWARR:
+                arrs[abase + I.a]->assign((size_t)K[I.b], 0.0);
+                ++pc;
+                break;
+            case OP_GETA:
+            case OP_GETAG:
+            {
+                const bool global = (I.op == OP_GETAG);
+                const std::vector<double> &v = *arrs[(global ? 0 : abase) + I.b];
+                const double x = R[I.c];
+                if (!(x >= 0.0))
+                {
+                    fail("Array index must be >= 0");
+                    return steps;
+                }
+                const size_t idx = (size_t)x;
+                if (idx >= v.size())
+                {
+                    Id name = arrName(global ? 0 : func, I.b);
+                    std::cerr << "Index out of bounds for array '" << name << "': "
+                              << idx << " >= " << v.size() << "\n";
+                    std::string er = "Array element '" + std::string(name) + "[" + std::to_string(idx) + "]' not found";
+                    fail(er.c_str());
+                    return steps;
+                }
+                R[I.a] = v[idx];
+                ++pc;
+                break;
+            }
+            case OP_SETA:
+            case OP_SETAG:
+            {
+                const bool global = (I.op == OP_SETAG);
+                std::vector<double> &v = *arrs[(global ? 0 : abase) + I.a];
+                const double x = R[I.b];
+                const long long idx = (long long)x;
+                if (idx < 0)
+                    std::cerr << "Negative index for array '" << arrName(global ? 0 : func, I.a) << "': " << idx << "\n";
+                else if ((size_t)idx >= v.size())
+                    std::cerr << "Index out of bounds for array '" << arrName(global ? 0 : func, I.a) << "': "
+                              << idx << " >= " << v.size() << "\n";
+                else
+                    v[(size_t)idx] = R[I.c];
+                ++pc;
+                break;
+            }
+            case OP_GETAU:
+                R[I.a] = (*arrs[abase + I.b])[(size_t)R[I.c]];
+                ++pc;
+                break;
+            case OP_SETAU:
+                (*arrs[abase + I.a])[(size_t)R[I.b]] = R[I.c];
+                ++pc;
+                break;
+
+            case OP_CALL:
+            {
+                // кадр вызываемой — сразу за кадром текущей функции
+                if ((int)frames.size() >= maxDepth)
+                {
+                    fail(depthError.c_str(), bc->wordOf[pc]); // как tick: на слове вызова
+                    return steps;
+                }
+                const FuncInfo &callee = bc->funcs[I.a];
+                const CallArgs &args = bc->calls[I.c];
+                const int nbase = base + bc->funcs[func].nregs;
+                const int nabase = abase + bc->funcs[func].narrs;
+                if (regs.size() < (size_t)(nbase + callee.nregs + 1))
+                    regs.resize(nbase + callee.nregs + 1, 0.0);
+                ownArrays(nabase, callee.narrs);
+                for (size_t k = 0; k < args.arrays.size(); ++k)
+                    arrs[nabase + k] = arrs[(args.arrays[k].global ? 0 : abase) + args.arrays[k].slot];
+                G = regs.data();
+                R = G + base;
+                std::copy(R + I.b, R + I.b + args.values, G + nbase);
+                frames.push_back({pc + 1, base, abase, func, I.b});
+                base = nbase;
+                abase = nabase;
+                func = I.a;
+                R = G + base;
+                pc = callee.entry;
+                break;
+            }
+            case OP_RET:
+            {
+                if (frames.empty())
+                {
+                    halted = true;
+                    return steps;
+                }
+                const double v = I.b ? R[I.a] : 0.0;
+                const Frame &fr = frames.back();
+                pc = fr.retPc;
+                base = fr.base;
+                abase = fr.abase;
+                func = fr.func;
+                R = G + base;
+                R[fr.ret] = v;
+                frames.pop_back();
+                break;
+            }
+            case OP_TCALL:
+            {
+                // хвостовой вызов: вызываемая занимает кадр текущей, стек не растёт
+                const FuncInfo &callee = bc->funcs[I.a];
+                const CallArgs &args = bc->calls[I.c];
+                double values[kMaxProcParams];
+                std::vector<double> *refs[kMaxProcParams];
+                std::copy(R + I.b, R + I.b + args.values, values);
+                for (size_t k = 0; k < args.arrays.size(); ++k)
+                    refs[k] = arrs[(args.arrays[k].global ? 0 : abase) + args.arrays[k].slot];
+                if (regs.size() < (size_t)(base + callee.nregs + 1))
+                    regs.resize(base + callee.nregs + 1, 0.0);
+                ownArrays(abase, callee.narrs);
+                std::copy(refs, refs + args.arrays.size(), arrs.begin() + abase);
+                G = regs.data();
+                R = G + base;
+                std::copy(values, values + args.values, R);
+                func = I.a;
+                pc = callee.entry;
+                break;
+            }
+
+            case OP_VLOOP:
+                pc = runKernel(bc->kernels[I.a], G, R) ? I.b : pc + 1;
+                break;
+
+            case OP_PRINTS:
+                if (onText)
+                    onText(bc->strings[I.a], I.b != 0);
+                ++pc;
+                break;
+            case OP_PRINTN:
+                if (onNumber)
+                    onNumber(R[I.a], I.b != 0);
+                ++pc;
+                break;
+            case OP_WARN:
+                if (onDiag)
+                    onDiag(bc->stmtOf[pc], bc->strings[I.a], false);
+                ++pc;
+                break;
+            case OP_ERR:
+                fail(bc->strings[I.a]);
+                return steps;
+            case OP_HALT:
+            default:
+                halted = true;
+                return steps;
+            }
+        }
+        return steps;
+    }
+
+private:
+    struct Frame
+    {
+        int retPc;
+        int base;
+        int abase;
+        int func;
+        int ret; // регистр вызывающей для результата
+    };
+
+    const Bytecode *bc = nullptr;
+    std::vector<double> regs;
+    // Массивы кадров: ячейка указывает на свой массив из store (адреса в
+    // deque не меняются при росте) или на массив вызывающей, переданный
+    // по ссылке
+    std::deque<std::vector<double>> store;
+    std::vector<std::vector<double> *> arrs;
+    std::vector<Frame> frames;
+    std::string depthError;
+    int pc = 0;
+    int base = 0;
+    int abase = 0;
+    int func = 0;
+
+    Id arrName(int f, int slot) const { return bc->funcs[f].arrNames[slot]; }
+
+    // Ячейки [from, from + n) — снова свои массивы кадра
+    void ownArrays(int from, int n)
+    {
+        if (store.size() < (size_t)(from + n))
+        {
+            store.resize(from + n);
+            arrs.resize(from + n);
+        }
+        for (int k = from; k < from + n; ++k)
+            arrs[k] = &store[k];
+    }
+
+    // Поэлементный цикл целиком; false — выполнять обычный байткод цикла
+    bool runKernel(const VecKernel &k, double *G, double *R)
+    {
+        auto var = [&](const VecRef &r) -> double &
+        { return r.global ? G[r.slot] : R[r.slot]; };
+        const double n = (k.limitVar.slot >= 0) ? var(k.limitVar) : k.limitConst;
+        double &i = var(k.counter);
+        const long count = vecTripCount(k.inclusive, i, n);
+        if (count <= 0)
+            return false;
+
+        kArrays.clear();
+        kSizes.clear();
+        kScalars.clear();
+        for (const VecRef &r : k.arrays)
+        {
+            std::vector<double> &v = *arrs[(r.global ? 0 : abase) + r.slot];
+            kArrays.push_back(v.data());
+            kSizes.push_back(v.size());
+        }
+        for (const VecRef &r : k.scalars)
+            kScalars.push_back(var(r));
+        if (!vecRun(k, kArrays.data(), kSizes.data(), kScalars.data(), i, count))
+            return false;
+        i += (double)count;
+        return true;
+    }
+
+    std::vector<double *> kArrays;
+    std::vector<size_t> kSizes;
+    std::vector<double> kScalars;
+
+    // Ошибка по умолчанию — на слове оператора, там же её сообщает tick
+    void fail(const char *msg, int word = -1)
+    {
+        if (onDiag)
+            onDiag(word < 0 ? bc->stmtOf[pc] : word, msg, true);
+        halted = true;
+    }
+};